@@ -0,0 +1,248 @@
+#include "ArenaParser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+#include "ExpressionOptimizer.h"
+#include "Trace.h"
+
+Arena::Arena(size_t blockSize) : blockSize_(blockSize) {}
+
+/*!
+ * \brief Выделяет size байт с выравниванием alignment.
+ *
+ * \details
+ * Запросы больше размера блока получают собственный блок.
+ */
+void* Arena::allocate(size_t size, size_t alignment) {
+  auto paddingFor = [alignment](const std::byte* p) {
+    return (alignment - reinterpret_cast<std::uintptr_t>(p) % alignment) %
+           alignment;
+  };
+
+  size_t padding = current_ ? paddingFor(current_) : 0;
+  if (!current_ || padding + size > remaining_) {
+    const size_t capacity = std::max(blockSize_, size + alignment);
+    blocks_.emplace_back(new std::byte[capacity]);
+    current_ = blocks_.back().get();
+    remaining_ = capacity;
+    padding = paddingFor(current_);
+  }
+
+  std::byte* result = current_ + padding;
+  current_ = result + size;
+  remaining_ -= padding + size;
+  bytesUsed_ += size;
+  return result;
+}
+
+/*!
+ * \brief Освобождает всю память арены.
+ *
+ * \details
+ * Стоимость не зависит от числа размещенных объектов: освобождаются только
+ * блоки по 64 КБ, деструкторы узлов не вызываются.
+ */
+void Arena::reset() {
+  blocks_.clear();
+  current_ = nullptr;
+  remaining_ = 0;
+  bytesUsed_ = 0;
+}
+
+std::uint32_t ArenaNode::emit(ExpressionBuilder& builder) const {
+  switch (kind) {
+    case Kind::Constant:
+      return builder.constant(value);
+    case Kind::Variable:
+      return builder.variable(std::string(name));
+    case Kind::Function:
+      break;
+  }
+  return emitFunctionCall(builder, name, argCount,
+                          [this, &builder](size_t i) {
+                            return args[i]->emit(builder);
+                          });
+}
+
+size_t ArenaNode::subtreeSize() const {
+  size_t size = 1;
+  for (std::uint32_t i = 0; i < argCount; ++i) size += args[i]->subtreeSize();
+  return size;
+}
+
+void ArenaParser::skipWhitespace() {
+  while (pos_ < input_.size() &&
+         std::isspace(static_cast<unsigned char>(input_[pos_]))) {
+    ++pos_;
+  }
+}
+
+bool ArenaParser::consumeIf(char c) {
+  skipWhitespace();
+  if (peek() == c) {
+    ++pos_;
+    return true;
+  }
+  return false;
+}
+
+std::string_view ArenaParser::parseIdentifier() {
+  skipWhitespace();
+  char c = peek();
+  if (c == ']' || c == ',' || c == '&') {
+    throw std::runtime_error(
+        "Unexpected delimiter when expecting identifier at position " +
+        std::to_string(pos_));
+  }
+
+  // Лямбда-параметр
+  if (c == '#') {
+    return input_.substr(pos_++, 1);
+  }
+
+  if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+    throw std::runtime_error("Unexpected character when expecting identifier: " +
+                             std::string(1, c));
+  }
+
+  const size_t start = pos_++;
+  while (std::isalnum(static_cast<unsigned char>(peek())) || peek() == '_') {
+    ++pos_;
+  }
+  return input_.substr(start, pos_ - start);
+}
+
+double ArenaParser::parseNumber() {
+  skipWhitespace();
+  const size_t start = pos_;
+  bool hasDecimal = false;
+  bool hasExponent = false;
+
+  if (peek() == '-') ++pos_;
+
+  while (true) {
+    char c = peek();
+    if (std::isdigit(static_cast<unsigned char>(c)) ||
+        (!hasDecimal && c == '.') ||
+        (!hasExponent && (c == 'e' || c == 'E'))) {
+      if (c == '.') hasDecimal = true;
+      if (c == 'e' || c == 'E') hasExponent = true;
+      ++pos_;
+    } else {
+      break;
+    }
+  }
+
+  // Как и std::stod в MathematicaParser, разбираем самый длинный префикс
+  double value = 0.0;
+  const char* first = input_.data() + start;
+  const char* last = input_.data() + pos_;
+  if (std::from_chars(first, last, value).ec != std::errc()) {
+    throw std::runtime_error("Invalid number format");
+  }
+  return value;
+}
+
+const ArenaNode* ArenaParser::makeNode(ArenaNode::Kind kind, double value,
+                                       std::string_view name,
+                                       size_t argsBegin) {
+  ArenaNode* node = arena_.allocateArray<ArenaNode>(1);
+  node->kind = kind;
+  node->value = value;
+  node->name = name;
+  node->argCount = static_cast<std::uint32_t>(argStack_.size() - argsBegin);
+  node->args = nullptr;
+  if (node->argCount != 0) {
+    const ArenaNode** args =
+        arena_.allocateArray<const ArenaNode*>(node->argCount);
+    std::copy(argStack_.begin() + argsBegin, argStack_.end(), args);
+    node->args = args;
+    argStack_.resize(argsBegin);
+  }
+  return node;
+}
+
+const ArenaNode* ArenaParser::parse() {
+  skipWhitespace();
+  const ArenaNode* expr = parseExpression();
+  skipWhitespace();
+  isLambda_ = consumeIf('&');
+  return expr;
+}
+
+const ArenaNode* ArenaParser::parseExpression() {
+  skipWhitespace();
+  char c = peek();
+  if (c == ']' || c == ',' || c == '&') {
+    throw std::runtime_error(
+        "Unexpected delimiter when expecting an expression at position " +
+        std::to_string(pos_));
+  }
+  if (std::isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '.') {
+    return makeNode(ArenaNode::Kind::Constant, parseNumber(), {},
+                    argStack_.size());
+  }
+
+  std::string_view identifier = parseIdentifier();
+  if (!consumeIf('[')) {
+    return makeNode(ArenaNode::Kind::Variable, 0.0, identifier,
+                    argStack_.size());
+  }
+
+  const size_t argsBegin = argStack_.size();
+  skipWhitespace();
+  if (peek() != ']') {
+    argStack_.push_back(parseExpression());
+    while (true) {
+      skipWhitespace();
+      if (peek() == ']') break;
+      if (!consumeIf(',')) {
+        throw std::runtime_error("Expected ',' or ']' at position " +
+                                 std::to_string(pos_));
+      }
+      skipWhitespace();
+      if (peek() == ']') break;
+      argStack_.push_back(parseExpression());
+    }
+  }
+  if (!consumeIf(']')) {
+    throw std::runtime_error("Expected closing bracket at position " +
+                             std::to_string(pos_));
+  }
+
+  // Rational[p, q] с числовыми аргументами сразу становится константой
+  if (identifier == "Rational" && argStack_.size() - argsBegin == 2 &&
+      argStack_[argsBegin]->kind == ArenaNode::Kind::Constant &&
+      argStack_[argsBegin + 1]->kind == ArenaNode::Kind::Constant) {
+    int num = static_cast<int>(argStack_[argsBegin]->value);
+    int denom = static_cast<int>(argStack_[argsBegin + 1]->value);
+    argStack_.resize(argsBegin);
+    return makeNode(ArenaNode::Kind::Constant,
+                    static_cast<double>(num) / denom, {}, argsBegin);
+  }
+
+  return makeNode(ArenaNode::Kind::Function, 0.0, identifier, argsBegin);
+}
+
+/*!
+ * \brief Разбирает и компилирует функцию одной переменной.
+ * \param[in] fullForm Текст FullForm ('#' для лямбды, иначе 'x').
+ * \return Оптимизированная программа.
+ *
+ * \details
+ * Дерево живет только на время компиляции и освобождается вместе с ареной.
+ */
+BytecodeProgram ArenaParser::compileUnary(std::string_view fullForm) {
+  TraceSpan span("expression.parse_compile");
+  Arena arena;
+  ArenaParser parser(fullForm, arena);
+  const ArenaNode* root = parser.parse();
+
+  const std::string var = parser.isLambda() ? "#" : "x";
+  ExpressionDag dag({var});
+  return dag.compile({root->emit(dag)});
+}
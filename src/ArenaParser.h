@@ -0,0 +1,98 @@
+#ifndef ARENAPARSER_H
+#define ARENAPARSER_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "ExpressionVM.h"
+
+/*!
+ * \class Arena
+ * \brief Линейный (bump) аллокатор блоками.
+ *
+ * Объекты не освобождаются по одному: вся память возвращается разом при
+ * reset() или разрушении арены. Размещать в арене можно только тривиально
+ * разрушаемые типы.
+ */
+class Arena {
+ public:
+  explicit Arena(size_t blockSize = kDefaultBlockSize);
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t alignment);
+
+  template <typename T>
+  T* allocateArray(size_t count) {
+    return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void reset();
+  size_t bytesUsed() const { return bytesUsed_; }
+
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+ private:
+  size_t blockSize_;
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::byte* current_ = nullptr;
+  size_t remaining_ = 0;
+  size_t bytesUsed_ = 0;
+};
+
+/*!
+ * \brief Узел AST, размещенный в арене.
+ *
+ * Узел не владеет ничем: имена — string_view во входной буфер, аргументы —
+ * массив указателей в той же арене. Буфер и арена должны жить дольше дерева.
+ */
+struct ArenaNode {
+  enum class Kind : std::uint8_t { Constant, Variable, Function };
+
+  Kind kind;
+  std::uint32_t argCount;
+  double value;           //!< значение константы
+  std::string_view name;  //!< имя переменной или функции
+  const ArenaNode* const* args;
+
+  std::uint32_t emit(ExpressionBuilder& builder) const;
+  size_t subtreeSize() const;
+};
+
+/*!
+ * \class ArenaParser
+ * \brief Парсер FullForm без подсчета ссылок и копирования строк.
+ *
+ * Грамматика и сообщения об ошибках совпадают с MathematicaParser, но узлы
+ * размещаются в арене, а лексемы — string_view во входной строке.
+ */
+class ArenaParser {
+ public:
+  ArenaParser(std::string_view input, Arena& arena)
+      : input_(input), arena_(arena) {}
+
+  const ArenaNode* parse();
+  bool isLambda() const { return isLambda_; }
+
+  static BytecodeProgram compileUnary(std::string_view fullForm);
+
+ private:
+  char peek() const { return pos_ < input_.size() ? input_[pos_] : '\0'; }
+  void skipWhitespace();
+  bool consumeIf(char c);
+  std::string_view parseIdentifier();
+  double parseNumber();
+  const ArenaNode* parseExpression();
+  const ArenaNode* makeNode(ArenaNode::Kind kind, double value,
+                            std::string_view name, size_t argsBegin);
+
+  std::string_view input_;
+  Arena& arena_;
+  size_t pos_ = 0;
+  bool isLambda_ = false;
+  // Общий стек аргументов для всех уровней вложенности
+  std::vector<const ArenaNode*> argStack_;
+};
+#endif
@@ -1,13 +1,9 @@
 #include "BicubicInterpolator.h"
 
+#include "Trace.h"
+
 typedef std::function<double(double)> RealFuncOfOneVar;
 
-double BicubicInterpolator::cubicInterpolate(double p[4], double x) {
-  return p[1] + 0.5 * x *
-                    (p[2] - p[0] +
-                     x * (2.0 * p[0] - 5.0 * p[1] + 4.0 * p[2] - p[3] +
-                          x * (3.0 * (p[1] - p[2]) + p[3] - p[0])));
-}
 /*!
  * \brief Проверяет, находится ли точка (x, y) в пределах допустимого
  * диапазона.
@@ -48,20 +44,106 @@ BicubicInterpolator::BicubicInterpolator(
     throw std::invalid_argument("Input data cannot be empty");
   }
 
-  values = data;
   rows = data.size();
   cols = data[0].size();
 
   // Проверка на прямоугольность матрицы
+  auto flat = std::make_shared<std::vector<double>>();
+  flat->reserve(static_cast<size_t>(rows) * cols);
   for (const auto& row : data) {
     if (row.size() != cols) {
       throw std::invalid_argument("Input data must be a rectangular matrix");
     }
+    flat->insert(flat->end(), row.begin(), row.end());
   }
+  values = flat->data();
+  storage_ = std::shared_ptr<const double>(flat, values);
+}
+
+/*!
+ * \brief Конструктор из готового массива значений по строкам.
+ * \param[in] data Значения, data[y * cols + x]; массив перемещается без
+ * копирования.
+ * \param[in] rows Количество строк.
+ * \param[in] cols Количество столбцов.
+ * \param[in] kernel Ядро интерполяции; для B-сплайна значения
+ * преобразуются в коэффициенты на месте (BSplinePrefilter).
+ * \throws std::invalid_argument Если размеры не положительны или не
+ * совпадают с размером массива.
+ */
+BicubicInterpolator::BicubicInterpolator(std::vector<double> data, int rows,
+                                         int cols, CubicKernelType kernel)
+    : kernel_(kernel), rows(rows), cols(cols) {
+  if (rows <= 0 || cols <= 0) {
+    throw std::invalid_argument("Input data cannot be empty");
+  }
+  if (data.size() != static_cast<size_t>(rows) * cols) {
+    throw std::invalid_argument("Input data must be a rectangular matrix");
+  }
+  if (kernel == CubicKernelType::BSpline) {
+    const int extents[2] = {cols, rows};
+    BSplinePrefilter(data.data(), extents, 2);
+  }
+  auto flat = std::make_shared<std::vector<double>>(std::move(data));
+  values = flat->data();
+  storage_ = std::shared_ptr<const double>(flat, values);
+}
+
+/*!
+ * \brief Конструктор над внешним буфером без копирования.
+ * \param[in] data Значения по строкам, не менее rows * cols элементов;
+ * буфер живет, пока на него ссылается хотя бы один интерполятор.
+ * \param[in] rows Количество строк.
+ * \param[in] cols Количество столбцов.
+ * \param[in] kernel Ядро интерполяции; для B-сплайна буфер уже должен
+ * содержать коэффициенты (например, data() другого интерполятора).
+ * \throws std::invalid_argument Если буфер пуст или размеры не положительны.
+ */
+BicubicInterpolator::BicubicInterpolator(std::shared_ptr<const double> data,
+                                         int rows, int cols,
+                                         CubicKernelType kernel)
+    : storage_(std::move(data)), kernel_(kernel), rows(rows), cols(cols) {
+  if (!storage_ || rows <= 0 || cols <= 0) {
+    throw std::invalid_argument("Input data cannot be empty");
+  }
+  values = storage_.get();
+}
+
+/*!
+ * \brief Конструктор над сеткой, хранимой плитками.
+ * \param[in] tiles Плитки; разделяются со всеми копиями интерполятора.
+ * \param[in] kernel Ядро интерполяции; для B-сплайна плитки содержат
+ * коэффициенты.
+ * \throws std::invalid_argument Если tiles пуст.
+ */
+BicubicInterpolator::BicubicInterpolator(std::shared_ptr<const TiledGrid> tiles,
+                                         CubicKernelType kernel)
+    : values(nullptr), tiles_(std::move(tiles)), kernel_(kernel) {
+  if (!tiles_) throw std::invalid_argument("Input data cannot be empty");
+  rows = tiles_->rowCount();
+  cols = tiles_->colCount();
 }
 
 BicubicInterpolator::~BicubicInterpolator() = default;
 
+/*!
+ * \brief Значения сетки по строкам.
+ * \return Собственный буфер интерполятора или, при хранении плитками,
+ * распакованная копия.
+ */
+std::shared_ptr<const double> BicubicInterpolator::denseData() const {
+  if (values) return storage_;
+  auto flat = std::make_shared<std::vector<double>>(
+      static_cast<size_t>(rows) * cols);
+  tiles_->decode(flat->data());
+  return std::shared_ptr<const double>(flat, flat->data());
+}
+
+size_t BicubicInterpolator::residentBytes() const {
+  if (tiles_) return sizeof(*this) + tiles_->residentBytes();
+  return sizeof(*this) + static_cast<size_t>(rows) * cols * sizeof(double);
+}
+
 /*!
  * \brief Выполняет бикубическую интерполяцию в точке (x, y).
  * \param[in] x Координата x точки интерполяции.
@@ -107,6 +189,90 @@ double BicubicInterpolator::interpolate(double xx, double yy) const {
     y = std::max(0.0, std::min(static_cast<double>(rows - 1.01), y));
   }
 
+  return interpolateClamped(x, y);
+}
+
+/*!
+ * \brief Интерполяция во множестве точек.
+ * \param[in] xy Координаты точек парами: x0, y0, x1, y1, ...
+ * \param[out] out Массив из n интерполированных значений.
+ * \param[in] n Количество точек.
+ * \return Количество точек вне сетки.
+ *
+ * \details
+ * Точки вне сетки ограничиваются так же, как в interpolate, но вместо
+ * предупреждения на каждую точку выводится одно на весь пакет.
+ */
+size_t BicubicInterpolator::interpolateBatch(const double* xy, double* out,
+                                             size_t n) const {
+  TraceSpan span("interpolate.batch");
+  size_t outside;
+#ifdef BICUBIC_ISA_DISPATCH
+  const IsaLevel isa =
+      CpuDispatch::strict() ? IsaLevel::Sse2 : CpuDispatch::active();
+  if (isa == IsaLevel::Avx512) {
+    outside = interpolateBatchAvx512(xy, out, n);
+  } else if (isa == IsaLevel::Avx2Fma) {
+    outside = interpolateBatchAvx2(xy, out, n);
+  } else {
+    outside = interpolateBatchBaseline(xy, out, n);
+  }
+#else
+  outside = interpolateBatchBaseline(xy, out, n);
+#endif
+
+  if (outside != 0) {
+    std::cerr << "Warning: " << outside << " of " << n
+              << " interpolation points are outside the data range [0, "
+              << cols - 1 << "] x [0, " << rows - 1 << "]\n";
+  }
+  return outside;
+}
+
+// Ядро выбирается один раз на пакет. Базовый вариант не использует FMA и
+// совпадает с interpolate побитно; он же используется в строгом режиме
+size_t BicubicInterpolator::interpolateBatchBaseline(const double* xy,
+                                                     double* out,
+                                                     size_t n) const {
+  return WithCubicKernel(kernel_, [&](auto kernel) {
+    return interpolateBatchWith<decltype(kernel)>(xy, out, n);
+  });
+}
+
+#ifdef BICUBIC_ISA_DISPATCH
+// Тот же код, собранный для AVX2 + FMA: многочлены ядра считаются через FMA
+BICUBIC_TARGET("avx2,fma")
+size_t BicubicInterpolator::interpolateBatchAvx2(const double* xy, double* out,
+                                                 size_t n) const {
+  return interpolateBatchBaseline(xy, out, n);
+}
+
+BICUBIC_TARGET("avx512f,avx2,fma")
+size_t BicubicInterpolator::interpolateBatchAvx512(const double* xy,
+                                                   double* out,
+                                                   size_t n) const {
+  return interpolateBatchBaseline(xy, out, n);
+}
+#endif
+
+// Точки пакета обычно идут вдоль пути, поэтому окрестность переиспользуется
+// курсором; для произвольного порядка он читает ячейку заново
+template <typename Kernel>
+size_t BicubicInterpolator::interpolateBatchWith(const double* xy, double* out,
+                                                 size_t n) const {
+  InterpolatorCursor cursor(*this);
+  return cursor.interpolateBatchWith<Kernel>(xy, out, n);
+}
+
+// Интерполяция в точке, уже ограниченной диапазоном сетки
+double BicubicInterpolator::interpolateClamped(double x, double y) const {
+  return WithCubicKernel(kernel_, [&](auto kernel) {
+    return interpolateWith<decltype(kernel)>(x, y);
+  });
+}
+
+template <typename Kernel>
+double BicubicInterpolator::interpolateWith(double x, double y) const {
   // Находим ближайший нижний левый узел сетки
   int x0 = static_cast<int>(std::floor(x));
   int y0 = static_cast<int>(std::floor(y));
@@ -118,23 +284,172 @@ double BicubicInterpolator::interpolate(double xx, double yy) const {
   // Для каждой строки выполняем кубическую интерполяцию по x
   double points[4][4];  // Матрица 4x4 окружающих точек
 
-  for (int j = -1; j <= 2; j++) {
-    for (int i = -1; i <= 2; i++) {
-      int yi = getBoundedIndex(y0 + j, rows);
-      int xi = getBoundedIndex(x0 + i, cols);
-      points[j + 1][i + 1] = values[yi][xi];
+  if (values) {
+    for (int j = -1; j <= 2; j++) {
+      for (int i = -1; i <= 2; i++) {
+        int yi = getBoundedIndex(y0 + j, rows);
+        int xi = getBoundedIndex(x0 + i, cols);
+        points[j + 1][i + 1] = values[static_cast<size_t>(yi) * cols + xi];
+      }
     }
+  } else {
+    tiles_->stencil(x0, y0, points);
   }
 
   // Интерполяция по x для каждой из 4 строк
   double temp[4];
   for (int j = 0; j < 4; j++) {
     double p[4] = {points[j][0], points[j][1], points[j][2], points[j][3]};
-    temp[j] = cubicInterpolate(p, dx);
+    temp[j] = Kernel::interpolate(p, dx);
   }
 
   // Интерполяция по y, используя результаты интерполяции по x
-  return cubicInterpolate(temp, dy);
+  return Kernel::interpolate(temp, dy);
+}
+
+InterpolatorCursor::InterpolatorCursor(const BicubicInterpolator& interpolator)
+    : interpolator_(interpolator), values_(interpolator.data()) {}
+
+double InterpolatorCursor::interpolate(double x, double y) {
+  if (!interpolator_.isInRange(x, y)) {
+    const int rows = interpolator_.rowCount(), cols = interpolator_.colCount();
+    std::cerr << "Warning: Interpolation point (" << x << ", " << y
+              << ") is outside the data range [0, " << cols - 1 << "] x [0, "
+              << rows - 1 << "]\n";
+    x = std::max(0.0, std::min(static_cast<double>(cols - 1.01), x));
+    y = std::max(0.0, std::min(static_cast<double>(rows - 1.01), y));
+  }
+  return WithCubicKernel(interpolator_.kernel(), [&](auto kernel) {
+    return interpolateWith<decltype(kernel)>(x, y);
+  });
+}
+
+size_t InterpolatorCursor::interpolateBatch(const double* xy, double* out,
+                                            size_t n) {
+  return WithCubicKernel(interpolator_.kernel(), [&](auto kernel) {
+    return interpolateBatchWith<decltype(kernel)>(xy, out, n);
+  });
+}
+
+template <typename Kernel>
+size_t InterpolatorCursor::interpolateBatchWith(const double* xy, double* out,
+                                                size_t n) {
+  const double maxX = static_cast<double>(interpolator_.colCount() - 1.01);
+  const double maxY = static_cast<double>(interpolator_.rowCount() - 1.01);
+  size_t outside = 0;
+
+  for (size_t i = 0; i < n; ++i) {
+    double x = xy[2 * i];
+    double y = xy[2 * i + 1];
+    if (!interpolator_.isInRange(x, y)) {
+      ++outside;
+      x = std::max(0.0, std::min(maxX, x));
+      y = std::max(0.0, std::min(maxY, y));
+    }
+    out[i] = interpolateWith<Kernel>(x, y);
+  }
+  return outside;
+}
+
+// Значение узла с ограничением индексов, как в getBoundedIndex
+double InterpolatorCursor::node(int x, int y) const {
+  const int rows = interpolator_.rowCount(), cols = interpolator_.colCount();
+  x = std::max(0, std::min(cols - 1, x));
+  y = std::max(0, std::min(rows - 1, y));
+  if (values_) return values_[static_cast<size_t>(y) * cols + x];
+  return interpolator_.tiles()->value(x, y);
+}
+
+// Точка уже ограничена диапазоном сетки
+template <typename Kernel>
+double InterpolatorCursor::interpolateWith(double x, double y) {
+  const int x0 = static_cast<int>(std::floor(x));
+  const int y0 = static_cast<int>(std::floor(y));
+  if (loaded_ && x0 == x0_ && y0 == y0_) {
+    ++hits_;
+  } else {
+    moveTo<Kernel>(x0, y0);
+  }
+
+  const double dx = x - x0;
+  double temp[4];
+  for (int j = 0; j < 4; ++j) temp[j] = Kernel::evaluate(rows_[j], dx);
+  double column[4];
+  Kernel::coefficients(temp, column);
+  return Kernel::evaluate(column, y - y0);
+}
+
+/*!
+ * \brief Переходит в ячейку (x0, y0).
+ *
+ * \details
+ * В соседнюю ячейку (в том числе по диагонали) окрестность сдвигается:
+ * сначала по x с чтением одного столбца, затем по y с чтением одной
+ * строки. Коэффициенты пересчитываются только для новой строки, а при
+ * сдвиге по x — для всех четырех.
+ */
+template <typename Kernel>
+void InterpolatorCursor::moveTo(int x0, int y0) {
+  const int sx = x0 - x0_, sy = y0 - y0_;
+  if (!loaded_ || sx < -1 || sx > 1 || sy < -1 || sy > 1) {
+    if (values_) {
+      for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 4; ++i) {
+          points_[j][i] = node(x0 - 1 + i, y0 - 1 + j);
+        }
+      }
+    } else {
+      interpolator_.tiles()->stencil(x0, y0, points_);
+    }
+    for (int j = 0; j < 4; ++j) Kernel::coefficients(points_[j], rows_[j]);
+    x0_ = x0;
+    y0_ = y0;
+    loaded_ = true;
+    ++fullLoads_;
+    return;
+  }
+
+  ++shifts_;
+  if (sx != 0) {
+    // Новый столбец: x0 + 2 при движении вправо, x0 - 1 — влево
+    const int column = sx > 0 ? 3 : 0;
+    for (int j = 0; j < 4; ++j) {
+      double* row = points_[j];
+      if (sx > 0) {
+        row[0] = row[1];
+        row[1] = row[2];
+        row[2] = row[3];
+      } else {
+        row[3] = row[2];
+        row[2] = row[1];
+        row[1] = row[0];
+      }
+      row[column] = node(x0 - 1 + column, y0_ - 1 + j);
+    }
+    x0_ = x0;
+  }
+  int fresh = -1;
+  if (sy != 0) {
+    fresh = sy > 0 ? 3 : 0;
+    // Строки лежат подряд: сдвиг на одну строку — сдвиг на 4 значения
+    for (double* flat : {points_[0], rows_[0]}) {
+      if (sy > 0) {
+        std::copy(flat + 4, flat + 16, flat);
+      } else {
+        std::copy_backward(flat, flat + 12, flat + 16);
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      points_[fresh][i] = node(x0 - 1 + i, y0 - 1 + fresh);
+    }
+    y0_ = y0;
+  }
+
+  if (sx != 0) {
+    for (int j = 0; j < 4; ++j) Kernel::coefficients(points_[j], rows_[j]);
+  } else {
+    Kernel::coefficients(points_[fresh], rows_[fresh]);
+  }
 }
 
 FunctionNIntegratorBySimpson::FunctionNIntegratorBySimpson(
@@ -144,42 +459,302 @@ FunctionNIntegratorBySimpson::FunctionNIntegratorBySimpson(
   if (n_ <= 0) throw std::invalid_argument("n must be positive");
 }
 
+/*!
+ * \brief Конструктор для пакетной функции.
+ * \param[in] batchFunction Функция, вычисляемая сразу во всех узлах сетки.
+ * \param[in] n Количество интервалов.
+ */
+FunctionNIntegratorBySimpson::FunctionNIntegratorBySimpson(
+    const RealBatchFuncOfOneVar& batchFunction, int n)
+    : batchFunction_(batchFunction) {
+  n_ = (n % 2 != 0) ? n + 1 : n;
+  if (n_ <= 0) throw std::invalid_argument("n must be positive");
+}
+
+/*!
+ * \brief Заполняет узлы равномерной сетки t_i = param_start + i * h,
+ * i = 0..n.
+ */
+void FunctionNIntegratorBySimpson::nodes(double param_start, double param_end,
+                                         int n, std::vector<double>& t) {
+  const double h = (param_end - param_start) / n;
+  t.resize(n + 1);
+  for (int i = 0; i <= n; ++i) {
+    t[i] = param_start + i * h;
+  }
+}
+
+namespace {
+
+/*!
+ * \brief Вызывает fn(begin, count) для блоков из count узлов.
+ *
+ * \details
+ * Без запроса отмены весь диапазон — один блок; иначе перед каждым
+ * блоком из kCancelBlock узлов проверяется cancelled().
+ */
+template <typename Fn>
+void forEachBlock(size_t total, const CancelCheck& cancelled, Fn fn) {
+  const size_t block =
+      cancelled ? FunctionNIntegratorBySimpson::kCancelBlock : total;
+  for (size_t begin = 0; begin < total; begin += block) {
+    if (cancelled && cancelled()) {
+      throw std::runtime_error("Integration cancelled");
+    }
+    fn(begin, std::min(block, total - begin));
+  }
+}
+
+// Последовательная сумма: одинакова на всех процессорах
+double simpsonSumStrict(const double* values, size_t n) {
+  double sum = values[0] + values[n];
+
+  for (size_t i = 1; i < n; i += 2) {
+    sum += 4.0 * values[i];
+  }
+  for (size_t i = 2; i < n; i += 2) {
+    sum += 2.0 * values[i];
+  }
+  return sum;
+}
+
+// Векторная редукция: порядок сложения зависит от ширины векторов
+inline double simpsonSumSimd(const double* values, size_t n) {
+  const size_t half = n / 2;
+  double odd = 0.0, even = 0.0;
+#pragma omp simd reduction(+ : odd)
+  for (size_t k = 0; k < half; ++k) odd += values[2 * k + 1];
+#pragma omp simd reduction(+ : even)
+  for (size_t k = 1; k < half; ++k) even += values[2 * k];
+  return values[0] + values[n] + 4.0 * odd + 2.0 * even;
+}
+
+#ifdef BICUBIC_ISA_DISPATCH
+BICUBIC_TARGET("avx2,fma")
+double simpsonSumAvx2(const double* values, size_t n) {
+  return simpsonSumSimd(values, n);
+}
+
+BICUBIC_TARGET("avx512f,avx2,fma")
+double simpsonSumAvx512(const double* values, size_t n) {
+  return simpsonSumSimd(values, n);
+}
+#endif
+
+}  // namespace
+
+/*!
+ * \brief Квадратурная сумма Симпсона по значениям во всех n + 1 узлах.
+ *
+ * \details
+ * Вариант суммирования выбирается CpuDispatch; в строгом режиме слагаемые
+ * складываются последовательно и результат не зависит от процессора.
+ */
+double FunctionNIntegratorBySimpson::weightedSum(
+    const std::vector<double>& values, double h) {
+  const size_t n = values.size() - 1;
+  double sum;
+  if (CpuDispatch::strict()) {
+    sum = simpsonSumStrict(values.data(), n);
+  } else {
+#ifdef BICUBIC_ISA_DISPATCH
+    switch (CpuDispatch::active()) {
+      case IsaLevel::Avx512:
+        sum = simpsonSumAvx512(values.data(), n);
+        break;
+      case IsaLevel::Avx2Fma:
+        sum = simpsonSumAvx2(values.data(), n);
+        break;
+      default:
+        sum = simpsonSumSimd(values.data(), n);
+    }
+#else
+    sum = simpsonSumSimd(values.data(), n);
+#endif
+  }
+
+  return sum * h / 3.0;
+}
+
 // Реализация метода integrate
-double FunctionNIntegratorBySimpson::integrate(double param_start,
-                                               double param_end) const {
+double FunctionNIntegratorBySimpson::integrate(
+    double param_start, double param_end,
+    const CancelCheck& cancelled) const {
   if (param_start == param_end) return 0.0;
 
   const double h = (param_end - param_start) / n_;
 
+  // Пакетная функция вычисляется сразу во всех узлах
+  if (batchFunction_) {
+    std::vector<double> t;
+    nodes(param_start, param_end, n_, t);
+    std::vector<double> values(t.size());
+    {
+      TraceSpan span("simpson.evaluate");
+      forEachBlock(t.size(), cancelled, [&](size_t begin, size_t count) {
+        batchFunction_(t.data() + begin, values.data() + begin, count);
+      });
+    }
+    TraceSpan span("simpson.reduce");
+    return weightedSum(values, h);
+  }
+
+  TraceSpan span("simpson.scalar");
+
   double sum = (function_(param_start)) + (function_(param_end));
 
-  for (int i = 1; i < n_; i += 2) {
-    sum += 4.0 * (function_(param_start + i * h));
-  }
-  for (int i = 2; i < n_; i += 2) {
-    sum += 2.0 * (function_(param_start + i * h));
-  }
+  // Нечетные узлы 2k + 1 < n_ и четные 2k < n_ (k >= 1)
+  const size_t odd = static_cast<size_t>(n_) / 2;
+  const size_t even = (static_cast<size_t>(n_) + 1) / 2;
+  forEachBlock(odd, cancelled, [&](size_t begin, size_t count) {
+    for (size_t k = begin; k < begin + count; ++k) {
+      sum += 4.0 * (function_(param_start + (2 * k + 1) * h));
+    }
+  });
+  forEachBlock(even, cancelled, [&](size_t begin, size_t count) {
+    for (size_t k = std::max<size_t>(begin, 1); k < begin + count; ++k) {
+      sum += 2.0 * (function_(param_start + (2 * k) * h));
+    }
+  });
 
   return sum * h / 3.0;
 }
 
 ParametricCurveIntegrator::ParametricCurveIntegrator(
-    const BicubicInterpolator& interpolator,
+    std::shared_ptr<const BicubicInterpolator> interpolator,
     RealFuncOfOneVar xFunc, RealFuncOfOneVar yFunc)
-    : interpolator_(interpolator),
+    : interpolator_(std::move(interpolator)),
       xFunc_(std::move(xFunc)),
       yFunc_(std::move(yFunc)) {}
 
-double ParametricCurveIntegrator::integrate(double t_start, double t_end,
-                                            int n) const {
+ParametricCurveIntegrator::ParametricCurveIntegrator(
+    std::shared_ptr<const BicubicInterpolator> interpolator,
+    RealBatchFuncOfOneVar xBatchFunc, RealBatchFuncOfOneVar yBatchFunc)
+    : interpolator_(std::move(interpolator)) {
+  curveBatchFunc_ = [xBatchFunc, yBatchFunc](const double* t, double* x,
+                                             double* y, size_t n) {
+    xBatchFunc(t, x, n);
+    yBatchFunc(t, y, n);
+  };
+}
+
+/*!
+ * \brief Конструктор для кривой, у которой x(t) и y(t) вычисляются
+ * совместно (например, одной программой с общими подвыражениями).
+ */
+ParametricCurveIntegrator::ParametricCurveIntegrator(
+    std::shared_ptr<const BicubicInterpolator> interpolator,
+    CurveBatchFunc curveBatchFunc)
+    : interpolator_(std::move(interpolator)),
+      curveBatchFunc_(std::move(curveBatchFunc)) {}
+
+/*!
+ * \brief Конструктор для кривой, вычисляемой вместе с производными.
+ *
+ * \details
+ * Такой интегратор поддерживает и integrate, и integrateArcLength.
+ */
+ParametricCurveIntegrator::ParametricCurveIntegrator(
+    std::shared_ptr<const BicubicInterpolator> interpolator,
+    CurveDerivativeBatchFunc curveDerivativeFunc)
+    : interpolator_(std::move(interpolator)),
+      curveDerivativeFunc_(std::move(curveDerivativeFunc)) {
+  curveBatchFunc_ = [f = curveDerivativeFunc_](const double* t, double* x,
+                                               double* y, size_t n) {
+    std::vector<double> dx(n), dy(n);
+    f(t, x, y, dx.data(), dy.data(), n);
+  };
+}
+
+double ParametricCurveIntegrator::integrate(
+    double t_start, double t_end, int n, const CancelCheck& cancelled) const {
+  // Пакетная кривая: координаты всех узлов считаются за один вызов
+  if (curveBatchFunc_) {
+    if (t_start == t_end) return 0.0;
+    const int even_n = (n % 2 != 0) ? n + 1 : n;
+    if (even_n <= 0) throw std::invalid_argument("n must be positive");
+
+    std::vector<double> t;
+    FunctionNIntegratorBySimpson::nodes(t_start, t_end, even_n, t);
+    std::vector<double> x(t.size());
+    std::vector<double> y(t.size());
+    {
+      TraceSpan span("curve.evaluate");
+      forEachBlock(t.size(), cancelled, [&](size_t begin, size_t count) {
+        curveBatchFunc_(t.data() + begin, x.data() + begin, y.data() + begin,
+                        count);
+      });
+    }
+
+    // Узлы упорядочены по t: соседние точки обычно в одной ячейке
+    std::vector<double> values(t.size());
+    {
+      TraceSpan span("curve.interpolate");
+      InterpolatorCursor cursor(*interpolator_);
+      forEachBlock(t.size(), cancelled, [&](size_t begin, size_t count) {
+        for (size_t i = begin; i < begin + count; ++i) {
+          values[i] = cursor.interpolate(x[i], y[i]);
+        }
+      });
+    }
+    TraceSpan span("curve.reduce");
+    return FunctionNIntegratorBySimpson::weightedSum(
+        values, (t_end - t_start) / even_n);
+  }
+
   // Создаем обертку для функции кривой
   auto curveFunc = [this](double t) {
     const double x = this->xFunc_(t);
     const double y = this->yFunc_(t);
-    return this->interpolator_.interpolate(x, y);
+    return this->interpolator_->interpolate(x, y);
   };
 
   // Создаем интегратор и выполняем вычисления
   FunctionNIntegratorBySimpson integrator(curveFunc, n);
-  return integrator.integrate(t_start, t_end);
-}
\ No newline at end of file
+  return integrator.integrate(t_start, t_end, cancelled);
+}
+/*!
+ * \brief Интеграл по длине дуги: int f(x(t), y(t)) |r'(t)| dt.
+ * \param[in] t_start Начало интервала параметра.
+ * \param[in] t_end Конец интервала параметра.
+ * \param[in] n Количество интервалов Симпсона.
+ * \return Значение криволинейного интеграла первого рода.
+ * \throws std::logic_error Если интегратор создан без производных кривой.
+ */
+double ParametricCurveIntegrator::integrateArcLength(
+    double t_start, double t_end, int n, const CancelCheck& cancelled) const {
+  if (!curveDerivativeFunc_) {
+    throw std::logic_error("Arc length integration requires curve derivatives");
+  }
+  if (t_start == t_end) return 0.0;
+  const int even_n = (n % 2 != 0) ? n + 1 : n;
+  if (even_n <= 0) throw std::invalid_argument("n must be positive");
+
+  std::vector<double> t;
+  FunctionNIntegratorBySimpson::nodes(t_start, t_end, even_n, t);
+  const size_t count = t.size();
+  std::vector<double> x(count), y(count), dx(count), dy(count);
+  {
+    TraceSpan span("curve.evaluate");
+    forEachBlock(count, cancelled, [&](size_t begin, size_t block) {
+      curveDerivativeFunc_(t.data() + begin, x.data() + begin,
+                           y.data() + begin, dx.data() + begin,
+                           dy.data() + begin, block);
+    });
+  }
+
+  std::vector<double> values(count);
+  {
+    TraceSpan span("curve.interpolate");
+    InterpolatorCursor cursor(*interpolator_);
+    forEachBlock(count, cancelled, [&](size_t begin, size_t block) {
+      for (size_t i = begin; i < begin + block; ++i) {
+        values[i] = cursor.interpolate(x[i], y[i]) *
+                    std::sqrt(dx[i] * dx[i] + dy[i] * dy[i]);
+      }
+    });
+  }
+  TraceSpan span("curve.reduce");
+  return FunctionNIntegratorBySimpson::weightedSum(
+      values, (t_end - t_start) / even_n);
+}
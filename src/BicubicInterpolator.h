@@ -5,8 +5,32 @@
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
+#include "CpuDispatch.h"
+#include "CubicKernel.h"
+#include "TiledGrid.h"
+
+//! Пакетная функция одной переменной: out[i] = f(t[i]) для i < n
+typedef std::function<void(const double* t, double* out, size_t n)>
+    RealBatchFuncOfOneVar;
+
+//! Пакетная параметрическая кривая: (x[i], y[i]) = (x(t[i]), y(t[i]))
+typedef std::function<void(const double* t, double* x, double* y, size_t n)>
+    CurveBatchFunc;
+
+//! Пакетная кривая с производными: дополнительно dx[i] = x'(t[i]),
+//! dy[i] = y'(t[i])
+typedef std::function<void(const double* t, double* x, double* y, double* dx,
+                           double* dy, size_t n)>
+    CurveDerivativeBatchFunc;
+
+//! Запрос отмены: интеграторы проверяют его между блоками узлов и при
+//! true бросают std::runtime_error
+typedef std::function<bool()> CancelCheck;
+
 /*!
  * \class BicubicInterpolator
  * \brief Класс для выполнения бикубической интерполяции на двумерной сетке.
@@ -14,24 +38,120 @@
  * Класс позволяет интерполировать значения на двумерной сетке с использованием
  * бикубической интерполяции. Входные данные представляют собой прямоугольную
  * матрицу значений, а интерполяция выполняется в произвольной точке (x, y).
+ * Сетка хранится одним непрерывным массивом по строкам, которым интерполятор
+ * владеет совместно с источником (см. Snapshot.h), или плитками TiledGrid.
  */
 class BicubicInterpolator {
  public:
   explicit BicubicInterpolator(const std::vector<std::vector<double>>& data);
+  BicubicInterpolator(std::vector<double> data, int rows, int cols,
+                      CubicKernelType kernel = CubicKernelType::CatmullRom);
+  BicubicInterpolator(std::shared_ptr<const double> data, int rows, int cols,
+                      CubicKernelType kernel = CubicKernelType::CatmullRom);
+  explicit BicubicInterpolator(
+      std::shared_ptr<const TiledGrid> tiles,
+      CubicKernelType kernel = CubicKernelType::CatmullRom);
   ~BicubicInterpolator();
 
   double interpolate(double x, double y) const;
+  size_t interpolateBatch(const double* xy, double* out, size_t n) const;
+  bool isInRange(double x, double y) const;
+
+  CubicKernelType kernel() const { return kernel_; }
+
+  //! Значения сетки по строкам: data()[y * colCount() + x]; nullptr при
+  //! хранении плитками. Для B-сплайна это коэффициенты после фильтрации
+  const double* data() const { return values; }
+  //! Значения сетки по строкам при любом способе хранения
+  std::shared_ptr<const double> denseData() const;
+  const TiledGrid* tiles() const { return tiles_.get(); }
+  size_t residentBytes() const;
+  int rowCount() const { return rows; }
+  int colCount() const { return cols; }
 
  private:
-  std::vector<std::vector<double>> values;
+  double interpolateClamped(double x, double y) const;
+  template <typename Kernel>
+  double interpolateWith(double x, double y) const;
+  template <typename Kernel>
+  size_t interpolateBatchWith(const double* xy, double* out, size_t n) const;
+  // Варианты пакета по наборам инструкций (CpuDispatch.h)
+  size_t interpolateBatchBaseline(const double* xy, double* out,
+                                  size_t n) const;
+#ifdef BICUBIC_ISA_DISPATCH
+  size_t interpolateBatchAvx2(const double* xy, double* out, size_t n) const;
+  size_t interpolateBatchAvx512(const double* xy, double* out, size_t n) const;
+#endif
+
+  // Значения сетки по строкам: values[y * cols + x]. Буфер принадлежит
+  // storage_: это может быть вектор или отображенный в память файл
+  std::shared_ptr<const double> storage_;
+  const double* values;
+  std::shared_ptr<const TiledGrid> tiles_;
+  CubicKernelType kernel_ = CubicKernelType::CatmullRom;
   int rows;
   int cols;
 
-  static double cubicInterpolate(double p[4], double x);
-  bool isInRange(double x, double y) const;
   int getBoundedIndex(int idx, int max) const;
 };
 
+/*!
+ * \class InterpolatorCursor
+ * \brief Интерполяция вдоль упорядоченной последовательности точек.
+ *
+ * Курсор хранит окрестность 4 x 4 текущей ячейки и коэффициенты ядра по x
+ * для каждой из четырех строк. Пока точки остаются в ячейке, значение
+ * вычисляется без округления координат, ограничения индексов и чтения
+ * сетки. При переходе в соседнюю ячейку читается только новая строка или
+ * новый столбец (4 значения), остальное сдвигается. Для произвольного
+ * порядка точек курсор не медленнее interpolate: ячейка просто читается
+ * заново. Результаты побитно совпадают с BicubicInterpolator::interpolate.
+ *
+ * Курсор ссылается на интерполятор и не должен его пережить; объект не
+ * потокобезопасен, у каждого потока свой курсор.
+ */
+class InterpolatorCursor {
+ public:
+  explicit InterpolatorCursor(const BicubicInterpolator& interpolator);
+
+  //! Как BicubicInterpolator::interpolate, включая предупреждение
+  double interpolate(double x, double y);
+  //! Как BicubicInterpolator::interpolateBatch, но без предупреждения
+  size_t interpolateBatch(const double* xy, double* out, size_t n);
+  //! Забывает текущую ячейку
+  void reset() { loaded_ = false; }
+
+  //! Ячейки, прочитанные целиком
+  size_t fullLoads() const { return fullLoads_; }
+  //! Переходы в соседнюю ячейку со сдвигом окрестности
+  size_t shifts() const { return shifts_; }
+  //! Точки в уже загруженной ячейке
+  size_t hits() const { return hits_; }
+
+ private:
+  friend class BicubicInterpolator;
+
+  template <typename Kernel>
+  double interpolateWith(double x, double y);
+  template <typename Kernel>
+  size_t interpolateBatchWith(const double* xy, double* out, size_t n);
+  template <typename Kernel>
+  void moveTo(int x0, int y0);
+  double node(int x, int y) const;
+
+  const BicubicInterpolator& interpolator_;
+  const double* values_;
+  bool loaded_ = false;
+  int x0_ = 0;
+  int y0_ = 0;
+  double points_[4][4];
+  // Коэффициенты ядра по x для строк points_
+  double rows_[4][4];
+  size_t fullLoads_ = 0;
+  size_t shifts_ = 0;
+  size_t hits_ = 0;
+};
+
 /*!
  * \class FunctionNIntegratorBySimpson
  * \brief Класс для выполнения численного интегрирования методом Симпсона.
@@ -44,28 +164,56 @@ class FunctionNIntegratorBySimpson {
  public:
   explicit FunctionNIntegratorBySimpson(
       const std::function<double(double)>& function, int n);
+  FunctionNIntegratorBySimpson(const RealBatchFuncOfOneVar& batchFunction,
+                               int n);
 
   ~FunctionNIntegratorBySimpson() = default;
 
-  double integrate(double param_start, double param_end) const;
+  double integrate(double param_start, double param_end,
+                   const CancelCheck& cancelled = CancelCheck()) const;
+
+  //! Узлов между проверками запроса отмены
+  static constexpr size_t kCancelBlock = 1 << 14;
+
+  static void nodes(double param_start, double param_end, int n,
+                    std::vector<double>& t);
+  static double weightedSum(const std::vector<double>& values, double h);
 
  private:
   int n_;
   std::function<double(double)> function_;
+  RealBatchFuncOfOneVar batchFunction_;
 };
 
 class ParametricCurveIntegrator {
  public:
-  ParametricCurveIntegrator(const BicubicInterpolator& interpolator,
-                            std::function<double(double)> xFunc,
-                            std::function<double(double)> yFunc);
+  ParametricCurveIntegrator(
+      std::shared_ptr<const BicubicInterpolator> interpolator,
+      std::function<double(double)> xFunc,
+      std::function<double(double)> yFunc);
+  ParametricCurveIntegrator(
+      std::shared_ptr<const BicubicInterpolator> interpolator,
+      RealBatchFuncOfOneVar xBatchFunc, RealBatchFuncOfOneVar yBatchFunc);
+  ParametricCurveIntegrator(
+      std::shared_ptr<const BicubicInterpolator> interpolator,
+      CurveBatchFunc curveBatchFunc);
+  ParametricCurveIntegrator(
+      std::shared_ptr<const BicubicInterpolator> interpolator,
+      CurveDerivativeBatchFunc curveDerivativeFunc);
 
-  double integrate(double t_start, double t_end, int n) const;
+  double integrate(double t_start, double t_end, int n,
+                   const CancelCheck& cancelled = CancelCheck()) const;
+  double integrateArcLength(double t_start, double t_end, int n,
+                            const CancelCheck& cancelled = CancelCheck()) const;
 
  private:
-  const BicubicInterpolator& interpolator_;
+  // Интерполятор живет, пока существует интегратор, даже если его
+  // дескриптор уже удален
+  std::shared_ptr<const BicubicInterpolator> interpolator_;
   std::function<double(double)> xFunc_;
   std::function<double(double)> yFunc_;
+  CurveBatchFunc curveBatchFunc_;
+  CurveDerivativeBatchFunc curveDerivativeFunc_;
 };
 #endif
 
@@ -0,0 +1,410 @@
+#include "BoundHierarchy.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+#include "ParallelFor.h"
+#include "Trace.h"
+
+namespace {
+
+// Предел числа шагов поиска экстремума; при достижении возвращается
+// лучшая найденная точка и честная оценка
+const size_t kMaxSearchSteps = size_t(1) << 22;
+
+//! Коэффициенты участка в базисе Бернштейна: c[j][i], j — по y, i — по x
+template <typename Kernel>
+void bernsteinPatch(const double points[4][4], double c[4][4]) {
+  double rows[4][4];
+  for (int j = 0; j < 4; ++j) Kernel::toBernstein(points[j], rows[j]);
+  for (int i = 0; i < 4; ++i) {
+    const double column[4] = {rows[0][i], rows[1][i], rows[2][i], rows[3][i]};
+    double b[4];
+    Kernel::toBernstein(column, b);
+    for (int j = 0; j < 4; ++j) c[j][i] = b[j];
+  }
+}
+
+//! Деление кубического полинома Бернштейна пополам (де Кастельжо)
+void splitHalf(const double b[4], double left[4], double right[4]) {
+  const double b01 = 0.5 * (b[0] + b[1]);
+  const double b12 = 0.5 * (b[1] + b[2]);
+  const double b23 = 0.5 * (b[2] + b[3]);
+  const double b012 = 0.5 * (b01 + b12);
+  const double b123 = 0.5 * (b12 + b23);
+  const double middle = 0.5 * (b012 + b123);
+  left[0] = b[0];
+  left[1] = b01;
+  left[2] = b012;
+  left[3] = middle;
+  right[0] = middle;
+  right[1] = b123;
+  right[2] = b23;
+  right[3] = b[3];
+}
+
+typedef std::array<double, 16> Patch;
+
+double patchMax(const Patch& patch) {
+  return *std::max_element(patch.begin(), patch.end());
+}
+
+/*!
+ * \brief Кандидат поиска: узел дерева (level >= 0) или часть ячейки
+ * (level < 0) с коэффициентами Бернштейна, умноженными на знак поиска.
+ */
+struct Candidate {
+  double upper;
+  int level;
+  int x;
+  int y;
+  double u0;
+  double v0;
+  double size;
+  Patch patch;
+
+  bool operator<(const Candidate& other) const { return upper < other.upper; }
+};
+
+}  // namespace
+
+/*!
+ * \brief Строит дерево оценок.
+ * \param[in] interpolator Интерполятор; хранится в дереве.
+ * \param[in] threads Количество потоков для листьев; 0 — по числу ядер.
+ * \throws std::invalid_argument Если в сетке меньше 2 узлов по какой-либо
+ * оси.
+ */
+BoundHierarchy::BoundHierarchy(
+    std::shared_ptr<const BicubicInterpolator> interpolator, size_t threads)
+    : interpolator_(std::move(interpolator)) {
+  if (!interpolator_ || interpolator_->rowCount() < 2 ||
+      interpolator_->colCount() < 2) {
+    throw std::invalid_argument("Bound hierarchy needs at least 2 x 2 nodes");
+  }
+  TraceSpan span("bounds.build");
+  values_ = interpolator_->denseData();
+  cellsX_ = interpolator_->colCount() - 1;
+  cellsY_ = interpolator_->rowCount() - 1;
+
+  Level leaves;
+  leaves.cells = kLeafCells;
+  leaves.width = (cellsX_ + kLeafCells - 1) / kLeafCells;
+  leaves.height = (cellsY_ + kLeafCells - 1) / kLeafCells;
+  const size_t leafCount = static_cast<size_t>(leaves.width) * leaves.height;
+  leaves.lower.assign(leafCount, std::numeric_limits<double>::infinity());
+  leaves.upper.assign(leafCount, -std::numeric_limits<double>::infinity());
+
+  // Каждая строка листьев заполняется одним потоком
+  ParallelFor(
+      leaves.height, threads,
+      [&](size_t begin, size_t end) {
+        for (size_t ly = begin; ly < end; ++ly) {
+          const int lastRow =
+              std::min(cellsY_, static_cast<int>(ly + 1) * kLeafCells);
+          for (int cy = static_cast<int>(ly) * kLeafCells; cy < lastRow; ++cy) {
+            for (int cx = 0; cx < cellsX_; ++cx) {
+              double low, high;
+              cellBounds(cx, cy, low, high);
+              const size_t leaf = ly * leaves.width + cx / kLeafCells;
+              leaves.lower[leaf] = std::min(leaves.lower[leaf], low);
+              leaves.upper[leaf] = std::max(leaves.upper[leaf], high);
+            }
+          }
+        }
+      },
+      4);
+  levels_.push_back(std::move(leaves));
+
+  while (levels_.back().width > 1 || levels_.back().height > 1) {
+    const Level& below = levels_.back();
+    Level level;
+    level.cells = below.cells * 2;
+    level.width = (below.width + 1) / 2;
+    level.height = (below.height + 1) / 2;
+    const size_t count = static_cast<size_t>(level.width) * level.height;
+    level.lower.assign(count, std::numeric_limits<double>::infinity());
+    level.upper.assign(count, -std::numeric_limits<double>::infinity());
+    for (int y = 0; y < below.height; ++y) {
+      for (int x = 0; x < below.width; ++x) {
+        const size_t from = static_cast<size_t>(y) * below.width + x;
+        const size_t to = static_cast<size_t>(y / 2) * level.width + x / 2;
+        level.lower[to] = std::min(level.lower[to], below.lower[from]);
+        level.upper[to] = std::max(level.upper[to], below.upper[from]);
+      }
+    }
+    levels_.push_back(std::move(level));
+  }
+}
+
+size_t BoundHierarchy::memoryBytes() const {
+  size_t bytes = sizeof(*this);
+  for (const Level& level : levels_) {
+    bytes += (level.lower.capacity() + level.upper.capacity()) * sizeof(double);
+  }
+  return bytes;
+}
+
+// Узлы окрестности ячейки с повтором крайних, как в интерполяторе
+void BoundHierarchy::stencil(int cx, int cy, double points[4][4]) const {
+  const int rows = cellsY_ + 1, cols = cellsX_ + 1;
+  const double* values = values_.get();
+  for (int j = 0; j < 4; ++j) {
+    const int y = std::max(0, std::min(rows - 1, cy - 1 + j));
+    for (int i = 0; i < 4; ++i) {
+      const int x = std::max(0, std::min(cols - 1, cx - 1 + i));
+      points[j][i] = values[static_cast<size_t>(y) * cols + x];
+    }
+  }
+}
+
+void BoundHierarchy::cellBounds(int cx, int cy, double& lower,
+                                double& upper) const {
+  double points[4][4];
+  stencil(cx, cy, points);
+  WithCubicKernel(interpolator_->kernel(), [&](auto kernel) {
+    typedef decltype(kernel) Kernel;
+    if constexpr (Kernel::kBernstein) {
+      double c[4][4];
+      bernsteinPatch<Kernel>(points, c);
+      lower = upper = c[0][0];
+      for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 4; ++i) {
+          lower = std::min(lower, c[j][i]);
+          upper = std::max(upper, c[j][i]);
+        }
+      }
+    } else {
+      // Монотонное ядро не выходит за значения в углах ячейки
+      lower = std::min(std::min(points[1][1], points[1][2]),
+                       std::min(points[2][1], points[2][2]));
+      upper = std::max(std::max(points[1][1], points[1][2]),
+                       std::max(points[2][1], points[2][2]));
+    }
+  });
+}
+
+BoundHierarchy::Extremum BoundHierarchy::maximum(double tolerance) const {
+  return search(1.0, tolerance);
+}
+
+BoundHierarchy::Extremum BoundHierarchy::minimum(double tolerance) const {
+  return search(-1.0, tolerance);
+}
+
+/*!
+ * \brief Поиск максимума sign * f методом ветвей и границ.
+ *
+ * \details
+ * Кандидаты извлекаются в порядке убывания верхней оценки. Узлы дерева
+ * раскрываются в дочерние, листья — в ячейки, ячейки с полиномиальным
+ * ядром делятся пополам по обеим осям делением де Кастельжо. Значения в
+ * углах каждой части точны (крайние коэффициенты Бернштейна) и дают
+ * нижнюю оценку. Поиск заканчивается, когда лучшая верхняя оценка
+ * превышает найденное значение не больше чем на tolerance.
+ */
+BoundHierarchy::Extremum BoundHierarchy::search(double sign,
+                                                double tolerance) const {
+  TraceSpan span("bounds.extremum");
+  const bool polynomial =
+      interpolator_->kernel() != CubicKernelType::MonotoneHermite;
+  double best = -std::numeric_limits<double>::infinity();
+  double bestX = 0.0, bestY = 0.0;
+  auto offer = [&](double value, double x, double y) {
+    if (value > best) {
+      best = value;
+      bestX = x;
+      bestY = y;
+    }
+  };
+
+  std::priority_queue<Candidate> queue;
+  auto pushNode = [&](int level, int x, int y) {
+    const Level& nodes = levels_[level];
+    const size_t index = static_cast<size_t>(y) * nodes.width + x;
+    Candidate node = {};
+    node.upper = sign > 0 ? nodes.upper[index] : -nodes.lower[index];
+    node.level = level;
+    node.x = x;
+    node.y = y;
+    queue.push(node);
+  };
+  // Часть ячейки: углы точны, остальное — в очередь, если может улучшить
+  auto pushPatch = [&](int cx, int cy, double u0, double v0, double size,
+                       const Patch& patch) {
+    offer(patch[0], cx + u0, cy + v0);
+    offer(patch[3], cx + u0 + size, cy + v0);
+    offer(patch[12], cx + u0, cy + v0 + size);
+    offer(patch[15], cx + u0 + size, cy + v0 + size);
+    Candidate part;
+    part.upper = patchMax(patch);
+    if (part.upper <= best + tolerance) return;
+    part.level = -1;
+    part.x = cx;
+    part.y = cy;
+    part.u0 = u0;
+    part.v0 = v0;
+    part.size = size;
+    part.patch = patch;
+    queue.push(part);
+  };
+  auto expandCell = [&](int cx, int cy) {
+    double points[4][4];
+    stencil(cx, cy, points);
+    if (!polynomial) {
+      for (int j = 1; j <= 2; ++j) {
+        for (int i = 1; i <= 2; ++i) {
+          offer(sign * points[j][i], cx + i - 1, cy + j - 1);
+        }
+      }
+      return;
+    }
+    double c[4][4];
+    WithCubicKernel(interpolator_->kernel(), [&](auto kernel) {
+      typedef decltype(kernel) Kernel;
+      if constexpr (Kernel::kBernstein) bernsteinPatch<Kernel>(points, c);
+    });
+    Patch patch;
+    for (int k = 0; k < 16; ++k) patch[k] = sign * c[k / 4][k % 4];
+    pushPatch(cx, cy, 0.0, 0.0, 1.0, patch);
+  };
+
+  pushNode(static_cast<int>(levels_.size()) - 1, 0, 0);
+  size_t visited = 0;
+  double bound = best;
+  while (!queue.empty()) {
+    const Candidate candidate = queue.top();
+    if (candidate.upper <= best + tolerance || visited >= kMaxSearchSteps) {
+      bound = std::max(best, candidate.upper);
+      break;
+    }
+    queue.pop();
+    ++visited;
+
+    if (candidate.level > 0) {
+      const Level& children = levels_[candidate.level - 1];
+      for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+          const int x = 2 * candidate.x + dx, y = 2 * candidate.y + dy;
+          if (x < children.width && y < children.height) {
+            pushNode(candidate.level - 1, x, y);
+          }
+        }
+      }
+    } else if (candidate.level == 0) {
+      const int x1 = std::min(cellsX_, (candidate.x + 1) * kLeafCells);
+      const int y1 = std::min(cellsY_, (candidate.y + 1) * kLeafCells);
+      for (int cy = candidate.y * kLeafCells; cy < y1; ++cy) {
+        for (int cx = candidate.x * kLeafCells; cx < x1; ++cx) {
+          expandCell(cx, cy);
+        }
+      }
+    } else {
+      // Деление части ячейки на четыре: сначала строки (по x), затем столбцы
+      Patch halves[2];
+      for (int j = 0; j < 4; ++j) {
+        splitHalf(&candidate.patch[4 * j], &halves[0][4 * j],
+                  &halves[1][4 * j]);
+      }
+      const double half = 0.5 * candidate.size;
+      for (int sx = 0; sx < 2; ++sx) {
+        Patch parts[2];
+        for (int i = 0; i < 4; ++i) {
+          const double column[4] = {halves[sx][i], halves[sx][4 + i],
+                                    halves[sx][8 + i], halves[sx][12 + i]};
+          double top[4], bottom[4];
+          splitHalf(column, top, bottom);
+          for (int j = 0; j < 4; ++j) {
+            parts[0][4 * j + i] = top[j];
+            parts[1][4 * j + i] = bottom[j];
+          }
+        }
+        for (int sy = 0; sy < 2; ++sy) {
+          pushPatch(candidate.x, candidate.y, candidate.u0 + sx * half,
+                    candidate.v0 + sy * half, half, parts[sy]);
+        }
+      }
+    }
+  }
+  if (queue.empty()) bound = best;
+
+  return {bestX, bestY, sign * best, sign * bound, visited};
+}
+
+/*!
+ * \details
+ * Ячейки возвращаются по одной с partial = true; узел дерева, вся оценка
+ * которого совпадает с level (постоянная область), — одним прямоугольником.
+ */
+std::vector<BoundHierarchy::CellRange> BoundHierarchy::levelSetCells(
+    double level, size_t* visited) const {
+  TraceSpan span("bounds.level_set");
+  std::vector<CellRange> cells;
+  size_t count = 0;
+  collect(static_cast<int>(levels_.size()) - 1, 0, 0, level, level, cells,
+          count);
+  if (visited) *visited = count;
+  return cells;
+}
+
+/*!
+ * \details
+ * Узлы дерева, в которых поверхность заведомо не меньше threshold,
+ * возвращаются целиком одним прямоугольником с partial = false; ячейки на
+ * границе области — по одной с partial = true.
+ */
+std::vector<BoundHierarchy::CellRange> BoundHierarchy::thresholdCells(
+    double threshold, size_t* visited) const {
+  TraceSpan span("bounds.threshold");
+  std::vector<CellRange> cells;
+  size_t count = 0;
+  collect(static_cast<int>(levels_.size()) - 1, 0, 0, threshold,
+          std::numeric_limits<double>::infinity(), cells, count);
+  if (visited) *visited = count;
+  return cells;
+}
+
+// Спуск к узлам, оценка которых пересекает [low, high]
+void BoundHierarchy::collect(int level, int nx, int ny, double low,
+                             double high, std::vector<CellRange>& out,
+                             size_t& visited) const {
+  ++visited;
+  const Level& nodes = levels_[level];
+  const size_t index = static_cast<size_t>(ny) * nodes.width + nx;
+  if (nodes.upper[index] < low || nodes.lower[index] > high) return;
+
+  const int x0 = nx * nodes.cells, y0 = ny * nodes.cells;
+  const int x1 = std::min(cellsX_, x0 + nodes.cells);
+  const int y1 = std::min(cellsY_, y0 + nodes.cells);
+  if (nodes.lower[index] >= low && nodes.upper[index] <= high) {
+    out.push_back({x0, y0, x1, y1, false});
+    return;
+  }
+
+  if (level == 0) {
+    for (int cy = y0; cy < y1; ++cy) {
+      for (int cx = x0; cx < x1; ++cx) {
+        double lower, upper;
+        cellBounds(cx, cy, lower, upper);
+        ++visited;
+        if (upper < low || lower > high) continue;
+        const bool partial = !(lower >= low && upper <= high);
+        out.push_back({cx, cy, cx + 1, cy + 1, partial});
+      }
+    }
+    return;
+  }
+
+  const Level& children = levels_[level - 1];
+  for (int dy = 0; dy < 2; ++dy) {
+    for (int dx = 0; dx < 2; ++dx) {
+      const int x = 2 * nx + dx, y = 2 * ny + dy;
+      if (x < children.width && y < children.height) {
+        collect(level - 1, x, y, low, high, out, visited);
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef BOUNDHIERARCHY_H
+#define BOUNDHIERARCHY_H
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "BicubicInterpolator.h"
+
+/*!
+ * \class BoundHierarchy
+ * \brief Дерево оценок min/max интерполированной поверхности.
+ *
+ * Ячейка сетки (x0, y0) — участок [x0, x0 + 1] x [y0, y0 + 1]. Для ядер,
+ * линейных по значениям, участок — бикубический полином, и его значения
+ * лежат между наименьшим и наибольшим коэффициентом в базисе Бернштейна;
+ * для монотонного эрмитова ядра — между значениями в четырех углах ячейки.
+ * Листья дерева — блоки kLeafCells x kLeafCells ячеек, каждый следующий
+ * уровень объединяет 2 x 2 узла предыдущего. Оценки консервативны:
+ * поверхность никогда не выходит за оценку узла.
+ *
+ * Запросы спускаются только в узлы, чья оценка может дать ответ, поэтому
+ * их стоимость определяется размером ответа, а не размером сетки.
+ */
+class BoundHierarchy {
+ public:
+  static constexpr int kLeafCells = 4;
+
+  //! Точка экстремума и гарантированная оценка
+  struct Extremum {
+    double x;
+    double y;
+    double value;
+    //! Оценка экстремума: |bound - value| <= tolerance
+    double bound;
+    //! Количество рассмотренных узлов, ячеек и частей ячеек
+    size_t visited;
+  };
+
+  //! Прямоугольник ячеек [x0, x1) x [y0, y1)
+  struct CellRange {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    //! false, если условие заведомо выполняется во всем прямоугольнике
+    bool partial;
+  };
+
+  explicit BoundHierarchy(
+      std::shared_ptr<const BicubicInterpolator> interpolator,
+      size_t threads = 0);
+
+  Extremum maximum(double tolerance = 1e-9) const;
+  Extremum minimum(double tolerance = 1e-9) const;
+
+  //! Ячейки, в которых поверхность может принимать значение level
+  std::vector<CellRange> levelSetCells(double level,
+                                       size_t* visited = nullptr) const;
+  //! Ячейки, в которых поверхность может быть не меньше threshold
+  std::vector<CellRange> thresholdCells(double threshold,
+                                        size_t* visited = nullptr) const;
+
+  //! Оценка по всей поверхности
+  double lowerBound() const { return levels_.back().lower[0]; }
+  double upperBound() const { return levels_.back().upper[0]; }
+  size_t memoryBytes() const;
+
+  //! Оценка значений одной ячейки
+  void cellBounds(int cx, int cy, double& lower, double& upper) const;
+
+ private:
+  struct Level {
+    int width;
+    int height;
+    int cells;  // Ячеек в стороне узла
+    std::vector<double> lower;
+    std::vector<double> upper;
+  };
+
+  Extremum search(double sign, double tolerance) const;
+  void collect(int level, int nx, int ny, double low, double high,
+               std::vector<CellRange>& out, size_t& visited) const;
+  void stencil(int cx, int cy, double points[4][4]) const;
+
+  std::shared_ptr<const BicubicInterpolator> interpolator_;
+  std::shared_ptr<const double> values_;
+  int cellsX_;
+  int cellsY_;
+  std::vector<Level> levels_;
+};
+#endif
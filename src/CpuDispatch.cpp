@@ -0,0 +1,85 @@
+#include "CpuDispatch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+namespace {
+
+IsaLevel detectIsa() {
+#ifdef BICUBIC_ISA_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma")) {
+    return IsaLevel::Avx512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return IsaLevel::Avx2Fma;
+  }
+#endif
+  return IsaLevel::Sse2;
+}
+
+// Набор при запуске: лучший доступный или BICUBIC_ISA, если он не выше
+int initialLevel() {
+  IsaLevel level = CpuDispatch::detected();
+  const char* requested = std::getenv("BICUBIC_ISA");
+  if (requested && *requested) {
+    for (IsaLevel candidate :
+         {IsaLevel::Sse2, IsaLevel::Avx2Fma, IsaLevel::Avx512}) {
+      if (std::strcmp(requested, CpuDispatch::isaName(candidate)) == 0 &&
+          candidate <= level) {
+        level = candidate;
+      }
+    }
+  }
+  return static_cast<int>(level);
+}
+
+bool initialStrict() {
+  const char* value = std::getenv("BICUBIC_STRICT");
+  return value && std::strcmp(value, "1") == 0;
+}
+
+}  // namespace
+
+std::atomic<int> CpuDispatch::active_{initialLevel()};
+std::atomic<bool> CpuDispatch::strict_{initialStrict()};
+
+IsaLevel CpuDispatch::detected() {
+  static const IsaLevel level = detectIsa();
+  return level;
+}
+
+bool CpuDispatch::select(IsaLevel level) {
+  if (level > detected()) return false;
+  active_.store(static_cast<int>(level), std::memory_order_relaxed);
+  return true;
+}
+
+void CpuDispatch::setStrict(bool strict) {
+  strict_.store(strict, std::memory_order_relaxed);
+}
+
+const char* CpuDispatch::isaName(IsaLevel level) {
+  switch (level) {
+    case IsaLevel::Avx2Fma:
+      return "avx2";
+    case IsaLevel::Avx512:
+      return "avx512";
+    default:
+      return "sse2";
+  }
+}
+
+const char* CpuDispatch::variantName() {
+  if (strict()) return "strict";
+  switch (active()) {
+    case IsaLevel::Avx2Fma:
+      return "avx2_fma";
+    case IsaLevel::Avx512:
+      return "avx512";
+    default:
+      return "sse2";
+  }
+}
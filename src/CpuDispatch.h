@@ -0,0 +1,59 @@
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+#include <atomic>
+
+/*!
+ * \file CpuDispatch.h
+ * \brief Выбор варианта вычислительных ядер по набору инструкций процессора.
+ *
+ * Горячие циклы (пакетная интерполяция, сумма Симпсона) компилируются в
+ * нескольких вариантах в одном двоичном файле: базовый x86-64 (SSE2),
+ * AVX2 + FMA и AVX-512. Вариант выбирается при первом обращении по
+ * возможностям процессора и может быть понижен вызовом select или
+ * переменной окружения BICUBIC_ISA (sse2, avx2, avx512).
+ *
+ * Варианты с FMA и векторными суммами дают результаты, отличающиеся от
+ * базового в последних битах. В строгом режиме (setStrict или
+ * BICUBIC_STRICT=1) всегда используется скалярный вариант без FMA с
+ * последовательным суммированием, и результаты побитно совпадают на всех
+ * процессорах x86-64. Для этого сборка не должна поднимать базовый
+ * уровень инструкций (-march).
+ *
+ * Варианты доступны при сборке GCC и Clang для x86-64; в остальных случаях
+ * (MSVC, другие архитектуры) используется только базовый вариант.
+ */
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define BICUBIC_ISA_DISPATCH 1
+//! Функция компилируется для набора isa; вызовы внутри встраиваются, чтобы
+//! и они получили тот же набор
+#define BICUBIC_TARGET(isa) __attribute__((target(isa), flatten))
+#endif
+
+//! Наборы инструкций в порядке возрастания
+enum class IsaLevel { Sse2 = 0, Avx2Fma = 1, Avx512 = 2 };
+
+class CpuDispatch {
+ public:
+  //! Лучший набор, поддерживаемый процессором и сборкой
+  static IsaLevel detected();
+  //! Набор, которым пользуются ядра (без учета строгого режима)
+  static IsaLevel active() {
+    return static_cast<IsaLevel>(active_.load(std::memory_order_relaxed));
+  }
+  //! Выбирает набор; false, если он не поддерживается
+  static bool select(IsaLevel level);
+
+  static bool strict() { return strict_.load(std::memory_order_relaxed); }
+  static void setStrict(bool strict);
+
+  static const char* isaName(IsaLevel level);
+  //! Вариант ядер: "strict", "sse2", "avx2_fma" или "avx512"
+  static const char* variantName();
+
+ private:
+  static std::atomic<int> active_;
+  static std::atomic<bool> strict_;
+};
+#endif
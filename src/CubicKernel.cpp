@@ -0,0 +1,136 @@
+#include "CubicKernel.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ParallelFor.h"
+#include "Trace.h"
+
+const char* CubicKernelName(CubicKernelType kernel) {
+  switch (kernel) {
+    case CubicKernelType::BSpline:
+      return "BSpline";
+    case CubicKernelType::MonotoneHermite:
+      return "MonotoneHermite";
+    default:
+      return "CatmullRom";
+  }
+}
+
+bool ParseCubicKernel(const std::string& name, CubicKernelType& kernel) {
+  for (CubicKernelType candidate :
+       {CubicKernelType::CatmullRom, CubicKernelType::BSpline,
+        CubicKernelType::MonotoneHermite}) {
+    if (name == CubicKernelName(candidate)) {
+      kernel = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace {
+
+// Столбцов в одной части прохода по медленной оси
+const size_t kColumnChunk = 512;
+
+/*!
+ * \brief Множители прогонки для системы (c[k-1] + 4 c[k] + c[k+1]) / 6 =
+ * f[k] длины n.
+ *
+ * \details
+ * За краем сетки узлы повторяют крайние (как в интерполяторе), поэтому в
+ * первой и последней строках на диагонали 5, а при n = 1 — 6. Матрица
+ * одна для всех линий оси, множители m[k] = 1 / (b[k] - m[k - 1])
+ * вычисляются один раз.
+ */
+std::vector<double> thomasFactors(int n) {
+  std::vector<double> m(n);
+  for (int k = 0; k < n; ++k) {
+    double diagonal = 4.0;
+    if (k == 0) diagonal += 1.0;
+    if (k == n - 1) diagonal += 1.0;
+    m[k] = 1.0 / (diagonal - (k > 0 ? m[k - 1] : 0.0));
+  }
+  return m;
+}
+
+// Линия подряд идущих значений (быстрая ось)
+void filterLine(double* line, const std::vector<double>& m) {
+  const int n = static_cast<int>(m.size());
+  line[0] = 6.0 * line[0] * m[0];
+  for (int k = 1; k < n; ++k) line[k] = (6.0 * line[k] - line[k - 1]) * m[k];
+  for (int k = n - 2; k >= 0; --k) line[k] -= m[k] * line[k + 1];
+}
+
+/*!
+ * \brief Столбцы [begin, end) медленной оси: прогонка идет строками
+ * целиком, так что доступ к памяти последовательный и векторизуется.
+ */
+void filterColumns(double* base, size_t stride, size_t begin, size_t end,
+                   const std::vector<double>& m) {
+  const int n = static_cast<int>(m.size());
+  double* first = base;
+  for (size_t i = begin; i < end; ++i) first[i] = 6.0 * first[i] * m[0];
+  for (int k = 1; k < n; ++k) {
+    double* row = base + k * stride;
+    const double* previous = row - stride;
+    const double factor = m[k];
+#pragma omp simd
+    for (size_t i = begin; i < end; ++i) {
+      row[i] = (6.0 * row[i] - previous[i]) * factor;
+    }
+  }
+  for (int k = n - 2; k >= 0; --k) {
+    double* row = base + k * stride;
+    const double* next = row + stride;
+    const double factor = m[k];
+#pragma omp simd
+    for (size_t i = begin; i < end; ++i) row[i] -= factor * next[i];
+  }
+}
+
+}  // namespace
+
+/*!
+ * \details
+ * Фильтр сепарабелен: по каждой оси решается трехдиагональная система
+ * прогонкой (рекурсивный фильтр вперед и назад). Быстрая ось
+ * обрабатывается линиями, остальные — полосами по kColumnChunk столбцов;
+ * линии и полосы распределяются по потокам.
+ */
+void BSplinePrefilter(double* values, const int* extents, int dimension,
+                      size_t threads) {
+  TraceSpan span("grid.bspline_prefilter");
+  size_t total = 1;
+  for (int d = 0; d < dimension; ++d) total *= static_cast<size_t>(extents[d]);
+
+  size_t stride = 1;
+  for (int d = 0; d < dimension; ++d) {
+    const size_t n = static_cast<size_t>(extents[d]);
+    const size_t outer = total / (n * stride);
+    const std::vector<double> m = thomasFactors(extents[d]);
+
+    if (d == 0) {
+      ParallelFor(outer, threads, [&](size_t begin, size_t end) {
+        for (size_t line = begin; line < end; ++line) {
+          filterLine(values + line * n, m);
+        }
+      });
+    } else {
+      const size_t chunks = (stride + kColumnChunk - 1) / kColumnChunk;
+      ParallelFor(
+          outer * chunks, threads,
+          [&](size_t begin, size_t end) {
+            for (size_t item = begin; item < end; ++item) {
+              const size_t block = item / chunks;
+              const size_t first = (item % chunks) * kColumnChunk;
+              filterColumns(values + block * n * stride, stride, first,
+                            std::min(stride, first + kColumnChunk), m);
+            }
+          },
+          1);
+    }
+    stride *= n;
+  }
+}
@@ -0,0 +1,170 @@
+#ifndef CUBICKERNEL_H
+#define CUBICKERNEL_H
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+/*!
+ * \file CubicKernel.h
+ * \brief Кубические ядра интерполяции, общие для интерполяторов всех
+ * размерностей.
+ *
+ * Ядро — класс-стратегия со статическим методом interpolate(p, x): значение
+ * по четырем соседним узлам p[0..3] в точке x из [0, 1] между p[1] и p[2].
+ * interpolate(p, x) равно evaluate(c, x) с c = coefficients(p): коэффициенты
+ * ячейки можно вычислить один раз и использовать для многих точек
+ * (InterpolatorCursor). Интерполяторы параметризуются ядром при компиляции,
+ * поэтому каждое ядро получает собственный внутренний цикл без косвенных
+ * вызовов. Ядра, линейные по значениям (kBernstein), также дают коэффициенты
+ * участка в базисе Бернштейна (toBernstein) для оценок сверху и снизу.
+ */
+
+//! Ядра, выбираемые при создании интерполятора во время работы
+enum class CubicKernelType { CatmullRom = 0, BSpline = 1, MonotoneHermite = 2 };
+
+const char* CubicKernelName(CubicKernelType kernel);
+//! Разбирает имя ядра ("CatmullRom", "BSpline", "MonotoneHermite")
+bool ParseCubicKernel(const std::string& name, CubicKernelType& kernel);
+
+/*!
+ * \brief Значение кубического полинома Катмулла-Рома по узлам p[0..3] в
+ * точке x из [0, 1] между p[1] и p[2].
+ */
+inline double catmullRom(const double p[4], double x) {
+  return p[1] + 0.5 * x *
+                    (p[2] - p[0] +
+                     x * (2.0 * p[0] - 5.0 * p[1] + 4.0 * p[2] - p[3] +
+                          x * (3.0 * (p[1] - p[2]) + p[3] - p[0])));
+}
+
+//! Интерполирующий сплайн Катмулла-Рома; проходит через узлы
+struct CatmullRomKernel {
+  static constexpr CubicKernelType kType = CubicKernelType::CatmullRom;
+  static constexpr bool kPrefilter = false;
+  static constexpr bool kBernstein = true;
+  static double interpolate(const double p[4], double x) {
+    return catmullRom(p, x);
+  }
+  //! Коэффициенты полинома в порядке вычисления catmullRom
+  static void coefficients(const double p[4], double c[4]) {
+    c[0] = p[1];
+    c[1] = p[2] - p[0];
+    c[2] = 2.0 * p[0] - 5.0 * p[1] + 4.0 * p[2] - p[3];
+    c[3] = 3.0 * (p[1] - p[2]) + p[3] - p[0];
+  }
+  static double evaluate(const double c[4], double x) {
+    return c[0] + 0.5 * x * (c[1] + x * (c[2] + x * c[3]));
+  }
+  //! Коэффициенты того же полинома в базисе Бернштейна на [0, 1]
+  static void toBernstein(const double p[4], double b[4]) {
+    b[0] = p[1];
+    b[1] = p[1] + (p[2] - p[0]) / 6.0;
+    b[2] = p[2] - (p[3] - p[1]) / 6.0;
+    b[3] = p[2];
+  }
+};
+
+/*!
+ * \brief Кубический B-сплайн: дважды непрерывно дифференцируем.
+ *
+ * Применяется к коэффициентам, а не к значениям: чтобы сплайн проходил
+ * через узлы, сетка один раз обрабатывается BSplinePrefilter.
+ */
+struct BSplineKernel {
+  static constexpr CubicKernelType kType = CubicKernelType::BSpline;
+  static constexpr bool kPrefilter = true;
+  static constexpr bool kBernstein = true;
+  static double interpolate(const double p[4], double x) {
+    double c[4];
+    coefficients(p, c);
+    return evaluate(c, x);
+  }
+  //! Шестикратные коэффициенты при степенях x
+  static void coefficients(const double p[4], double c[4]) {
+    c[0] = p[0] + 4.0 * p[1] + p[2];
+    c[1] = 3.0 * (p[2] - p[0]);
+    c[2] = 3.0 * (p[0] - 2.0 * p[1] + p[2]);
+    c[3] = 3.0 * (p[1] - p[2]) + p[3] - p[0];
+  }
+  static double evaluate(const double c[4], double x) {
+    return (c[0] + x * (c[1] + x * (c[2] + x * c[3]))) / 6.0;
+  }
+  static void toBernstein(const double p[4], double b[4]) {
+    b[0] = (p[0] + 4.0 * p[1] + p[2]) / 6.0;
+    b[1] = (2.0 * p[1] + p[2]) / 3.0;
+    b[2] = (p[1] + 2.0 * p[2]) / 3.0;
+    b[3] = (p[1] + 4.0 * p[2] + p[3]) / 6.0;
+  }
+};
+
+/*!
+ * \brief Эрмитов сплайн с ограниченными производными (Фритч-Карлсон).
+ *
+ * Производные в узлах — центральные разности, обнуляемые в экстремумах и
+ * ограниченные тройным наклоном ячейки, поэтому вдоль каждой оси значение
+ * не выходит за пределы [p[1], p[2]] и монотонные данные остаются
+ * монотонными.
+ */
+struct MonotoneHermiteKernel {
+  static constexpr CubicKernelType kType = CubicKernelType::MonotoneHermite;
+  static constexpr bool kPrefilter = false;
+  // Ядро нелинейно по значениям: двумерный участок — не тензорный полином
+  static constexpr bool kBernstein = false;
+  static double interpolate(const double p[4], double x) {
+    double c[4];
+    coefficients(p, c);
+    return evaluate(c, x);
+  }
+  //! Коэффициенты при степенях x; ограничение производных уже учтено
+  static void coefficients(const double p[4], double c[4]) {
+    const double d = p[2] - p[1];
+    double m1 = 0.0, m2 = 0.0;
+    if (d != 0.0) {
+      m1 = limitSlope(0.5 * (p[2] - p[0]), d);
+      m2 = limitSlope(0.5 * (p[3] - p[1]), d);
+    }
+    c[0] = p[1];
+    c[1] = m1;
+    c[2] = 3.0 * d - 2.0 * m1 - m2;
+    c[3] = m1 + m2 - 2.0 * d;
+  }
+  static double evaluate(const double c[4], double x) {
+    return c[0] + x * (c[1] + x * (c[2] + x * c[3]));
+  }
+
+ private:
+  static double limitSlope(double m, double d) {
+    if (m * d <= 0.0) return 0.0;
+    return std::abs(m) > 3.0 * std::abs(d) ? 3.0 * d : m;
+  }
+};
+
+/*!
+ * \brief Вызывает fn(Kernel{}) с ядром, соответствующим kernel.
+ *
+ * Выбор делается один раз, например на пакет точек; внутри fn ядро
+ * известно при компиляции.
+ */
+template <typename Fn>
+decltype(auto) WithCubicKernel(CubicKernelType kernel, Fn&& fn) {
+  switch (kernel) {
+    case CubicKernelType::BSpline:
+      return fn(BSplineKernel{});
+    case CubicKernelType::MonotoneHermite:
+      return fn(MonotoneHermiteKernel{});
+    default:
+      return fn(CatmullRomKernel{});
+  }
+}
+
+/*!
+ * \brief Преобразует значения сетки в коэффициенты кубического B-сплайна
+ * на месте.
+ * \param[in,out] values Сетка, первая координата меняется быстрее всех.
+ * \param[in] extents Количество узлов по каждой координате.
+ * \param[in] dimension Размерность сетки.
+ * \param[in] threads Количество потоков; 0 — по числу ядер.
+ */
+void BSplinePrefilter(double* values, const int* extents, int dimension,
+                      size_t threads = 0);
+#endif
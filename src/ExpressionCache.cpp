@@ -0,0 +1,146 @@
+#include "ExpressionCache.h"
+
+#include <cctype>
+
+CompiledExpressionCache::CompiledExpressionCache(size_t capacity)
+    : shards_(kShards), capacity_(capacity) {}
+
+/*!
+ * \brief Общий для процесса экземпляр кэша.
+ */
+CompiledExpressionCache& CompiledExpressionCache::instance() {
+  static CompiledExpressionCache cache;
+  return cache;
+}
+
+/*!
+ * \brief Нормализует текст FullForm для использования в качестве ключа.
+ * \param[in] fullForm Исходный текст.
+ * \return Текст, в котором пробельные символы рядом со скобками, запятыми
+ * и & и по краям удалены, а остальные серии заменены одним пробелом.
+ *
+ * \details
+ * Пробел между лексемами значим ("Plus[1 2, x]" и "Plus[12, x]" —
+ * разные выражения), поэтому он сохраняется. Текст в кавычках не
+ * изменяется.
+ */
+std::string CompiledExpressionCache::normalizeKey(const std::string& fullForm) {
+  auto isDelimiter = [](char c) {
+    return c == '[' || c == ']' || c == ',' || c == '&';
+  };
+  std::string key;
+  key.reserve(fullForm.size());
+  bool inString = false;
+  bool pendingSpace = false;
+  for (size_t i = 0; i < fullForm.size(); ++i) {
+    const char c = fullForm[i];
+    if (inString) {
+      key += c;
+      if (c == '\\' && i + 1 < fullForm.size()) {
+        key += fullForm[++i];
+      } else if (c == '"') {
+        inString = false;
+      }
+      continue;
+    }
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pendingSpace = true;
+      continue;
+    }
+    if (pendingSpace && !key.empty() && !isDelimiter(key.back()) &&
+        !isDelimiter(c)) {
+      key += ' ';
+    }
+    pendingSpace = false;
+    key += c;
+    if (c == '"') inString = true;
+  }
+  return key;
+}
+
+CompiledExpressionCache::Shard& CompiledExpressionCache::shardFor(
+    const std::string& key) {
+  return shards_[std::hash<std::string>()(key) % kShards];
+}
+
+size_t CompiledExpressionCache::shardCapacity() const {
+  return (capacity_.load() + kShards - 1) / kShards;
+}
+
+void CompiledExpressionCache::evictExcess(Shard& shard) {
+  const size_t limit = shardCapacity();
+  while (shard.lru.size() > limit) {
+    shard.index.erase(shard.lru.back().first);
+    shard.lru.pop_back();
+    ++evictions_;
+  }
+}
+
+/*!
+ * \brief Возвращает программу из кэша или компилирует и сохраняет ее.
+ * \param[in] key Нормализованный ключ (см. normalizeKey).
+ * \param[in] compile Функция компиляции, вызывается только при промахе.
+ * \return Скомпилированная программа.
+ *
+ * \details
+ * Если два потока одновременно промахнулись по одному ключу, оба
+ * скомпилируют выражение, но в кэше останется и будет возвращен первый
+ * результат. Исключения compile передаются вызывающему.
+ */
+CompiledExpressionCache::ProgramPtr CompiledExpressionCache::getOrCompile(
+    const std::string& key, const std::function<BytecodeProgram()>& compile) {
+  Shard& shard = shardFor(key);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      ++hits_;
+      return it->second->second;
+    }
+  }
+
+  ++misses_;
+  ProgramPtr program = std::make_shared<const BytecodeProgram>(compile());
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->second;
+  }
+  if (shardCapacity() == 0) return program;
+
+  shard.lru.emplace_front(key, program);
+  shard.index.emplace(key, shard.lru.begin());
+  evictExcess(shard);
+  return program;
+}
+
+/*!
+ * \brief Задает максимальное число программ в кэше (0 отключает кэш).
+ */
+void CompiledExpressionCache::setCapacity(size_t capacity) {
+  capacity_ = capacity;
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    evictExcess(shard);
+  }
+}
+
+void CompiledExpressionCache::clear() {
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.index.clear();
+    shard.lru.clear();
+  }
+}
+
+size_t CompiledExpressionCache::size() const {
+  size_t total = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.lru.size();
+  }
+  return total;
+}
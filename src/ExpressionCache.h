@@ -0,0 +1,72 @@
+#ifndef EXPRESSIONCACHE_H
+#define EXPRESSIONCACHE_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ExpressionVM.h"
+
+/*!
+ * \class CompiledExpressionCache
+ * \brief Процессный LRU-кэш скомпилированных выражений по тексту FullForm.
+ *
+ * Ключ — нормализованный текст (без пробельных символов), поэтому
+ * повторно присланная функция не разбирается и не компилируется заново.
+ * Кэш разбит на сегменты с отдельными мьютексами, так что параллельные
+ * обращения к разным ключам не мешают друг другу. Компиляция выполняется
+ * вне блокировки.
+ *
+ * Вытеснение идет внутри сегмента, поэтому граница размера соблюдается с
+ * точностью до округления вверх на число сегментов.
+ */
+class CompiledExpressionCache {
+ public:
+  typedef std::shared_ptr<const BytecodeProgram> ProgramPtr;
+
+  explicit CompiledExpressionCache(size_t capacity = kDefaultCapacity);
+
+  static CompiledExpressionCache& instance();
+  static std::string normalizeKey(const std::string& fullForm);
+
+  ProgramPtr getOrCompile(const std::string& key,
+                          const std::function<BytecodeProgram()>& compile);
+
+  void setCapacity(size_t capacity);
+  void clear();
+
+  size_t capacity() const { return capacity_.load(); }
+  size_t size() const;
+  std::uint64_t hits() const { return hits_.load(); }
+  std::uint64_t misses() const { return misses_.load(); }
+  std::uint64_t evictions() const { return evictions_.load(); }
+
+  static constexpr size_t kDefaultCapacity = 256;
+  static constexpr size_t kShards = 16;
+
+ private:
+  struct Shard {
+    typedef std::list<std::pair<std::string, ProgramPtr>> LruList;
+
+    mutable std::mutex mutex;
+    LruList lru;  // в начале — недавно использованные
+    std::unordered_map<std::string, LruList::iterator> index;
+  };
+
+  Shard& shardFor(const std::string& key);
+  size_t shardCapacity() const;
+  void evictExcess(Shard& shard);
+
+  std::vector<Shard> shards_;
+  std::atomic<size_t> capacity_;
+  std::atomic<std::uint64_t> hits_{0};
+  std::atomic<std::uint64_t> misses_{0};
+  std::atomic<std::uint64_t> evictions_{0};
+};
+#endif
@@ -0,0 +1,377 @@
+#include "ExpressionCodegen.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "Trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* kKernelSymbol = "bicubic_expression_kernel";
+
+#ifdef _WIN32
+const char* kDefaultCompiler = "cl";
+const char* kLibraryExtension = ".dll";
+#else
+const char* kDefaultCompiler = "c++";
+const char* kLibraryExtension = ".so";
+#endif
+
+std::uint64_t fnv1a(const std::string& text) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string environmentOr(const char* name, const std::string& fallback) {
+  const char* value = std::getenv(name);
+  return (value && *value) ? std::string(value) : fallback;
+}
+
+// Точная запись константы в исходном тексте
+std::string literal(double value) {
+  if (std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+  if (std::isinf(value)) {
+    return value > 0 ? "std::numeric_limits<double>::infinity()"
+                     : "-std::numeric_limits<double>::infinity()";
+  }
+  std::ostringstream ss;
+  ss << std::hexfloat << value;
+  return ss.str();
+}
+
+std::string operation(const Instruction& in) {
+  const std::string a = "r" + std::to_string(in.a);
+  const std::string b = "r" + std::to_string(in.b);
+  switch (in.op) {
+    case OpCode::Add:
+      return a + " + " + b;
+    case OpCode::Mul:
+      return a + " * " + b;
+    case OpCode::Div:
+      return a + " / " + b;
+    case OpCode::Pow:
+      return "guardedPow(" + a + ", " + b + ")";
+    case OpCode::Sin:
+      return "std::sin(" + a + ")";
+    case OpCode::Cos:
+      return "std::cos(" + a + ")";
+    case OpCode::Tan:
+      return "std::tan(" + a + ")";
+    case OpCode::Exp:
+      return "std::exp(" + a + ")";
+    case OpCode::Log:
+      return "std::log(" + a + ")";
+    case OpCode::LogBase:
+      return "std::log(" + b + ") / std::log(" + a + ")";
+    case OpCode::Sqrt:
+      return "std::sqrt(" + a + ")";
+  }
+  return "0.0";
+}
+
+/*!
+ * \brief Каталог кэша по умолчанию: свой у каждого пользователя.
+ *
+ * $XDG_CACHE_HOME/bicubic_codegen, иначе ~/.cache/bicubic_codegen, иначе
+ * bicubic_codegen-<uid> во временном каталоге. Общий для всех каталог
+ * позволил бы другому пользователю заранее подложить библиотеку.
+ */
+std::filesystem::path defaultCacheDir() {
+  std::error_code error;
+#ifdef _WIN32
+  return std::filesystem::temp_directory_path(error) / "bicubic_codegen";
+#else
+  const std::string xdg = environmentOr("XDG_CACHE_HOME", "");
+  if (!xdg.empty()) return std::filesystem::path(xdg) / "bicubic_codegen";
+  const std::string home = environmentOr("HOME", "");
+  if (!home.empty()) {
+    return std::filesystem::path(home) / ".cache" / "bicubic_codegen";
+  }
+  return std::filesystem::temp_directory_path(error) /
+         ("bicubic_codegen-" + std::to_string(geteuid()));
+#endif
+}
+
+/*!
+ * \brief Проверяет, что каталог кэша или библиотеку в нем не мог
+ * подменить другой пользователь.
+ * \return true, если путь — не символическая ссылка, принадлежит текущему
+ * пользователю и недоступен на запись группе и остальным.
+ */
+bool isPrivate(const std::filesystem::path& path, bool directory) {
+#ifdef _WIN32
+  (void)directory;
+  std::error_code error;
+  return std::filesystem::exists(path, error);
+#else
+  struct stat info;
+  if (lstat(path.c_str(), &info) != 0) return false;
+  const bool kind = directory ? S_ISDIR(info.st_mode) : S_ISREG(info.st_mode);
+  return kind && info.st_uid == geteuid() &&
+         (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#endif
+}
+
+// Создает каталог кэша с правами 0700 (родительские — с обычными правами)
+bool preparePrivateDir(const std::filesystem::path& dir) {
+  std::error_code error;
+  if (!std::filesystem::exists(dir, error)) {
+    std::filesystem::create_directories(dir.parent_path(), error);
+#ifdef _WIN32
+    std::filesystem::create_directory(dir, error);
+#else
+    mkdir(dir.c_str(), 0700);
+#endif
+  }
+  return isPrivate(dir, true);
+}
+
+// Имя, уникальное для процесса и вызова: параллельные сборки одного
+// выражения не переписывают файлы друг друга
+std::string uniqueSuffix() {
+  static std::atomic<std::uint64_t> counter{0};
+#ifdef _WIN32
+  const unsigned long pid = GetCurrentProcessId();
+#else
+  const long pid = static_cast<long>(getpid());
+#endif
+  return std::to_string(pid) + "-" + std::to_string(counter.fetch_add(1));
+}
+
+std::string quoted(const std::filesystem::path& path) {
+  return "\"" + path.string() + "\"";
+}
+
+std::string buildCommand(const std::string& compiler,
+                         const std::filesystem::path& source,
+                         const std::filesystem::path& library,
+                         const std::filesystem::path& log) {
+  std::string command;
+  if (compiler == "cl" || compiler == "cl.exe") {
+    command = compiler + " /nologo /O2 /LD /EHsc " + quoted(source) +
+              " /Fe" + quoted(library) + " /Fo" +
+              quoted(library.parent_path() / "") + " > " + quoted(log) +
+              " 2>&1";
+  } else {
+    command = compiler + " -O2 -shared -fPIC -o " + quoted(library) + " " +
+              quoted(source) + " > " + quoted(log) + " 2>&1";
+  }
+#ifdef _WIN32
+  // cmd.exe снимает внешние кавычки со всей строки
+  command = "\"" + command + "\"";
+#endif
+  return command;
+}
+
+NativeExpression::BatchKernel loadKernel(const std::filesystem::path& library) {
+  // Библиотеки не выгружаются: ядра могут использоваться до конца процесса
+  static std::mutex mutex;
+  static std::unordered_map<std::string, NativeExpression::BatchKernel> loaded;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = loaded.find(library.string());
+  if (it != loaded.end()) return it->second;
+
+  NativeExpression::BatchKernel kernel = nullptr;
+#ifdef _WIN32
+  HMODULE module = LoadLibraryA(library.string().c_str());
+  if (module) {
+    kernel = reinterpret_cast<NativeExpression::BatchKernel>(
+        GetProcAddress(module, kKernelSymbol));
+  }
+#else
+  void* module = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (module) {
+    kernel = reinterpret_cast<NativeExpression::BatchKernel>(
+        dlsym(module, kKernelSymbol));
+  }
+#endif
+  if (kernel) loaded.emplace(library.string(), kernel);
+  return kernel;
+}
+
+}  // namespace
+
+/*!
+ * \brief Генерирует исходный текст C++ для программы.
+ * \param[in] program Скомпилированное выражение.
+ * \return Текст единицы трансляции с функцией bicubic_expression_kernel.
+ *
+ * \details
+ * Каждый регистр становится локальной константой внутри цикла по точкам,
+ * константы выносятся на уровень файла. Семантика Power совпадает с
+ * guardedPow интерпретатора.
+ */
+std::string NativeExpression::generateSource(const BytecodeProgram& program) {
+  const size_t numVars = program.variables().size();
+  const std::vector<double>& constants = program.constants();
+
+  std::ostringstream src;
+  src << "// Generated from BytecodeProgram, do not edit\n"
+      << "#include <cmath>\n#include <cstddef>\n#include <cstdio>\n"
+      << "#include <limits>\n\n"
+      << "static inline double guardedPow(double b, double e) {\n"
+      << "  if (b == 0.0 && e < 0.0)\n"
+      << "    return std::numeric_limits<double>::infinity();\n"
+      << "  if (b < 0.0 && std::trunc(e) != e) {\n"
+      << "    std::fputs(\"Warning: Negative base with non-integer "
+         "exponent\\n\", stderr);\n"
+      << "    return std::numeric_limits<double>::quiet_NaN();\n"
+      << "  }\n"
+      << "  return std::pow(b, e);\n"
+      << "}\n\n";
+  for (size_t c = 0; c < constants.size(); ++c) {
+    src << "static const double r" << numVars + c << " = "
+        << literal(constants[c]) << ";\n";
+  }
+  src << "\nextern \"C\"\n"
+      << "#ifdef _WIN32\n__declspec(dllexport)\n#endif\n"
+      << "void " << kKernelSymbol
+      << "(const double* const* vars, double* const* outs, std::size_t n) {\n"
+      << "  for (std::size_t i = 0; i < n; ++i) {\n";
+  for (size_t v = 0; v < numVars; ++v) {
+    src << "    const double r" << v << " = vars[" << v << "][i];\n";
+  }
+  for (const Instruction& in : program.code()) {
+    src << "    const double r" << in.dst << " = " << operation(in) << ";\n";
+  }
+  for (size_t k = 0; k < program.results().size(); ++k) {
+    src << "    outs[" << k << "][i] = r" << program.results()[k] << ";\n";
+  }
+  src << "  }\n}\n";
+  return src.str();
+}
+
+/*!
+ * \brief Компилирует программу в машинный код или возвращает обертку над
+ * интерпретатором.
+ * \param[in] program Скомпилированное выражение.
+ * \param[in] options Компилятор и каталог кэша.
+ * \return Вычислитель; isNative() показывает, удалось ли собрать код.
+ */
+std::shared_ptr<const NativeExpression> NativeExpression::compile(
+    std::shared_ptr<const BytecodeProgram> program,
+    const CodegenOptions& options) {
+  TraceSpan span("expression.native_compile");
+  std::shared_ptr<NativeExpression> result(new NativeExpression(program));
+
+  const std::string compiler = !options.compiler.empty()
+                                   ? options.compiler
+                                   : environmentOr("BICUBIC_CODEGEN_CXX",
+                                                   kDefaultCompiler);
+  std::error_code error;
+  const std::filesystem::path cacheDir =
+      !options.cacheDir.empty()
+          ? std::filesystem::path(options.cacheDir)
+          : std::filesystem::path(environmentOr(
+                "BICUBIC_CODEGEN_CACHE", defaultCacheDir().string()));
+  if (!preparePrivateDir(cacheDir)) {
+    if (options.verbose) {
+      std::cerr << "Warning: " << cacheDir.string()
+                << " is not a private directory, using bytecode interpreter"
+                << std::endl;
+    }
+    return result;
+  }
+
+  const std::string source = generateSource(*program);
+  std::ostringstream name;
+  name << "expr_" << std::hex << fnv1a(compiler + "\n" + source);
+  const std::filesystem::path library =
+      cacheDir / (name.str() + kLibraryExtension);
+
+  if (!std::filesystem::exists(library, error)) {
+    // Сборка во временный файл и переименование, чтобы параллельные процессы
+    // не загрузили недописанную библиотеку
+    const std::string unique = name.str() + "." + uniqueSuffix();
+    const std::filesystem::path sourcePath = cacheDir / (unique + ".cpp");
+    const std::filesystem::path partial =
+        cacheDir / (unique + kLibraryExtension);
+    const std::filesystem::path log = cacheDir / (unique + ".log");
+    {
+      std::ofstream out(sourcePath);
+      out << source;
+    }
+
+    const std::string command =
+        buildCommand(compiler, sourcePath, partial, log);
+    if (std::system(command.c_str()) != 0 ||
+        !std::filesystem::exists(partial, error)) {
+      if (options.verbose) {
+        std::cerr << "Warning: native compilation failed (" << command
+                  << "), using bytecode interpreter" << std::endl;
+      }
+      std::filesystem::remove(partial, error);
+      return result;
+    }
+#ifndef _WIN32
+    // Права библиотеки не должны зависеть от umask
+    chmod(partial.c_str(), 0700);
+#endif
+    std::filesystem::rename(partial, library, error);
+    if (error) std::filesystem::remove(partial, error);
+    std::filesystem::remove(sourcePath, error);
+    std::filesystem::remove(log, error);
+  }
+
+  if (!isPrivate(library, false)) {
+    if (options.verbose) {
+      std::cerr << "Warning: " << library.string()
+                << " is not owned by the current user, using bytecode "
+                   "interpreter"
+                << std::endl;
+    }
+    return result;
+  }
+  result->kernel_ = loadKernel(library);
+  if (result->kernel_) {
+    result->libraryPath_ = library.string();
+  } else if (options.verbose) {
+    std::cerr << "Warning: failed to load " << library.string()
+              << ", using bytecode interpreter" << std::endl;
+  }
+  return result;
+}
+
+double NativeExpression::evaluate(const double* vars) const {
+  if (!kernel_) return program_->evaluate(vars);
+
+  std::vector<const double*> varPtrs(program_->variables().size());
+  for (size_t v = 0; v < varPtrs.size(); ++v) varPtrs[v] = vars + v;
+  std::vector<double> out(program_->outputCount());
+  std::vector<double*> outPtrs(out.size());
+  for (size_t k = 0; k < out.size(); ++k) outPtrs[k] = &out[k];
+
+  kernel_(varPtrs.data(), outPtrs.data(), 1);
+  return out[0];
+}
+
+void NativeExpression::evaluateBatch(const double* const* vars,
+                                     double* const* outs, size_t n) const {
+  if (!kernel_) {
+    program_->evaluateBatch(vars, outs, n);
+    return;
+  }
+  kernel_(vars, outs, n);
+}
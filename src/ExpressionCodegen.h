@@ -0,0 +1,63 @@
+#ifndef EXPRESSIONCODEGEN_H
+#define EXPRESSIONCODEGEN_H
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "ExpressionVM.h"
+
+/*!
+ * \brief Настройки сборки машинного кода.
+ *
+ * Пустые поля берутся из окружения: компилятор — из BICUBIC_CODEGEN_CXX
+ * (по умолчанию c++, в Windows cl), каталог кэша — из
+ * BICUBIC_CODEGEN_CACHE (по умолчанию $XDG_CACHE_HOME/bicubic_codegen или
+ * ~/.cache/bicubic_codegen). Каталог кэша и библиотеки в нем используются,
+ * только если они принадлежат текущему пользователю и недоступны на запись
+ * другим; каталог по умолчанию создается с правами 0700.
+ */
+struct CodegenOptions {
+  std::string compiler;
+  std::string cacheDir;
+  bool verbose = false;
+};
+
+/*!
+ * \class NativeExpression
+ * \brief Выражение, скомпилированное системным компилятором в разделяемую
+ * библиотеку.
+ *
+ * Из байткода генерируется исходный текст на C++ с одним циклом по точкам,
+ * который собирается в .so/.dll и загружается через dlopen/LoadLibrary.
+ * Библиотеки кэшируются на диске по хешу исходного текста и команды
+ * сборки, поэтому компиляция выполняется один раз. Если компилятор
+ * недоступен или сборка не удалась, вычисление автоматически идет через
+ * интерпретатор байткода.
+ */
+class NativeExpression {
+ public:
+  typedef void (*BatchKernel)(const double* const* vars, double* const* outs,
+                              size_t n);
+
+  static std::shared_ptr<const NativeExpression> compile(
+      std::shared_ptr<const BytecodeProgram> program,
+      const CodegenOptions& options = CodegenOptions());
+
+  static std::string generateSource(const BytecodeProgram& program);
+
+  bool isNative() const { return kernel_ != nullptr; }
+  const std::string& libraryPath() const { return libraryPath_; }
+
+  double evaluate(const double* vars) const;
+  void evaluateBatch(const double* const* vars, double* const* outs,
+                     size_t n) const;
+
+ private:
+  explicit NativeExpression(std::shared_ptr<const BytecodeProgram> program)
+      : program_(std::move(program)) {}
+
+  std::shared_ptr<const BytecodeProgram> program_;
+  BatchKernel kernel_ = nullptr;
+  std::string libraryPath_;
+};
+#endif
@@ -0,0 +1,332 @@
+#include "ExpressionOptimizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+
+#include "Trace.h"
+
+namespace {
+
+std::uint64_t bitsOf(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+}  // namespace
+
+size_t ExpressionDag::NodeHash::operator()(const Node& node) const {
+  size_t h = static_cast<size_t>(node.kind) * 31 + static_cast<size_t>(node.op);
+  h = h * 1000003u ^ node.a;
+  h = h * 1000003u ^ node.b;
+  h = h * 1000003u ^ std::hash<std::uint64_t>()(bitsOf(node.value));
+  return h;
+}
+
+bool ExpressionDag::NodeEqual::operator()(const Node& lhs,
+                                          const Node& rhs) const {
+  return lhs.kind == rhs.kind && lhs.op == rhs.op && lhs.a == rhs.a &&
+         lhs.b == rhs.b && bitsOf(lhs.value) == bitsOf(rhs.value);
+}
+
+/*!
+ * \brief Конструктор.
+ * \param[in] slots Имена слотов переменных итоговой программы.
+ *
+ * \details
+ * По умолчанию имя i-го слота ссылается на него же; bindVariables позволяет
+ * перед выгрузкой очередного выражения сопоставить слотам другие имена
+ * (например, '#' у одной функции кривой и 'x' у другой).
+ */
+ExpressionDag::ExpressionDag(std::vector<std::string> slots)
+    : slots_(std::move(slots)) {
+  bindVariables(slots_);
+}
+
+void ExpressionDag::bindVariables(const std::vector<std::string>& names) {
+  names_.clear();
+  for (std::uint32_t i = 0; i < names.size() && i < slots_.size(); ++i) {
+    names_[names[i]] = i;
+  }
+}
+
+std::uint32_t ExpressionDag::variable(const std::string& name) {
+  ++inputNodes_;
+  auto it = names_.find(name);
+  if (it == names_.end()) {
+    std::cerr << "Warning: Variable not found: " << name
+              << ", using 0.0 as default value" << std::endl;
+    return constantNode(0.0);
+  }
+  return intern({Kind::Variable, OpCode::Add, 0, 0,
+                 static_cast<double>(it->second)});
+}
+
+std::uint32_t ExpressionDag::constant(double value) {
+  ++inputNodes_;
+  return constantNode(value);
+}
+
+std::uint32_t ExpressionDag::emit(OpCode op, std::uint32_t a,
+                                  std::uint32_t b) {
+  ++inputNodes_;
+  return build(op, a, b);
+}
+
+std::uint32_t ExpressionDag::constantNode(double value) {
+  return intern({Kind::Constant, OpCode::Add, 0, 0, value});
+}
+
+std::uint32_t ExpressionDag::intern(const Node& node) {
+  auto it = index_.find(node);
+  if (it != index_.end()) return it->second;
+
+  std::uint32_t id = static_cast<std::uint32_t>(nodes_.size());
+  nodes_.push_back(node);
+  index_.emplace(node, id);
+  return id;
+}
+
+/*!
+ * \brief Добавляет операцию с упрощениями.
+ * \return Идентификатор узла, вычисляющего op(a, b).
+ */
+std::uint32_t ExpressionDag::build(OpCode op, std::uint32_t a,
+                                   std::uint32_t b) {
+  if (isUnary(op)) b = 0;
+
+  // Свертка констант
+  if (isConstant(a) && (isUnary(op) || isConstant(b))) {
+    return constantNode(
+        applyOpCode(op, nodes_[a].value, isUnary(op) ? 0.0 : nodes_[b].value));
+  }
+
+  if (op == OpCode::Add || op == OpCode::Mul) {
+    // Каноничный порядок операндов: константа слева, иначе по номеру узла
+    if (isConstant(b) || (!isConstant(a) && b < a)) std::swap(a, b);
+
+    if (op == OpCode::Mul && isConstant(a, 1.0)) return b;
+    // x + (-0) == x для любого x, а x + 0 дает +0 при x = -0
+    if (op == OpCode::Add && isConstant(a, 0.0) &&
+        (fastMath_ || std::signbit(nodes_[a].value))) {
+      return b;
+    }
+    if (fastMath_ && op == OpCode::Mul && isConstant(a, 0.0)) return a;
+
+    // c1 op (c2 op x) -> (c1 op c2) op x
+    const Node right = nodes_[b];
+    if (fastMath_ && isConstant(a) && right.kind == Kind::Operation &&
+        right.op == op && isConstant(right.a)) {
+      double folded = applyOpCode(op, nodes_[a].value, nodes_[right.a].value);
+      return build(op, constantNode(folded), right.b);
+    }
+  }
+
+  if (op == OpCode::Pow && isConstant(b)) {
+    const double e = nodes_[b].value;
+    // x^0, x^1 и x^2 = x * x совпадают с pow точно
+    const bool exact = e == 0.0 || e == 1.0 || e == 2.0;
+    if (exact || (fastMath_ && std::trunc(e) == e &&
+                  std::abs(e) <= kMaxExpandedPower)) {
+      return expandPower(a, static_cast<int>(e));
+    }
+    if (fastMath_ && e == 0.5) return build(OpCode::Sqrt, a, 0);
+  }
+
+  if (op == OpCode::Div && isConstant(b, 1.0)) return a;
+
+  return intern({Kind::Operation, op, a, b, 0.0});
+}
+
+/*!
+ * \brief Заменяет base^exponent умножениями (возведение квадрированием).
+ */
+std::uint32_t ExpressionDag::expandPower(std::uint32_t base, int exponent) {
+  if (exponent == 0) return constantNode(1.0);
+
+  unsigned n = static_cast<unsigned>(std::abs(exponent));
+  std::uint32_t power = base;
+  std::uint32_t result = power;
+  bool hasResult = false;
+  while (n != 0) {
+    if (n & 1u) {
+      result = hasResult ? build(OpCode::Mul, result, power) : power;
+      hasResult = true;
+    }
+    n >>= 1;
+    if (n != 0) power = build(OpCode::Mul, power, power);
+  }
+
+  if (exponent < 0) result = build(OpCode::Div, constantNode(1.0), result);
+  return result;
+}
+
+/*!
+ * \brief Строит производную узла по переменной.
+ * \param[in] node Узел DAG.
+ * \param[in] slot Номер слота переменной дифференцирования.
+ * \return Узел, вычисляющий d(node)/d(slot).
+ */
+std::uint32_t ExpressionDag::derivative(std::uint32_t node,
+                                        std::uint32_t slot) {
+  std::unordered_map<std::uint32_t, std::uint32_t> memo;
+  return derivative(node, slot, memo);
+}
+
+std::uint32_t ExpressionDag::derivative(
+    std::uint32_t node, std::uint32_t slot,
+    std::unordered_map<std::uint32_t, std::uint32_t>& memo) {
+  auto it = memo.find(node);
+  if (it != memo.end()) return it->second;
+
+  // Копия: build() может перераспределить nodes_
+  const Node n = nodes_[node];
+  std::uint32_t result;
+  if (n.kind == Kind::Constant) {
+    result = constantNode(0.0);
+  } else if (n.kind == Kind::Variable) {
+    result = constantNode(static_cast<std::uint32_t>(n.value) == slot ? 1.0
+                                                                      : 0.0);
+  } else {
+    const std::uint32_t a = n.a;
+    const std::uint32_t b = n.b;
+    const std::uint32_t da = derivative(a, slot, memo);
+    const std::uint32_t db = isUnary(n.op) ? 0 : derivative(b, slot, memo);
+    const std::uint32_t minusOne = constantNode(-1.0);
+    // Нулевой операнд здесь — точный ноль производной, а не значение
+    auto mul = [&](std::uint32_t x, std::uint32_t y) {
+      if (isConstant(x, 0.0) || isConstant(y, 0.0)) return constantNode(0.0);
+      return build(OpCode::Mul, x, y);
+    };
+    auto add = [&](std::uint32_t x, std::uint32_t y) {
+      if (isConstant(x, 0.0)) return y;
+      if (isConstant(y, 0.0)) return x;
+      return build(OpCode::Add, x, y);
+    };
+    auto div = [&](std::uint32_t x, std::uint32_t y) {
+      if (isConstant(x, 0.0)) return constantNode(0.0);
+      return build(OpCode::Div, x, y);
+    };
+    auto sub = [&](std::uint32_t x, std::uint32_t y) {
+      return add(x, mul(minusOne, y));
+    };
+
+    switch (n.op) {
+      case OpCode::Add:
+        result = add(da, db);
+        break;
+      case OpCode::Mul:
+        result = add(mul(da, b), mul(a, db));
+        break;
+      case OpCode::Div:
+        // (a' b - a b') / b^2
+        result = div(sub(mul(da, b), mul(a, db)), mul(b, b));
+        break;
+      case OpCode::Pow:
+        if (isConstant(b)) {
+          // c a^(c-1) a'
+          const double c = nodes_[b].value;
+          result = mul(constantNode(c),
+                       mul(build(OpCode::Pow, a, constantNode(c - 1.0)), da));
+        } else {
+          // a^b (b' log a + b a' / a)
+          result = mul(node, add(mul(db, build(OpCode::Log, a, 0)),
+                                 div(mul(b, da), a)));
+        }
+        break;
+      case OpCode::Sin:
+        result = mul(build(OpCode::Cos, a, 0), da);
+        break;
+      case OpCode::Cos:
+        result = mul(minusOne, mul(build(OpCode::Sin, a, 0), da));
+        break;
+      case OpCode::Tan: {
+        const std::uint32_t cosA = build(OpCode::Cos, a, 0);
+        result = div(da, mul(cosA, cosA));
+        break;
+      }
+      case OpCode::Exp:
+        result = mul(node, da);
+        break;
+      case OpCode::Log:
+        result = div(da, a);
+        break;
+      case OpCode::LogBase: {
+        // log(b) / log(a): (b'/b log a - log b a'/a) / log(a)^2
+        const std::uint32_t logA = build(OpCode::Log, a, 0);
+        const std::uint32_t logB = build(OpCode::Log, b, 0);
+        result = div(sub(mul(div(db, b), logA), mul(logB, div(da, a))),
+                     mul(logA, logA));
+        break;
+      }
+      case OpCode::Sqrt:
+        result = div(da, mul(constantNode(2.0), node));
+        break;
+      default:
+        result = constantNode(0.0);
+        break;
+    }
+  }
+
+  memo.emplace(node, result);
+  return result;
+}
+
+/*!
+ * \brief Компилирует достижимую из roots часть DAG в байткод.
+ * \param[in] roots Узлы-выходы программы.
+ * \param[out] report Если не nullptr, заполняется числом узлов до и после.
+ * \return Программа с roots.size() выходами.
+ */
+BytecodeProgram ExpressionDag::compile(const std::vector<std::uint32_t>& roots,
+                                       OptimizationReport* report) const {
+  TraceSpan span("expression.compile");
+  std::vector<bool> live(nodes_.size(), false);
+  std::vector<std::uint32_t> stack(roots.begin(), roots.end());
+  while (!stack.empty()) {
+    std::uint32_t id = stack.back();
+    stack.pop_back();
+    if (live[id]) continue;
+    live[id] = true;
+
+    const Node& node = nodes_[id];
+    if (node.kind != Kind::Operation) continue;
+    stack.push_back(node.a);
+    if (!isUnary(node.op)) stack.push_back(node.b);
+  }
+
+  // Номера узлов уже упорядочены топологически: операнды создаются раньше
+  BytecodeCompiler compiler(slots_);
+  std::vector<std::uint32_t> reg(nodes_.size(), 0);
+  size_t liveCount = 0;
+  for (std::uint32_t id = 0; id < nodes_.size(); ++id) {
+    if (!live[id]) continue;
+    ++liveCount;
+
+    const Node& node = nodes_[id];
+    switch (node.kind) {
+      case Kind::Constant:
+        reg[id] = compiler.constant(node.value);
+        break;
+      case Kind::Variable:
+        reg[id] = compiler.variable(slots_[static_cast<size_t>(node.value)]);
+        break;
+      case Kind::Operation:
+        reg[id] = compiler.emit(node.op, reg[node.a],
+                                isUnary(node.op) ? 0 : reg[node.b]);
+        break;
+    }
+  }
+
+  if (report) {
+    report->nodesBefore = inputNodes_;
+    report->nodesAfter = liveCount;
+  }
+
+  std::vector<std::uint32_t> results;
+  for (std::uint32_t root : roots) results.push_back(reg[root]);
+  return compiler.finish(results);
+}
@@ -0,0 +1,117 @@
+#ifndef EXPRESSIONOPTIMIZER_H
+#define EXPRESSIONOPTIMIZER_H
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ExpressionVM.h"
+
+/*!
+ * \brief Размер выражения до и после оптимизации.
+ */
+struct OptimizationReport {
+  size_t nodesBefore = 0;  //!< Узлов в исходных деревьях
+  size_t nodesAfter = 0;   //!< Узлов DAG, достижимых из выходов
+};
+
+/*!
+ * \class ExpressionDag
+ * \brief Оптимизирующее представление выражений в виде DAG.
+ *
+ * Узлы хешируются (hash-consing), поэтому одинаковые подвыражения, в том
+ * числе из разных выражений (x(t) и y(t) кривой), хранятся один раз. При
+ * добавлении узла выполняются:
+ * - свертка констант;
+ * - x * 1, x / 1, x + (-0) -> x;
+ * - x^0 -> 1, x^1 -> x, x^2 -> x * x.
+ *
+ * Эти упрощения дают тот же результат в арифметике IEEE, что и исходное
+ * выражение. Остальные выполняются только после setFastMath(true):
+ * - x + 0 -> x (меняет знак -0);
+ * - x * 0 -> 0 (Times[0, Log[0]] дает NaN, а не 0);
+ * - объединение констант в цепочках c1 + (c2 + x) и c1 (c2 x)
+ *   (переставляет округления: Plus[1.*^16, Plus[-1.*^16, x]] при x = 1
+ *   дает 0, а после объединения 1);
+ * - раскрытие x^n при 2 < |n| <= kMaxExpandedPower и отрицательных n в
+ *   умножения (округляется иначе, чем pow);
+ * - Power[x, 1/2] -> Sqrt[x] (расходится при x = -Inf).
+ *
+ * Rational приходит из AST уже поделенным (см. Rational::emit).
+ *
+ * derivative() строит символьную производную узла по переменной прямо в
+ * DAG, поэтому производная проходит те же упрощения и делит общие
+ * подвыражения со значением (например, Sin[t] и Cos[t]). Нули, которые
+ * дают правила дифференцирования (производная константы или другой
+ * переменной), отбрасываются вместе со слагаемыми всегда: это точный ноль
+ * производной, а не произведение чисел.
+ */
+class ExpressionDag : public ExpressionBuilder {
+ public:
+  explicit ExpressionDag(std::vector<std::string> slots);
+
+  void bindVariables(const std::vector<std::string>& names);
+
+  //! Разрешает упрощения, меняющие результат IEEE (по умолчанию выключены)
+  void setFastMath(bool enabled) { fastMath_ = enabled; }
+
+  std::uint32_t variable(const std::string& name) override;
+  std::uint32_t constant(double value) override;
+  std::uint32_t emit(OpCode op, std::uint32_t a,
+                     std::uint32_t b = 0) override;
+
+  std::uint32_t derivative(std::uint32_t node, std::uint32_t slot);
+
+  BytecodeProgram compile(const std::vector<std::uint32_t>& roots,
+                          OptimizationReport* report = nullptr) const;
+
+  size_t nodeCount() const { return nodes_.size(); }
+  bool constantValue(std::uint32_t id, double& value) const {
+    if (!isConstant(id)) return false;
+    value = nodes_[id].value;
+    return true;
+  }
+
+  //! Максимальный модуль показателя, раскрываемого в умножения (fastMath)
+  static constexpr int kMaxExpandedPower = 4;
+
+ private:
+  enum class Kind : std::uint8_t { Constant, Variable, Operation };
+
+  struct Node {
+    Kind kind;
+    OpCode op;
+    std::uint32_t a;
+    std::uint32_t b;
+    double value;  // значение константы или номер слота переменной
+  };
+
+  struct NodeHash {
+    size_t operator()(const Node& node) const;
+  };
+  struct NodeEqual {
+    bool operator()(const Node& lhs, const Node& rhs) const;
+  };
+
+  std::uint32_t build(OpCode op, std::uint32_t a, std::uint32_t b);
+  std::uint32_t constantNode(double value);
+  std::uint32_t intern(const Node& node);
+  std::uint32_t expandPower(std::uint32_t base, int exponent);
+  std::uint32_t derivative(std::uint32_t node, std::uint32_t slot,
+                           std::unordered_map<std::uint32_t, std::uint32_t>&
+                               memo);
+  bool isConstant(std::uint32_t id) const {
+    return nodes_[id].kind == Kind::Constant;
+  }
+  bool isConstant(std::uint32_t id, double value) const {
+    return isConstant(id) && nodes_[id].value == value;
+  }
+
+  std::vector<std::string> slots_;
+  std::unordered_map<std::string, std::uint32_t> names_;
+  std::vector<Node> nodes_;
+  std::unordered_map<Node, std::uint32_t, NodeHash, NodeEqual> index_;
+  size_t inputNodes_ = 0;
+  bool fastMath_ = false;
+};
+#endif
@@ -0,0 +1,282 @@
+#include "ExpressionReader.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "ArenaParser.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kE = 2.71828182845904523536;
+
+void appendTokens(const ArenaNode* node, FakeExpressionSource& source) {
+  switch (node->kind) {
+    case ArenaNode::Kind::Constant:
+      if (std::trunc(node->value) == node->value &&
+          std::abs(node->value) < 1e15) {
+        source.integer(static_cast<long long>(node->value));
+      } else {
+        source.real(node->value);
+      }
+      return;
+    case ArenaNode::Kind::Variable:
+      if (node->name == "#") {
+        source.function("Slot", 1).integer(1);
+      } else {
+        source.symbol(std::string(node->name));
+      }
+      return;
+    case ArenaNode::Kind::Function:
+      source.function(std::string(node->name),
+                      static_cast<int>(node->argCount));
+      for (std::uint32_t i = 0; i < node->argCount; ++i) {
+        appendTokens(node->args[i], source);
+      }
+      return;
+  }
+}
+
+}  // namespace
+
+/*!
+ * \brief Строит поток лексем по тексту FullForm.
+ * \param[in] fullForm Лямбда (Sin[#]&) или выражение от x.
+ * \return Поток Function[...], как его передал бы Mathematica.
+ *
+ * \details
+ * Лямбда передается как Function[body] со Slot[1], выражение от x — как
+ * Function[x, body]. Целые числа становятся лексемами Integer.
+ */
+FakeExpressionSource FakeExpressionSource::fromFullForm(
+    const std::string& fullForm) {
+  Arena arena;
+  ArenaParser parser(fullForm, arena);
+  const ArenaNode* root = parser.parse();
+
+  FakeExpressionSource source;
+  if (parser.isLambda()) {
+    source.function("Function", 1);
+  } else {
+    source.function("Function", 2).symbol("x");
+  }
+  appendTokens(root, source);
+  return source;
+}
+
+FakeExpressionSource& FakeExpressionSource::function(const std::string& head,
+                                                     int argCount) {
+  items_.push_back({Token::Function, head, argCount, 0.0});
+  return *this;
+}
+
+FakeExpressionSource& FakeExpressionSource::integer(long long value) {
+  items_.push_back({Token::Integer, "", 0, static_cast<double>(value)});
+  return *this;
+}
+
+FakeExpressionSource& FakeExpressionSource::real(double value) {
+  items_.push_back({Token::Real, "", 0, value});
+  return *this;
+}
+
+FakeExpressionSource& FakeExpressionSource::symbol(const std::string& name) {
+  items_.push_back({Token::Symbol, name, 0, 0.0});
+  return *this;
+}
+
+ExpressionSource::Token FakeExpressionSource::peek() {
+  return pos_ < items_.size() ? items_[pos_].token : Token::Error;
+}
+
+const FakeExpressionSource::Item* FakeExpressionSource::take(Token token) {
+  if (peek() != token) return nullptr;
+  return &items_[pos_++];
+}
+
+bool FakeExpressionSource::getFunction(std::string& head, int& argCount) {
+  const Item* item = take(Token::Function);
+  if (!item) return false;
+  head = item->text;
+  argCount = item->argCount;
+  return true;
+}
+
+bool FakeExpressionSource::getInteger(long long& value) {
+  const Item* item = take(Token::Integer);
+  if (!item) return false;
+  value = static_cast<long long>(item->value);
+  return true;
+}
+
+bool FakeExpressionSource::getReal(double& value) {
+  const Item* item = take(Token::Real);
+  if (!item) return false;
+  value = item->value;
+  return true;
+}
+
+bool FakeExpressionSource::getSymbol(std::string& name) {
+  const Item* item = take(Token::Symbol);
+  if (!item) return false;
+  name = item->text;
+  return true;
+}
+
+/*!
+ * \brief Читает Function[...] и возвращает узел тела.
+ * \param[in] dag DAG, в который выгружается тело.
+ * \return Узел тела функции; параметр функции — слот 0 DAG.
+ * \throws std::runtime_error Если на ссылке не функция или ссылка
+ * повреждена.
+ */
+std::uint32_t ExpressionReader::readFunction(ExpressionDag& dag) {
+  std::string head;
+  int argCount = 0;
+  if (!source_.getFunction(head, argCount) || head != "Function") {
+    throw std::runtime_error("Expected Function expression");
+  }
+  if (argCount < 1) {
+    throw std::runtime_error("Function requires a body");
+  }
+
+  parameter_ = "#";
+  if (argCount >= 2) {
+    // Function[x, body] или Function[{x}, body]
+    std::string listHead;
+    int listSize = 0;
+    bool ok = source_.getSymbol(parameter_) ||
+              (source_.getFunction(listHead, listSize) &&
+               listHead == "List" && listSize == 1 &&
+               source_.getSymbol(parameter_));
+    if (!ok) {
+      throw std::runtime_error("Expected a single Function parameter");
+    }
+  }
+
+  dag.bindVariables({parameter_});
+  std::uint32_t body = readExpression(dag);
+
+  // Атрибуты Function[x, body, attrs] не используются
+  for (int i = 2; i < argCount; ++i) skipExpression();
+  return body;
+}
+
+std::uint32_t ExpressionReader::readExpression(ExpressionDag& dag) {
+  switch (source_.peek()) {
+    case ExpressionSource::Token::Integer: {
+      long long value = 0;
+      // Например, целое вне 64 бит: иначе оно стало бы константой 0
+      if (!source_.getInteger(value)) {
+        throw std::runtime_error("Failed to read integer from link");
+      }
+      return dag.constant(static_cast<double>(value));
+    }
+    case ExpressionSource::Token::Real: {
+      double value = 0.0;
+      if (!source_.getReal(value)) {
+        throw std::runtime_error("Failed to read real from link");
+      }
+      return dag.constant(value);
+    }
+    case ExpressionSource::Token::Symbol: {
+      std::string name;
+      if (!source_.getSymbol(name)) {
+        throw std::runtime_error("Failed to read symbol from link");
+      }
+      if (name == "Pi") return dag.constant(kPi);
+      if (name == "E") return dag.constant(kE);
+      return dag.variable(name);
+    }
+    case ExpressionSource::Token::Function: {
+      std::string head;
+      int argCount = 0;
+      if (!source_.getFunction(head, argCount)) {
+        throw std::runtime_error("Failed to read function from link");
+      }
+      return readCall(dag, head, argCount);
+    }
+    case ExpressionSource::Token::Error:
+      break;
+  }
+  throw std::runtime_error("Failed to read expression from link");
+}
+
+std::uint32_t ExpressionReader::readCall(ExpressionDag& dag,
+                                         const std::string& head,
+                                         int argCount) {
+  if (head == "Slot") {
+    long long index = 0;
+    if (argCount != 1 || !source_.getInteger(index)) {
+      throw std::runtime_error("Slot requires an integer index");
+    }
+    if (index != 1) {
+      std::cerr << "Warning: Slot[" << index
+                << "] is not supported, using 0.0" << std::endl;
+      return dag.constant(0.0);
+    }
+    return dag.variable("#");
+  }
+
+  // Аргументы читаются целиком даже для неподдерживаемых функций, чтобы
+  // не рассинхронизировать ссылку
+  std::vector<std::uint32_t> args(argCount);
+  for (int i = 0; i < argCount; ++i) args[i] = readExpression(dag);
+
+  if (head == "Rational" && argCount == 2) {
+    double num = 0.0;
+    double denom = 0.0;
+    if (dag.constantValue(args[0], num) && dag.constantValue(args[1], denom)) {
+      return dag.constant(num / denom);
+    }
+  }
+
+  return emitFunctionCall(dag, head, args.size(),
+                          [&args](size_t i) { return args[i]; });
+}
+
+void ExpressionReader::skipExpression() {
+  std::string text;
+  long long integer = 0;
+  double real = 0.0;
+  int argCount = 0;
+  switch (source_.peek()) {
+    case ExpressionSource::Token::Integer:
+      if (source_.getInteger(integer)) return;
+      break;
+    case ExpressionSource::Token::Real:
+      if (source_.getReal(real)) return;
+      break;
+    case ExpressionSource::Token::Symbol:
+      if (source_.getSymbol(text)) return;
+      break;
+    case ExpressionSource::Token::Function:
+      if (!source_.getFunction(text, argCount)) break;
+      for (int i = 0; i < argCount; ++i) skipExpression();
+      return;
+    case ExpressionSource::Token::Error:
+      break;
+  }
+  throw std::runtime_error("Failed to read expression from link");
+}
+
+/*!
+ * \brief Читает count функций подряд и компилирует их в одну программу.
+ * \param[in] count Число функций (1 для подынтегральной, 2 для кривой).
+ * \param[in] withDerivatives Добавить выходы с производными.
+ * \param[out] report Размер выражений до и после оптимизации.
+ * \return Программа с count (или 2 * count) выходами.
+ */
+BytecodeProgram ExpressionReader::compileFunctions(
+    int count, bool withDerivatives, OptimizationReport* report) {
+  ExpressionDag dag({"t"});
+  std::vector<std::uint32_t> roots;
+  for (int i = 0; i < count; ++i) roots.push_back(readFunction(dag));
+  if (withDerivatives) {
+    for (int i = 0; i < count; ++i) {
+      roots.push_back(dag.derivative(roots[i], 0));
+    }
+  }
+  return dag.compile(roots, report);
+}
@@ -0,0 +1,99 @@
+#ifndef EXPRESSIONREADER_H
+#define EXPRESSIONREADER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ExpressionOptimizer.h"
+#include "ExpressionVM.h"
+
+/*!
+ * \class ExpressionSource
+ * \brief Поток лексем выражения Mathematica в порядке WSTP (префиксный обход).
+ *
+ * Функция f[a, b] передается как Function(head = "f", argCount = 2), за
+ * которой следуют лексемы аргументов. Реализации: WSTPExpressionSource
+ * (Parser.cpp) читает прямо из ссылки, FakeExpressionSource — из списка
+ * лексем в памяти, что позволяет проверять разбор без Mathematica.
+ */
+class ExpressionSource {
+ public:
+  enum class Token { Function, Integer, Real, Symbol, Error };
+
+  virtual ~ExpressionSource() = default;
+
+  //! Тип следующей лексемы (не извлекает ее)
+  virtual Token peek() = 0;
+  virtual bool getFunction(std::string& head, int& argCount) = 0;
+  virtual bool getInteger(long long& value) = 0;
+  virtual bool getReal(double& value) = 0;
+  virtual bool getSymbol(std::string& name) = 0;
+};
+
+/*!
+ * \class FakeExpressionSource
+ * \brief Поток лексем в памяти, имитирующий ссылку WSTP.
+ */
+class FakeExpressionSource : public ExpressionSource {
+ public:
+  struct Item {
+    Token token;
+    std::string text;  // голова функции или имя символа
+    int argCount;
+    double value;
+  };
+
+  FakeExpressionSource() = default;
+  explicit FakeExpressionSource(std::vector<Item> items)
+      : items_(std::move(items)) {}
+
+  static FakeExpressionSource fromFullForm(const std::string& fullForm);
+
+  FakeExpressionSource& function(const std::string& head, int argCount);
+  FakeExpressionSource& integer(long long value);
+  FakeExpressionSource& real(double value);
+  FakeExpressionSource& symbol(const std::string& name);
+
+  Token peek() override;
+  bool getFunction(std::string& head, int& argCount) override;
+  bool getInteger(long long& value) override;
+  bool getReal(double& value) override;
+  bool getSymbol(std::string& name) override;
+
+  bool atEnd() const { return pos_ == items_.size(); }
+
+ private:
+  const Item* take(Token token);
+
+  std::vector<Item> items_;
+  size_t pos_ = 0;
+};
+
+/*!
+ * \class ExpressionReader
+ * \brief Переводит выражение из ExpressionSource сразу в ExpressionDag,
+ * без промежуточной строки FullForm.
+ *
+ * Поддерживаются Function[body] со Slot (#), Function[x, body] и
+ * Function[{x}, body] с именованным параметром, Rational, Power, а также
+ * Plus, Times, Sin, Cos, Tan, Exp, Log, Sqrt и символы Pi и E.
+ */
+class ExpressionReader {
+ public:
+  explicit ExpressionReader(ExpressionSource& source) : source_(source) {}
+
+  std::uint32_t readFunction(ExpressionDag& dag);
+  std::uint32_t readExpression(ExpressionDag& dag);
+
+  BytecodeProgram compileFunctions(int count, bool withDerivatives = false,
+                                   OptimizationReport* report = nullptr);
+
+ private:
+  std::uint32_t readCall(ExpressionDag& dag, const std::string& head,
+                         int argCount);
+  void skipExpression();
+
+  ExpressionSource& source_;
+  std::string parameter_ = "#";
+};
+#endif
@@ -0,0 +1,334 @@
+#include "ExpressionVM.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Во время компиляции число переменных и констант еще не известно, поэтому
+// регистры помечаются старшими битами и переставляются в finish().
+constexpr std::uint32_t kConstantTag = 0x40000000u;
+constexpr std::uint32_t kTempTag = 0x80000000u;
+constexpr std::uint32_t kIndexMask = 0x3fffffffu;
+
+// Для небольших выражений регистры размещаются на стеке
+constexpr std::uint32_t kInlineRegisters = 64;
+
+// Поэлементные ядра пакетного режима. Циклы без ветвлений помечены
+// для векторизации; трансцендентные функции векторизуются, если компилятор
+// располагает векторной math-библиотекой (SVML в MSVC, libmvec в glibc).
+template <typename Op>
+void applyBinary(const double* a, const double* b, double* dst, size_t n,
+                 Op op) {
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) dst[i] = op(a[i], b[i]);
+}
+
+template <typename Op>
+void applyUnary(const double* a, double* dst, size_t n, Op op) {
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) dst[i] = op(a[i]);
+}
+
+}  // namespace
+
+/*!
+ * \brief Выгружает вызов функции Mathematica head[args...] в builder.
+ * \param[in] builder Получатель операций.
+ * \param[in] head Имя функции (Plus, Times, Power, Sin, ...).
+ * \param[in] argCount Количество аргументов.
+ * \param[in] emitArg Выгружает i-й аргумент и возвращает его результат.
+ * \return Результат вызова.
+ *
+ * \details
+ * Общая часть для всех представлений AST. Неподдерживаемые функции и
+ * неверное число аргументов заменяются константой 0.0 с предупреждением.
+ */
+std::uint32_t emitFunctionCall(
+    ExpressionBuilder& builder, std::string_view head, size_t argCount,
+    const std::function<std::uint32_t(size_t)>& emitArg) {
+  if (head == "Plus" || head == "Times") {
+    OpCode op = (head == "Plus") ? OpCode::Add : OpCode::Mul;
+    if (argCount == 0) {
+      return builder.constant(head == "Plus" ? 0.0 : 1.0);
+    }
+    std::uint32_t acc = emitArg(0);
+    for (size_t i = 1; i < argCount; ++i) {
+      acc = builder.emit(op, acc, emitArg(i));
+    }
+    return acc;
+  }
+  if (head == "Power") {
+    if (argCount != 2) {
+      std::cerr << "Warning: Power requires exactly 2 arguments, but got "
+                << argCount << std::endl;
+      return builder.constant(0.0);
+    }
+    std::uint32_t base = emitArg(0);
+    std::uint32_t exponent = emitArg(1);
+    return builder.emit(OpCode::Pow, base, exponent);
+  }
+  if (head == "Log" && argCount == 2) {
+    std::uint32_t base = emitArg(0);
+    std::uint32_t arg = emitArg(1);
+    return builder.emit(OpCode::LogBase, base, arg);
+  }
+
+  static const std::pair<std::string_view, OpCode> unaryOps[] = {
+      {"Sin", OpCode::Sin}, {"Cos", OpCode::Cos}, {"Tan", OpCode::Tan},
+      {"Exp", OpCode::Exp}, {"Log", OpCode::Log}, {"Sqrt", OpCode::Sqrt}};
+  for (const auto& unary : unaryOps) {
+    if (unary.first != head) continue;
+    if (argCount != 1) {
+      std::cerr << "Warning: " << head
+                << " requires exactly 1 argument, but got " << argCount
+                << std::endl;
+      return builder.constant(0.0);
+    }
+    return builder.emit(unary.second, emitArg(0));
+  }
+
+  std::cerr << "Warning: Unsupported function: " << head << ", returning 0.0"
+            << std::endl;
+  return builder.constant(0.0);
+}
+
+BytecodeCompiler::BytecodeCompiler(std::vector<std::string> variables,
+                                   bool autoVariables)
+    : variables_(std::move(variables)), autoVariables_(autoVariables) {
+  for (std::uint32_t i = 0; i < variables_.size(); ++i) {
+    variableSlots_.emplace(variables_[i], i);
+  }
+}
+
+/*!
+ * \brief Возвращает регистр переменной.
+ * \param[in] name Имя переменной.
+ * \return Регистр слота переменной.
+ *
+ * \details
+ * Неизвестная переменная (при выключенном autoVariables) заменяется
+ * константой 0.0 с предупреждением, как и в замыканиях Expression::compile,
+ * только предупреждение выводится один раз при компиляции.
+ */
+std::uint32_t BytecodeCompiler::variable(const std::string& name) {
+  auto it = variableSlots_.find(name);
+  if (it != variableSlots_.end()) return it->second;
+
+  if (!autoVariables_) {
+    std::cerr << "Warning: Variable not found: " << name
+              << ", using 0.0 as default value" << std::endl;
+    return constant(0.0);
+  }
+
+  std::uint32_t slot = static_cast<std::uint32_t>(variables_.size());
+  variables_.push_back(name);
+  variableSlots_.emplace(name, slot);
+  return slot;
+}
+
+std::uint32_t BytecodeCompiler::constant(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  auto it = constantSlots_.find(bits);
+  if (it != constantSlots_.end()) return it->second;
+
+  std::uint32_t reg =
+      kConstantTag | static_cast<std::uint32_t>(constants_.size());
+  constants_.push_back(value);
+  constantSlots_.emplace(bits, reg);
+  return reg;
+}
+
+std::uint32_t BytecodeCompiler::emit(OpCode op, std::uint32_t a,
+                                     std::uint32_t b) {
+  std::uint32_t dst = kTempTag | numTemps_++;
+  code_.push_back({op, dst, a, b});
+  return dst;
+}
+
+std::uint32_t BytecodeCompiler::resolve(std::uint32_t reg,
+                                        std::uint32_t tempBase) const {
+  if (reg & kTempTag) return tempBase + (reg & kIndexMask);
+  if (reg & kConstantTag)
+    return static_cast<std::uint32_t>(variables_.size()) + (reg & kIndexMask);
+  return reg;
+}
+
+BytecodeProgram BytecodeCompiler::finish(std::uint32_t result) {
+  return finish(std::vector<std::uint32_t>{result});
+}
+
+/*!
+ * \brief Завершает компиляцию и раскладывает регистры.
+ * \param[in] results Регистры с результатами выходов программы.
+ * \return Готовая программа.
+ */
+BytecodeProgram BytecodeCompiler::finish(
+    const std::vector<std::uint32_t>& results) {
+  const std::uint32_t tempBase =
+      static_cast<std::uint32_t>(variables_.size() + constants_.size());
+
+  BytecodeProgram program;
+  program.code_.reserve(code_.size());
+  for (const Instruction& in : code_) {
+    program.code_.push_back({in.op, resolve(in.dst, tempBase),
+                             resolve(in.a, tempBase),
+                             resolve(in.b, tempBase)});
+  }
+  program.constants_ = constants_;
+  program.variables_ = variables_;
+  program.numRegisters_ = tempBase + numTemps_;
+  for (std::uint32_t result : results) {
+    program.results_.push_back(resolve(result, tempBase));
+  }
+  return program;
+}
+
+int BytecodeProgram::variableSlot(const std::string& name) const {
+  for (size_t i = 0; i < variables_.size(); ++i) {
+    if (variables_[i] == name) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+// Загружает переменные и константы в регистры r и выполняет код
+void BytecodeProgram::run(const double* vars, double* r) const {
+  const size_t numVars = variables_.size();
+  std::copy(vars, vars + numVars, r);
+  std::copy(constants_.begin(), constants_.end(), r + numVars);
+
+  for (const Instruction& in : code_) {
+    r[in.dst] = applyOpCode(in.op, r[in.a], r[in.b]);
+  }
+}
+
+/*!
+ * \brief Вычисляет первый выход программы.
+ * \param[in] vars Значения переменных в порядке слотов (variables()).
+ * \return Значение выражения.
+ */
+double BytecodeProgram::evaluate(const double* vars) const {
+  double inlineRegisters[kInlineRegisters];
+  std::vector<double> heapRegisters;
+  double* r = inlineRegisters;
+  if (numRegisters_ > kInlineRegisters) {
+    heapRegisters.resize(numRegisters_);
+    r = heapRegisters.data();
+  }
+
+  run(vars, r);
+  return r[results_[0]];
+}
+
+/*!
+ * \brief Вычисляет все выходы программы.
+ * \param[in] vars Значения переменных в порядке слотов (variables()).
+ * \param[out] out Массив из outputCount() значений.
+ */
+void BytecodeProgram::evaluateAll(const double* vars, double* out) const {
+  double inlineRegisters[kInlineRegisters];
+  std::vector<double> heapRegisters;
+  double* r = inlineRegisters;
+  if (numRegisters_ > kInlineRegisters) {
+    heapRegisters.resize(numRegisters_);
+    r = heapRegisters.data();
+  }
+
+  run(vars, r);
+  for (size_t k = 0; k < results_.size(); ++k) {
+    out[k] = r[results_[k]];
+  }
+}
+
+void BytecodeProgram::evaluateBatch(const double* const* vars, double* out,
+                                    size_t n) const {
+  evaluateBatch(vars, &out, n);
+}
+
+/*!
+ * \brief Пакетно вычисляет программу для n наборов переменных.
+ * \param[in] vars Массивы значений переменных в порядке слотов (SoA):
+ * vars[slot][i] — значение переменной slot в i-й точке.
+ * \param[out] outs Массивы из n результатов, по одному на выход.
+ * \param[in] n Количество точек.
+ *
+ * \details
+ * Каждая инструкция выполняется сразу над блоком из kBatchBlock точек, так
+ * что разбор кода операции происходит один раз на блок, а не на точку.
+ * Регистры переменных указывают прямо во входные массивы, константы
+ * размножаются по блоку один раз на вызов.
+ */
+void BytecodeProgram::evaluateBatch(const double* const* vars,
+                                    double* const* outs, size_t n) const {
+  const size_t numVars = variables_.size();
+  const size_t numConstants = constants_.size();
+
+  // Блоки констант и временных регистров
+  std::vector<double> scratch((numRegisters_ - numVars) * kBatchBlock);
+  for (size_t c = 0; c < numConstants; ++c) {
+    std::fill_n(scratch.begin() + c * kBatchBlock, kBatchBlock, constants_[c]);
+  }
+
+  std::vector<const double*> reg(numRegisters_);
+  for (size_t r = numVars; r < numRegisters_; ++r) {
+    reg[r] = scratch.data() + (r - numVars) * kBatchBlock;
+  }
+
+  for (size_t offset = 0; offset < n; offset += kBatchBlock) {
+    const size_t m = std::min(kBatchBlock, n - offset);
+    for (size_t v = 0; v < numVars; ++v) {
+      reg[v] = vars[v] + offset;
+    }
+
+    for (const Instruction& in : code_) {
+      const double* a = reg[in.a];
+      const double* b = reg[in.b];
+      double* dst = scratch.data() + (in.dst - numVars) * kBatchBlock;
+      switch (in.op) {
+        case OpCode::Add:
+          applyBinary(a, b, dst, m, [](double x, double y) { return x + y; });
+          break;
+        case OpCode::Mul:
+          applyBinary(a, b, dst, m, [](double x, double y) { return x * y; });
+          break;
+        case OpCode::Div:
+          applyBinary(a, b, dst, m, [](double x, double y) { return x / y; });
+          break;
+        case OpCode::Pow:
+          for (size_t i = 0; i < m; ++i) dst[i] = guardedPow(a[i], b[i]);
+          break;
+        case OpCode::Sin:
+          applyUnary(a, dst, m, [](double x) { return std::sin(x); });
+          break;
+        case OpCode::Cos:
+          applyUnary(a, dst, m, [](double x) { return std::cos(x); });
+          break;
+        case OpCode::Tan:
+          applyUnary(a, dst, m, [](double x) { return std::tan(x); });
+          break;
+        case OpCode::Exp:
+          applyUnary(a, dst, m, [](double x) { return std::exp(x); });
+          break;
+        case OpCode::Log:
+          applyUnary(a, dst, m, [](double x) { return std::log(x); });
+          break;
+        case OpCode::LogBase:
+          applyBinary(a, b, dst, m, [](double x, double y) {
+            return std::log(y) / std::log(x);
+          });
+          break;
+        case OpCode::Sqrt:
+          applyUnary(a, dst, m, [](double x) { return std::sqrt(x); });
+          break;
+      }
+    }
+
+    for (size_t k = 0; k < results_.size(); ++k) {
+      std::copy(reg[results_[k]], reg[results_[k]] + m, outs[k] + offset);
+    }
+  }
+}
@@ -0,0 +1,197 @@
+#ifndef EXPRESSIONVM_H
+#define EXPRESSIONVM_H
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief Коды операций регистровой виртуальной машины.
+ */
+enum class OpCode : std::uint8_t {
+  Add,      //!< r[dst] = r[a] + r[b]
+  Mul,      //!< r[dst] = r[a] * r[b]
+  Div,      //!< r[dst] = r[a] / r[b]
+  Pow,      //!< r[dst] = r[a] ^ r[b]
+  Sin,      //!< r[dst] = sin(r[a])
+  Cos,      //!< r[dst] = cos(r[a])
+  Tan,      //!< r[dst] = tan(r[a])
+  Exp,      //!< r[dst] = exp(r[a])
+  Log,      //!< r[dst] = log(r[a])
+  LogBase,  //!< r[dst] = log(r[b]) / log(r[a])
+  Sqrt      //!< r[dst] = sqrt(r[a])
+};
+
+inline bool isUnary(OpCode op) {
+  return op != OpCode::Add && op != OpCode::Mul && op != OpCode::Div &&
+         op != OpCode::Pow && op != OpCode::LogBase;
+}
+
+/*!
+ * \brief Возведение в степень с обработкой особых случаев Power.
+ */
+inline double guardedPow(double b, double e) {
+  // Обработка случая 0^negative
+  if (b == 0.0 && e < 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  // Обработка отрицательных оснований с дробными степенями
+  if (b < 0.0 && std::trunc(e) != e) {
+    std::cerr << "Warning: Negative base with non-integer exponent\n";
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  return std::pow(b, e);
+}
+
+/*!
+ * \brief Выполняет одну операцию над скалярами (для унарных b не
+ * используется).
+ */
+inline double applyOpCode(OpCode op, double a, double b) {
+  switch (op) {
+    case OpCode::Add:
+      return a + b;
+    case OpCode::Mul:
+      return a * b;
+    case OpCode::Div:
+      return a / b;
+    case OpCode::Pow:
+      return guardedPow(a, b);
+    case OpCode::Sin:
+      return std::sin(a);
+    case OpCode::Cos:
+      return std::cos(a);
+    case OpCode::Tan:
+      return std::tan(a);
+    case OpCode::Exp:
+      return std::exp(a);
+    case OpCode::Log:
+      return std::log(a);
+    case OpCode::LogBase:
+      return std::log(b) / std::log(a);
+    case OpCode::Sqrt:
+      return std::sqrt(a);
+  }
+  return 0.0;
+}
+
+/*!
+ * \brief Одна инструкция байткода: операция и индексы регистров.
+ */
+struct Instruction {
+  OpCode op;
+  std::uint32_t dst;
+  std::uint32_t a;
+  std::uint32_t b;
+};
+
+/*!
+ * \class ExpressionBuilder
+ * \brief Интерфейс, в который узлы AST (Expression::emit) выгружают себя.
+ *
+ * Возвращаемые значения — идентификаторы результатов узлов, их смысл
+ * определяет реализация (регистры байткода, узлы DAG и т.п.).
+ */
+class ExpressionBuilder {
+ public:
+  virtual ~ExpressionBuilder() = default;
+
+  virtual std::uint32_t variable(const std::string& name) = 0;
+  virtual std::uint32_t constant(double value) = 0;
+  virtual std::uint32_t emit(OpCode op, std::uint32_t a,
+                             std::uint32_t b = 0) = 0;
+};
+
+std::uint32_t emitFunctionCall(
+    ExpressionBuilder& builder, std::string_view head, size_t argCount,
+    const std::function<std::uint32_t(size_t)>& emitArg);
+
+/*!
+ * \class BytecodeProgram
+ * \brief Скомпилированное выражение в виде линейного байткода.
+ *
+ * Регистры программы расположены так: сначала слоты переменных, затем
+ * константы, затем временные значения. Переменные разрешаются в номера
+ * слотов на этапе компиляции, поэтому при вычислении не выполняется ни
+ * одного поиска по имени.
+ *
+ * Программа может иметь несколько выходов (например, x(t) и y(t) кривой
+ * с общими подвыражениями); evaluate() возвращает первый.
+ */
+class BytecodeProgram {
+ public:
+  BytecodeProgram() = default;
+
+  double evaluate(const double* vars) const;
+  double operator()(double x) const { return evaluate(&x); }
+  void evaluateAll(const double* vars, double* out) const;
+
+  void evaluateBatch(const double* const* vars, double* out, size_t n) const;
+  void evaluateBatch(const double* const* vars, double* const* outs,
+                     size_t n) const;
+
+  //! Размер блока точек, который обрабатывает одна инструкция за раз
+  static constexpr size_t kBatchBlock = 256;
+
+  int variableSlot(const std::string& name) const;
+  const std::vector<std::string>& variables() const { return variables_; }
+  size_t outputCount() const { return results_.size(); }
+  size_t instructionCount() const { return code_.size(); }
+  size_t registerCount() const { return numRegisters_; }
+
+  // Доступ к коду для генераторов (см. ExpressionCodegen)
+  const std::vector<Instruction>& code() const { return code_; }
+  const std::vector<double>& constants() const { return constants_; }
+  const std::vector<std::uint32_t>& results() const { return results_; }
+
+ private:
+  friend class BytecodeCompiler;
+
+  void run(const double* vars, double* r) const;
+
+  std::vector<Instruction> code_;
+  std::vector<double> constants_;
+  std::vector<std::string> variables_;
+  std::uint32_t numRegisters_ = 0;
+  std::vector<std::uint32_t> results_;
+};
+
+/*!
+ * \class BytecodeCompiler
+ * \brief Построитель байткода.
+ *
+ * Если компилятор создан с пустым списком переменных и autoVariables = true,
+ * новые переменные получают слоты в порядке первого появления.
+ */
+class BytecodeCompiler : public ExpressionBuilder {
+ public:
+  explicit BytecodeCompiler(std::vector<std::string> variables,
+                            bool autoVariables = false);
+
+  std::uint32_t variable(const std::string& name) override;
+  std::uint32_t constant(double value) override;
+  std::uint32_t emit(OpCode op, std::uint32_t a,
+                     std::uint32_t b = 0) override;
+
+  BytecodeProgram finish(std::uint32_t result);
+  BytecodeProgram finish(const std::vector<std::uint32_t>& results);
+
+ private:
+  std::uint32_t resolve(std::uint32_t reg, std::uint32_t tempBase) const;
+
+  std::vector<std::string> variables_;
+  std::unordered_map<std::string, std::uint32_t> variableSlots_;
+  bool autoVariables_;
+  std::vector<double> constants_;
+  std::unordered_map<std::uint64_t, std::uint32_t> constantSlots_;
+  std::vector<Instruction> code_;
+  std::uint32_t numTemps_ = 0;
+};
+#endif
@@ -1,588 +1,1350 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
-#include <functional>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <memory>
-#include <sstream>
-#include <stack>
+#include <limits>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
-// Чисто виртуальный класс для представления выражения
-class Expression {
-public:
-    virtual ~Expression() = default;
-    virtual std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const = 0;
-    virtual std::string toString() const = 0;
-};
-
-// Константа
-class Constant : public Expression {
-private:
-    double value;
-
-public:
-    explicit Constant(double val) : value(val) {}
-
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const override {
-        double val = value;
-        return [val](const std::unordered_map<std::string, double>&) -> double {
-            return val;
-            };
-    }
-
-    std::string toString() const override { return std::to_string(value); }
-};
-
-// Переменная
-class Variable : public Expression {
-private:
-    std::string name;
-
-public:
-    explicit Variable(std::string n) : name(std::move(n)) {}
-
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const override {
-        std::string local_name = name;
-        return [local_name](
-            const std::unordered_map<std::string, double>& vars) -> double {
-                auto it = vars.find(local_name);
-                if (it == vars.end()) {
-                    std::cerr << "Warning: Variable not found: " << local_name
-                        << ", using 0.0 as default value" << std::endl;
-                    return 0.0;  // Возвращаем 0.0 по умолчанию вместо исключения
-                }
-                return it->second;
-            };
-    }
+#include "BicubicInterpolator.h"
+#include "BoundHierarchy.h"
+#include "CpuDispatch.h"
+#include "ExpressionReader.h"
+#include "FullFormParser.h"
+#include "GridStore.h"
+#include "HandleRegistry.h"
+#include "InterpolatorPyramid.h"
+#include "JobScheduler.h"
+#include "Metrics.h"
+#include "PackedArrayLink.h"
+#include "SharedMemoryClient.h"
+#include "SharedMemoryServer.h"
+#include "Snapshot.h"
+#include "SpaceTimeInterpolator.h"
+#include "TensorInterpolator.h"
+#include "TiledGrid.h"
+#include "Trace.h"
+
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Вспомогательная функция для проверки равенства значений с плавающей точкой
+bool almostEqual(double a, double b, double epsilon = 1e-10) {
+    return std::abs(a - b) < epsilon;
+}
 
-    std::string toString() const override { return name; }
-};
+// Среднее время одного вызова f в наносекундах
+template <typename F>
+double measureNanoseconds(F&& f, int iterations) {
+    volatile double sink = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        sink = sink + f(i * 1e-6);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() /
+        iterations;
+}
 
-// Рациональное число
-class Rational : public Expression {
-private:
-    int numerator;
-    int denominator;
+// Сравнение замыканий Expression::compile с байткодом
+void benchmarkClosuresVsBytecode(const std::string& fullForm) {
+    const int iterations = 1000000;
+    MathematicaParser parser(fullForm);
+    auto expr = parser.parse();
+
+    auto closure = expr->compile();
+    const std::string var =
+        std::dynamic_pointer_cast<Lambda>(expr) ? "#" : "x";
+    double closureNs = measureNanoseconds([&](double x) {
+        std::unordered_map<std::string, double> vars = { {var, x} };
+        return closure(vars);
+        }, iterations);
+
+    BytecodeProgram program = expr->compileBytecode({ var });
+    double bytecodeNs = measureNanoseconds(
+        [&](double x) { return program.evaluate(&x); }, iterations);
+
+    OptimizationReport report;
+    BytecodeProgram optimized =
+        MathematicaParser::compileUnaryBytecode(expr, &report);
+    double optimizedNs = measureNanoseconds(
+        [&](double x) { return optimized.evaluate(&x); }, iterations);
+
+    std::cout << "Benchmark " << fullForm << ": closures " << closureNs
+        << " ns/eval, bytecode " << bytecodeNs << " ns/eval ("
+        << program.instructionCount() << " instructions, speedup "
+        << closureNs / bytecodeNs << "x), optimized " << optimizedNs
+        << " ns/eval (" << optimized.instructionCount() << " instructions, "
+        << report.nodesBefore << " -> " << report.nodesAfter << " nodes)"
+        << std::endl;
+}
 
-public:
-    Rational(int num, int denom) : numerator(num), denominator(denom) {}
+// Общие подвыражения x(t) и y(t) кривой
+void reportCurveOptimization(const std::string& xFullForm,
+    const std::string& yFullForm) {
+    MathematicaParser xParser(xFullForm);
+    MathematicaParser yParser(yFullForm);
+    OptimizationReport report;
+    BytecodeProgram program = MathematicaParser::compileOptimized(
+        { xParser.parse(), yParser.parse() }, &report);
+
+    double t = 0.3;
+    double xy[2];
+    program.evaluateAll(&t, xy);
+    std::cout << "Curve {" << xFullForm << ", " << yFullForm << "}: "
+        << report.nodesBefore << " -> " << report.nodesAfter << " nodes, "
+        << program.instructionCount() << " instructions; at t=0.3: ("
+        << xy[0] << ", " << xy[1] << "), expected ("
+        << std::sin(t) * std::exp(-t) << ", " << std::sin(t) * std::sin(t) * 2
+        << ")" << std::endl;
+}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const override {
-        return [this](const std::unordered_map<std::string, double>&) -> double {
-            return static_cast<double>(numerator) / denominator;
-            };
+// Сравнение поточечного и пакетного вычисления байткода
+void benchmarkBatch(const std::string& fullForm) {
+    const size_t n = 1000000;
+    MathematicaParser parser(fullForm);
+    BytecodeProgram program =
+        MathematicaParser::compileUnaryBytecode(parser.parse());
+
+    std::vector<double> t(n), scalar(n), batch(n);
+    for (size_t i = 0; i < n; ++i) t[i] = i * 1e-6;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) scalar[i] = program.evaluate(&t[i]);
+    auto middle = std::chrono::steady_clock::now();
+    const double* vars = t.data();
+    program.evaluateBatch(&vars, batch.data(), n);
+    auto stop = std::chrono::steady_clock::now();
+
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        maxDiff = std::max(maxDiff, std::abs(scalar[i] - batch[i]));
     }
+    double scalarNs =
+        std::chrono::duration<double, std::nano>(middle - start).count() / n;
+    double batchNs =
+        std::chrono::duration<double, std::nano>(stop - middle).count() / n;
+    std::cout << "Batch " << fullForm << ": scalar " << scalarNs
+        << " ns/point, batch " << batchNs << " ns/point (speedup "
+        << scalarNs / batchNs << "x, max diff " << maxDiff << ")" << std::endl;
+}
 
-    std::string toString() const override {
-        return std::to_string(numerator) + "/" + std::to_string(denominator);
+// Повторная отправка того же текста должна обходиться без разбора
+void reportCache(const std::string& fullForm) {
+    auto& cache = CompiledExpressionCache::instance();
+    std::uint64_t hitsBefore = cache.hits();
+    std::uint64_t missesBefore = cache.misses();
+    const int iterations = 10000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        // Пробелы не влияют на ключ
+        MathematicaParser::parseFunction(i % 2 ? fullForm : " " + fullForm);
     }
-};
+    auto stop = std::chrono::steady_clock::now();
+
+    std::cout << "Cache " << fullForm << ": "
+        << std::chrono::duration<double, std::micro>(stop - start).count() /
+        iterations
+        << " us/parseFunction, hits +" << cache.hits() - hitsBefore
+        << ", misses +" << cache.misses() - missesBefore << ", size "
+        << cache.size() << "/" << cache.capacity() << std::endl;
+}
 
-// Функция с несколькими аргументами (или одним)
-class Function : public Expression {
-private:
-    std::string head;
-    std::vector<std::shared_ptr<Expression>> args;
+// Машинно сгенерированный многочлен с terms слагаемыми
+std::string generatePolynomial(int terms) {
+    std::string result = "Plus[";
+    for (int i = 0; i < terms; ++i) {
+        if (i > 0) result += ", ";
+        result += "Times[" + std::to_string(1.0 / (i + 1)) + ", Power[x, " +
+            std::to_string(i % 7) + "], Cos[Times[Rational[1, " +
+            std::to_string(i + 2) + "], x]]]";
+    }
+    return result + "]";
+}
 
-public:
-    Function(std::string h, std::vector<std::shared_ptr<Expression>> a)
-        : head(std::move(h)), args(std::move(a)) {}
+// Пропускная способность разбора: shared_ptr AST против арены
+void benchmarkParse(int terms) {
+    const std::string input = generatePolynomial(terms);
+    const double megabytes = input.size() / (1024.0 * 1024.0);
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const override {
-        if (head == "Plus") {
-            return compilePlus();
-        }
-        else if (head == "Times") {
-            return compileTimes();
-        }
-        else if (head == "Power") {
-            return compilePower();
-        }
-        else if (head == "Sin") {
-            return compileSin();
-        }
-        else if (head == "Cos") {
-            return compileCos();
-        }
-        else if (head == "Exp") {
-            return compileExp();
-        }
-        else if (head == "Log") {
-            return compileLog();
-        }
-        else if (head == "Tan") {
-            return compileTan();
-        }
-        else if (head == "Sqrt") {
-            return compileSqrt();
-        }
-        else {
-            std::cerr << "Warning: Unsupported function: " << head
-                << ", returning 0.0" << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;  // Возвращаем 0.0 по умолчанию для неподдерживаемых функций
-                };
-        }
+    auto start = std::chrono::steady_clock::now();
+    {
+        MathematicaParser parser(input);
+        auto expr = parser.parse();
     }
+    auto middle = std::chrono::steady_clock::now();
+    size_t arenaNodes = 0;
+    size_t arenaBytes = 0;
+    {
+        Arena arena;
+        ArenaParser parser(input, arena);
+        arenaNodes = parser.parse()->subtreeSize();
+        arenaBytes = arena.bytesUsed();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double sharedSeconds = std::chrono::duration<double>(middle - start).count();
+    double arenaSeconds = std::chrono::duration<double>(stop - middle).count();
+    std::cout << "Parse " << terms << " terms (" << megabytes
+        << " MB): shared_ptr " << megabytes / sharedSeconds
+        << " MB/s, arena " << megabytes / arenaSeconds << " MB/s (speedup "
+        << sharedSeconds / arenaSeconds << "x, " << arenaNodes << " nodes, "
+        << arenaBytes << " arena bytes)" << std::endl;
+}
 
-    std::string toString() const override {
-        std::stringstream ss;
-        ss << head << "[";
-        for (size_t i = 0; i < args.size(); ++i) {
-            if (i > 0) ss << ", ";
-            ss << args[i]->toString();
-        }
-        ss << "]";
-        return ss.str();
-    }
-
-private:
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compilePlus() const {
-        std::vector<
-            std::function<double(const std::unordered_map<std::string, double>&)>>
-            compiledArgs;
-        for (const auto& arg : args) {
-            compiledArgs.push_back(arg->compile());
-        }
-
-        return [compiledArgs](
-            const std::unordered_map<std::string, double>& vars) -> double {
-                double sum = 0.0;
-                for (const auto& func : compiledArgs) {
-                    sum += func(vars);
-                }
-                return sum;
-            };
+// Машинный код против пакетного интерпретатора
+void benchmarkNative(const std::string& fullForm) {
+    const size_t n = 1000000;
+    auto program = MathematicaParser::cachedUnaryProgram(fullForm);
+
+    auto compileStart = std::chrono::steady_clock::now();
+    auto native = NativeExpression::compile(program);
+    auto compileStop = std::chrono::steady_clock::now();
+
+    std::vector<double> t(n), interpreted(n), compiled(n);
+    for (size_t i = 0; i < n; ++i) t[i] = i * 1e-6;
+    const double* vars = t.data();
+    double* out = compiled.data();
+
+    auto start = std::chrono::steady_clock::now();
+    program->evaluateBatch(&vars, interpreted.data(), n);
+    auto middle = std::chrono::steady_clock::now();
+    native->evaluateBatch(&vars, &out, n);
+    auto stop = std::chrono::steady_clock::now();
+
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        maxDiff = std::max(maxDiff, std::abs(interpreted[i] - compiled[i]));
     }
+    std::cout << "Native " << fullForm << ": "
+        << (native->isNative() ? native->libraryPath() : "fallback")
+        << ", compile "
+        << std::chrono::duration<double, std::milli>(compileStop - compileStart)
+        .count()
+        << " ms, batch bytecode "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / n
+        << " ns/point, native "
+        << std::chrono::duration<double, std::nano>(stop - middle).count() / n
+        << " ns/point (max diff " << maxDiff << ")" << std::endl;
+}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileTimes() const {
-        std::vector<
-            std::function<double(const std::unordered_map<std::string, double>&)>>
-            compiledArgs;
-        for (const auto& arg : args) {
-            compiledArgs.push_back(arg->compile());
-        }
+// Производные кривой и интеграл по длине дуги
+void reportArcLength() {
+    const std::string xFullForm = "Plus[2, Cos[#]]&";
+    const std::string yFullForm = "Plus[2, Times[Sin[x], Exp[Times[0, x]]]]";
+    auto curve = MathematicaParser::parseCurveDerivativeBatchFunction(
+        xFullForm, yFullForm);
+
+    double t = 0.7, x, y, dx, dy;
+    curve(&t, &x, &y, &dx, &dy, 1);
+    std::cout << "Derivatives at t=0.7: (" << dx << ", " << dy
+        << "), expected (" << -std::sin(t) << ", " << std::cos(t) << ")"
+        << std::endl;
+
+    // Единичное поле: интеграл по длине дуги равен длине окружности
+    std::vector<std::vector<double>> ones(5, std::vector<double>(5, 1.0));
+    auto interpolator = std::make_shared<const BicubicInterpolator>(ones);
+    ParametricCurveIntegrator integrator(interpolator, curve);
+    std::cout << "Arc length of unit circle: "
+        << integrator.integrateArcLength(0.0, 2 * std::acos(-1.0), 200)
+        << " (expected " << 2 * std::acos(-1.0) << ")" << std::endl;
+}
 
-        return [compiledArgs](
-            const std::unordered_map<std::string, double>& vars) -> double {
-                double product = 1.0;
-                for (const auto& func : compiledArgs) {
-                    product *= func(vars);
-                }
-                return product;
-            };
-    }
-
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compilePower() const {
-        if (args.size() != 2) {
-            std::cerr << "Warning: Power requires exactly 2 arguments, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
-        }
+// Чтение Function[...] из потока лексем WSTP без Mathematica
+void reportLinkReader() {
+    // Function[Plus[Slot[1], Power[Slot[1], Rational[1, 2]]]]: # + Sqrt[#]
+    FakeExpressionSource slotSource;
+    slotSource.function("Function", 1)
+        .function("Plus", 2)
+        .function("Slot", 1).integer(1)
+        .function("Power", 2)
+        .function("Slot", 1).integer(1)
+        .function("Rational", 2).integer(1).integer(2);
+    // Function[{u}, Times[Pi, u]]
+    FakeExpressionSource namedSource;
+    namedSource.function("Function", 2)
+        .function("List", 1).symbol("u")
+        .function("Times", 2).symbol("Pi").symbol("u");
+
+    double t = 2.0;
+    ExpressionReader slotReader(slotSource);
+    ExpressionReader namedReader(namedSource);
+    double slotValue = slotReader.compileFunctions(1).evaluate(&t);
+    double namedValue = namedReader.compileFunctions(1).evaluate(&t);
+    std::cout << "Link reader: Slot form " << slotValue << " (expected "
+        << t + std::sqrt(t) << "), named form " << namedValue << " (expected "
+        << std::acos(-1.0) * t << ")" << std::endl;
+
+    const std::string text = "Times[Sin[x], Exp[Times[Rational[-1, 3], x]]]";
+    FakeExpressionSource textSource = FakeExpressionSource::fromFullForm(text);
+    ExpressionReader textReader(textSource);
+    std::cout << "Link reader from FullForm: "
+        << textReader.compileFunctions(1).evaluate(&t) << " (expected "
+        << MathematicaParser::parseFunction(text)(t) << ", stream consumed: "
+        << (textSource.atEnd() ? "Yes" : "No") << ")" << std::endl;
+}
 
-        auto base = args[0]->compile();
-        auto exponent = args[1]->compile();
+// InterpolateList через ссылку в памяти: один обмен на весь список точек
+void benchmarkInterpolateList(int n) {
+    std::vector<std::vector<double>> grid(64, std::vector<double>(64));
+    for (size_t i = 0; i < grid.size(); ++i)
+        for (size_t j = 0; j < grid[i].size(); ++j)
+            grid[i][j] = std::sin(0.1 * i) * std::cos(0.1 * j);
+    BicubicInterpolator interpolator(grid);
+
+    std::vector<double> points(2 * static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+        points[2 * i] = 60.0 * i / n;
+        points[2 * i + 1] = 60.0 * (n - i) / n;
+    }
 
-        return [base, exponent](const auto& vars) -> double {
-            double b = base(vars);
-            double e = exponent(vars);
+    auto start = std::chrono::high_resolution_clock::now();
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i)
+        sum += interpolator.interpolate(points[2 * i], points[2 * i + 1]);
+    auto middle = std::chrono::high_resolution_clock::now();
+    FakePackedArrayLink link(points, { n, 2 });
+    bool ok = InterpolateListOverLink(link, interpolator);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double maxDiff = 0.0;
+    for (int i = 0; i < n; ++i) {
+        maxDiff = std::max(maxDiff, std::abs(link.output()[i] -
+            interpolator.interpolate(points[2 * i], points[2 * i + 1])));
+    }
+    FakePackedArrayLink badLink({ 1.0, 2.0, 3.0 }, { 3 });
+    InterpolateListOverLink(badLink, interpolator);
+
+    std::cout << "InterpolateList " << n << " points: per-point "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / n
+        << " ns/point, list "
+        << std::chrono::duration<double, std::nano>(stop - middle).count() / n
+        << " ns/point (ok " << ok << ", max diff " << maxDiff
+        << ", released " << link.released() << ", checksum " << sum
+        << "), malformed input -> " << badLink.symbol() << std::endl;
+}
 
-            // Обработка случая 0^negative
-            if (b == 0.0 && e < 0.0) {
-                return std::numeric_limits<double>::infinity();
-            }
+// Создание интерполятора: построчное чтение с транспонированием и рамкой
+// через vector<vector> против одного прохода по упакованному массиву
+void benchmarkCreation(int size) {
+    std::vector<double> matrix(static_cast<size_t>(size) * size);
+    for (size_t k = 0; k < matrix.size(); ++k) matrix[k] = std::sin(0.001 * k);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<double>> rows;
+    for (int i = 0; i < size; ++i) {
+        const double* row = matrix.data() + static_cast<size_t>(i) * size;
+        rows.push_back(std::vector<double>(row, row + size));
+    }
+    std::vector<std::vector<double>> grid(size, std::vector<double>(size));
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j) grid[j][i] = rows[i][j];
+    for (auto& row : grid) {
+        row.insert(row.begin(), 0.0);
+        row.push_back(0.0);
+    }
+    grid.insert(grid.begin(), std::vector<double>(size + 2, 0.0));
+    grid.push_back(std::vector<double>(size + 2, 0.0));
+    BicubicInterpolator legacy(grid);
+    auto legacyStop = std::chrono::high_resolution_clock::now();
+
+    FakePackedArrayLink link(matrix, { size, size });
+    auto middle = std::chrono::high_resolution_clock::now();
+    auto interpolator = CreateInterpolatorOverLink(link);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    const double x = 0.37 * size, y = 0.61 * size;
+    std::cout << "Create " << size << "x" << size << ": copies "
+        << std::chrono::duration<double, std::milli>(legacyStop - start).count()
+        << " ms, single pass "
+        << std::chrono::duration<double, std::milli>(stop - middle).count()
+        << " ms (same value: "
+        << (legacy.interpolate(x, y) == interpolator->interpolate(x, y)
+            ? "Yes" : "No") << ")" << std::endl;
+}
 
-            // Обработка отрицательных оснований с дробными степенями
-            if (b < 0.0 && std::trunc(e) != e) {
-                std::cerr << "Warning: Negative base with non-integer exponent\n";
-                return std::numeric_limits<double>::quiet_NaN();
+// Дескрипторы: устаревшие не находятся, зависимые объекты сохраняют сетку,
+// поиск идет параллельно из нескольких потоков
+void reportHandleRegistry() {
+    HandleRegistry<const BicubicInterpolator> registry;
+    std::vector<std::vector<double>> ones(5, std::vector<double>(5, 1.0));
+    int first = registry.insert(std::make_shared<const BicubicInterpolator>(ones));
+    ParametricCurveIntegrator integrator(registry.find(first),
+        [](double t) { return 1.0 + t; }, [](double) { return 2.0; });
+    registry.erase(first);
+    int second = registry.insert(std::make_shared<const BicubicInterpolator>(ones));
+
+    std::cout << "Handle registry: stale handle found: "
+        << (registry.find(first) ? "Yes" : "No") << ", reused handle differs: "
+        << (first != second ? "Yes" : "No")
+        << ", integral over deleted grid: " << integrator.integrate(0.0, 1.0, 10)
+        << std::endl;
+
+    std::vector<int> handles;
+    for (int i = 0; i < 1000; ++i) {
+        handles.push_back(registry.insert(
+            std::make_shared<const BicubicInterpolator>(ones)));
+    }
+    const int lookups = 1000000;
+    const unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    std::vector<size_t> found(threads, 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned w = 0; w < threads; ++w) {
+        workers.emplace_back([&, w] {
+            size_t local = 0;
+            for (int i = 0; i < lookups; ++i) {
+                if (registry.find(handles[(i * 7 + w) % handles.size()]))
+                    ++local;
             }
-
-            return std::pow(b, e);
-            };
+            found[w] = local;
+        });
     }
+    for (auto& worker : workers) worker.join();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    size_t total = 0;
+    for (size_t f : found) total += f;
+    std::cout << "Handle registry: " << threads << " threads, "
+        << std::chrono::duration<double, std::nano>(stop - start).count() /
+        lookups << " ns per lookup in each thread (" << total << " of "
+        << static_cast<size_t>(threads) * lookups << " found)" << std::endl;
+}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileSin() const {
-        if (args.size() != 1) {
-            std::cerr << "Warning: Sin requires exactly 1 argument, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
-        }
-
-        auto arg = args[0]->compile();
+// Асинхронные задания: результат, ошибка, отмена в очереди и во время работы
+void reportJobScheduler() {
+    JobScheduler scheduler(1);
+    auto simpson = std::make_shared<FunctionNIntegratorBySimpson>(
+        MathematicaParser::parseBatchFunction("Sin[x]"), 1000);
+
+    // Единственный поток занят, пока задание не отменят
+    auto busy = scheduler.submit([](const JobContext& context) {
+        while (!context.cancelled())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 0.0;
+    });
+    auto queued = scheduler.submit([](const JobContext&) { return 1.0; });
+    auto integral = scheduler.submit([simpson](const JobContext&) {
+        return simpson->integrate(0.0, std::acos(-1.0));
+    });
+    auto failing = scheduler.submit([](const JobContext&) -> double {
+        throw std::runtime_error("integration failed");
+    });
+
+    while (scheduler.status(busy) != JobScheduler::Status::Running)
+        std::this_thread::yield();
+    bool queuedCancelled = scheduler.cancel(queued);
+    const char* integralStatus =
+        JobScheduler::statusName(scheduler.status(integral));
+    scheduler.cancel(busy);
+
+    JobScheduler::Result integralResult = scheduler.wait(integral);
+    JobScheduler::Result failingResult = scheduler.wait(failing);
+    std::cout << "Jobs: busy -> "
+        << JobScheduler::statusName(scheduler.wait(busy).status)
+        << ", queued cancelled " << (queuedCancelled ? "Yes" : "No")
+        << " -> " << JobScheduler::statusName(scheduler.wait(queued).status)
+        << ", integral was " << integralStatus << " -> "
+        << integralResult.value << " (expected 2), failing -> "
+        << JobScheduler::statusName(failingResult.status) << " ("
+        << failingResult.error << "), fetched job: "
+        << JobScheduler::statusName(scheduler.status(integral)) << std::endl;
+}
 
-        return
-            [arg](const std::unordered_map<std::string, double>& vars) -> double {
-            return std::sin(arg(vars));
-            };
+// Снимки: сохранение, восстановление через mmap, проверка целостности
+void reportSnapshot(int size) {
+    std::vector<double> matrix(static_cast<size_t>(size) * size);
+    for (size_t k = 0; k < matrix.size(); ++k) matrix[k] = std::cos(0.001 * k);
+    FakePackedArrayLink link(matrix, { size, size });
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<const BicubicInterpolator> original =
+        CreateInterpolatorOverLink(link);
+    auto created = std::chrono::high_resolution_clock::now();
+
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / "bicubic_snapshots";
+    const std::string path = (dir / "single.bcsnap").string();
+    std::filesystem::create_directories(dir);
+    SaveSnapshot(*original, path);
+
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    auto verified = LoadSnapshot(path);
+    auto loadVerified = std::chrono::high_resolution_clock::now();
+    auto mapped = LoadSnapshot(path, false);
+    auto loadMapped = std::chrono::high_resolution_clock::now();
+
+    const double x = 0.41 * size, y = 0.29 * size;
+    bool same = original->interpolate(x, y) == verified->interpolate(x, y) &&
+        original->interpolate(x, y) == mapped->interpolate(x, y);
+
+    // Порча одного байта данных обнаруживается по контрольной сумме
+    const std::string corrupt = (dir / "corrupt.bcsnap").string();
+    std::filesystem::copy_file(path, corrupt,
+        std::filesystem::copy_options::overwrite_existing);
+    {
+        std::fstream file(corrupt, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(SnapshotHeader) + 100);
+        file.put('\x7f');
     }
-
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileCos() const {
-        if (args.size() != 1) {
-            std::cerr << "Warning: Cos requires exactly 1 argument, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
-        }
-
-        auto arg = args[0]->compile();
-
-        return
-            [arg](const std::unordered_map<std::string, double>& vars) -> double {
-            return std::cos(arg(vars));
-            };
+    std::string corruptError = "not detected";
+    try {
+        LoadSnapshot(corrupt);
+    } catch (const std::exception& e) {
+        corruptError = e.what();
     }
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileTan() const {
-        if (args.size() != 1) {
-            std::cerr << "Warning: Tan requires exactly 1 argument, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
-        }
-
-        auto arg = args[0]->compile();
+    HandleRegistry<const BicubicInterpolator> registry, restored;
+    registry.insert(original);
+    int deleted = registry.insert(verified);
+    registry.insert(mapped);
+    registry.erase(deleted);
+    size_t saved = SaveAllSnapshots(registry, (dir / "all").string());
+    auto handles = RestoreAllSnapshots(restored, (dir / "all").string());
+
+    auto ms = [](auto a, auto b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    std::cout << "Snapshot " << size << "x" << size << ": create "
+        << ms(start, created) << " ms, restore with checksum "
+        << ms(loadStart, loadVerified) << " ms, mapped only "
+        << ms(loadVerified, loadMapped) << " ms (same value: "
+        << (same ? "Yes" : "No") << "), corrupted: " << corruptError
+        << ", saved " << saved << " restored " << handles.size()
+        << std::endl;
+}
 
-        return
-            [arg](const std::unordered_map<std::string, double>& vars) -> double {
-            return std::tan(arg(vars));
-            };
+// Стоимость инструментирования одного вызова и формат выгрузки
+void benchmarkMetrics(int n) {
+    std::vector<std::vector<double>> grid(64, std::vector<double>(64, 1.0));
+    BicubicInterpolator interpolator(grid);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    double plain = 0.0;
+    for (int i = 0; i < n; ++i)
+        plain += interpolator.interpolate(1.0 + (i % 60), 2.5);
+    auto middle = std::chrono::high_resolution_clock::now();
+    double measured = 0.0;
+    for (int i = 0; i < n; ++i) {
+        MetricsScope metrics(EntryPoint::Point, 7);
+        metrics.addPoints(1);
+        measured += interpolator.interpolate(1.0 + (i % 60), 2.5);
     }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    LatencyHistogram histogram;
+    for (std::uint64_t v = 1; v <= 100000; ++v) histogram.record(v);
+    const std::string text = Metrics::instance().prometheusText();
+
+    std::cout << "Metrics: plain "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / n
+        << " ns/call, instrumented "
+        << std::chrono::duration<double, std::nano>(stop - middle).count() / n
+        << " ns/call (sums equal: " << (plain == measured ? "Yes" : "No")
+        << "), p50 of 1..100000 = " << histogram.quantile(0.5)
+        << ", p99 = " << histogram.quantile(0.99) << ", exported "
+        << std::count(text.begin(), text.end(), '\n') << " lines" << std::endl;
+    std::cout << text.substr(0, text.find("# HELP bicubic_points_total"));
+}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileSqrt() const {
-        if (args.size() != 1) {
-            std::cerr << "Warning: Sqrt requires exactly 1 argument, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
-        }
-
-        auto arg = args[0]->compile();
+// Трассировка: стоимость интервала в выключенном и включенном состоянии,
+// выгрузка этапов интегрирования
+void reportTrace() {
+    const int n = 1000000;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n; ++i) TraceSpan span("empty");
+    auto middle = std::chrono::high_resolution_clock::now();
+    Tracer::setEnabled(true);
+    for (int i = 0; i < n; ++i) TraceSpan span("empty");
+    auto stop = std::chrono::high_resolution_clock::now();
+    Tracer::setEnabled(false);
+    Tracer::clear();
+
+    Tracer::setEnabled(true);
+    auto curve = MathematicaParser::parseCurveDerivativeBatchFunction(
+        "Plus[2, Cos[#]]&", "Plus[2, Sin[#]]&");
+    std::vector<std::vector<double>> ones(5, std::vector<double>(5, 1.0));
+    ParametricCurveIntegrator integrator(
+        std::make_shared<const BicubicInterpolator>(ones), curve);
+    integrator.integrateArcLength(0.0, 2 * std::acos(-1.0), 100000);
+    Tracer::setEnabled(false);
+
+    size_t events = 0;
+    const std::string json = Tracer::exportChrome(&events);
+    Tracer::clear();
+    std::cout << "Trace: span off "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / n
+        << " ns, on "
+        << std::chrono::duration<double, std::nano>(stop - middle).count() / n
+        << " ns; arc length run recorded " << events << " spans: "
+        << json.substr(0, 160) << "..." << std::endl;
+}
 
-        return
-            [arg](const std::unordered_map<std::string, double>& vars) -> double {
-            return std::sqrt(arg(vars));
-            };
+// Пирамида: наложение спектров при крупном шаге запросов и интеграл с
+// уточнением от грубых уровней
+void reportPyramid(int size) {
+    // Гладкая часть плюс высокочастотная рябь, которую крупный шаг не
+    // различает
+    std::vector<double> values(static_cast<size_t>(size) * size);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            values[static_cast<size_t>(y) * size + x] =
+                std::sin(x / 300.0) * std::cos(y / 200.0) +
+                0.3 * std::sin(2.9 * x) * std::sin(2.3 * y);
+        }
     }
-
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileExp() const {
-        if (args.size() != 1) {
-            std::cerr << "Warning: Exp requires exactly 1 argument, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
+    auto base = std::make_shared<const BicubicInterpolator>(
+        std::move(values), size, size);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InterpolatorPyramid pyramid(base);
+    auto built = std::chrono::high_resolution_clock::now();
+
+    // Запросы с шагом 16 узлов: ошибка относительно гладкой части
+    const double step = 16.0;
+    double baseError = 0.0, pyramidError = 0.0;
+    int queries = 0;
+    for (double y = 8.3; y < size - 16; y += step) {
+        for (double x = 8.7; x < size - 16; x += step) {
+            const double smooth = std::sin(x / 300.0) * std::cos(y / 200.0);
+            baseError += std::pow(base->interpolate(x, y) - smooth, 2);
+            pyramidError += std::pow(pyramid.interpolate(x, y, step) - smooth, 2);
+            ++queries;
         }
+    }
 
-        auto arg = args[0]->compile();
-
-        return
-            [arg](const std::unordered_map<std::string, double>& vars) -> double {
-            return std::exp(arg(vars));
-            };
+    // Окружность радиуса size / 3 вокруг центра
+    const double c = (size - 1) / 2.0, r = size / 3.0;
+    auto curve = MathematicaParser::parseCurveDerivativeBatchFunction(
+        "Plus[" + std::to_string(c) + ", Times[" + std::to_string(r) +
+            ", Cos[#]]]&",
+        "Plus[" + std::to_string(c) + ", Times[" + std::to_string(r) +
+            ", Sin[#]]]&");
+    CurveBatchFunc positions = [curve](const double* t, double* x, double* y,
+                                       size_t count) {
+        std::vector<double> dx(count), dy(count);
+        curve(t, x, y, dx.data(), dy.data(), count);
+    };
+    const double twoPi = 2 * std::acos(-1.0);
+    const int referenceNodes = 1 << 16;
+    auto referenceStart = std::chrono::high_resolution_clock::now();
+    const double reference = ParametricCurveIntegrator(base, curve)
+        .integrate(0.0, twoPi, referenceNodes);
+    auto adaptiveStart = std::chrono::high_resolution_clock::now();
+    size_t samples = 0;
+    const double adaptive =
+        pyramid.integrateCurve(positions, 0.0, twoPi, 1e-3, &samples);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    // Интеграл гладкой части поля, которую приближает пирамида
+    std::vector<double> smoothValues(referenceNodes + 1);
+    for (int i = 0; i <= referenceNodes; ++i) {
+        const double t = twoPi * i / referenceNodes;
+        smoothValues[i] = std::sin((c + r * std::cos(t)) / 300.0) *
+            std::cos((c + r * std::sin(t)) / 200.0);
     }
+    const double smoothIntegral = FunctionNIntegratorBySimpson::weightedSum(
+        smoothValues, twoPi / referenceNodes);
+
+    std::cout << "Pyramid " << size << "x" << size << ": "
+        << pyramid.levelCount() << " levels built in "
+        << std::chrono::duration<double, std::milli>(built - start).count()
+        << " ms; step " << step << " RMS error vs smooth field: base "
+        << std::sqrt(baseError / queries) << ", pyramid "
+        << std::sqrt(pyramidError / queries) << std::endl;
+    std::cout << "Pyramid curve integral: full grid " << reference << " ("
+        << referenceNodes + 1 << " points, "
+        << std::chrono::duration<double, std::milli>(
+               adaptiveStart - referenceStart).count()
+        << " ms), coarse-to-fine " << adaptive << " (" << samples
+        << " points, "
+        << std::chrono::duration<double, std::milli>(stop - adaptiveStart)
+               .count()
+        << " ms); smooth field " << smoothIntegral << ", difference: full grid "
+        << std::abs(reference - smoothIntegral) << ", coarse-to-fine "
+        << std::abs(adaptive - smoothIntegral) << std::endl;
+}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compileLog() const {
-        if (args.size() == 1) {
-            auto arg = args[0]->compile();
-            return
-                [arg](const std::unordered_map<std::string, double>& vars) -> double {
-                return std::log(arg(vars));
-                };
-        }
-        else if (args.size() == 2) {
-            auto base = args[0]->compile();
-            auto arg = args[1]->compile();
-            return
-                [base,
-                arg](const std::unordered_map<std::string, double>& vars) -> double {
-                return std::log(arg(vars)) / std::log(base(vars));
-                };
-        }
-        else {
-            std::cerr << "Warning: Log requires 1 or 2 arguments, but got "
-                << args.size() << std::endl;
-            return [](const std::unordered_map<std::string, double>&) -> double {
-                return 0.0;
-                };
+// Хранение плитками: память и задержка запросов по сравнению с плотной
+// сеткой
+void reportTiledGrid(int size) {
+    // Измерения с шагом 1/64 внутри круга, насыщенные сверху, и нулевой фон
+    std::vector<double> values(static_cast<size_t>(size) * size, 0.0);
+    const double c = size / 2.0, r = size / 3.0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (std::hypot(x - c, y - c) > r) continue;
+            const double v = 1.5 * std::sin(x / 150.0) * std::cos(y / 110.0);
+            values[static_cast<size_t>(y) * size + x] =
+                std::round(std::min(v, 1.0) * 64.0) / 64.0;
         }
     }
-};
-
-// Lambda-функция (например, Sin[#]&)
-class Lambda : public Expression {
-private:
-    std::shared_ptr<Expression> body;
-
-public:
-    explicit Lambda(std::shared_ptr<Expression> b) : body(std::move(b)) {}
 
-    std::function<double(const std::unordered_map<std::string, double>&)>
-        compile() const override {
-        auto compiledBody = body->compile();
-
-        return [compiledBody](
-            const std::unordered_map<std::string, double>& vars) -> double {
-                return compiledBody(vars);
-            };
+    auto dense = std::make_shared<const BicubicInterpolator>(values, size, size);
+    auto start = std::chrono::high_resolution_clock::now();
+    auto plainTiles = std::make_shared<const TiledGrid>(values.data(), size, size, false);
+    auto middle = std::chrono::high_resolution_clock::now();
+    auto packedTiles = std::make_shared<const TiledGrid>(values.data(), size, size, true);
+    auto built = std::chrono::high_resolution_clock::now();
+    BicubicInterpolator tiled(plainTiles), packed(packedTiles);
+
+    const int n = 1000000;
+    std::vector<double> xy(2 * n);
+    unsigned state = 12345;
+    for (double& v : xy) {
+        state = state * 1664525u + 1013904223u;
+        v = (state >> 8) * (size - 1.5) / double(1u << 24);
     }
-
-    // Создаем функцию одной переменной
-    std::function<double(double)> compileUnary() const {
-        auto compiledBody = body->compile();
-
-        return [compiledBody](double x) -> double {
-            // Создаем карту с "#" в качестве ключа для лямбда-параметра
-            std::unordered_map<std::string, double> vars = { {"#", x} };
-            return compiledBody(vars);
-            };
+    auto timeQueries = [&](const BicubicInterpolator& interpolator, double& sum) {
+        auto begin = std::chrono::high_resolution_clock::now();
+        sum = 0.0;
+        for (int i = 0; i < n; ++i) {
+            sum += interpolator.interpolate(xy[2 * i], xy[2 * i + 1]);
+        }
+        return std::chrono::duration<double, std::nano>(
+            std::chrono::high_resolution_clock::now() - begin).count() / n;
+    };
+    double denseSum, tiledSum, packedSum;
+    const double denseNs = timeQueries(*dense, denseSum);
+    const double tiledNs = timeQueries(tiled, tiledSum);
+    const double packedNs = timeQueries(packed, packedSum);
+
+    // Обход по строкам с шагом 0.37, как при построении изображения
+    for (int i = 0; i < n; ++i) {
+        const double t = i * 0.37;
+        xy[2 * i] = std::fmod(t, size - 1.5);
+        xy[2 * i + 1] = 1000.0 + std::floor(t / (size - 1.5)) * 0.37;
     }
+    double denseScanSum, tiledScanSum, packedScanSum;
+    const double denseScanNs = timeQueries(*dense, denseScanSum);
+    const double tiledScanNs = timeQueries(tiled, tiledScanSum);
+    const double packedScanNs = timeQueries(packed, packedScanSum);
+
+    std::cout << "Tiled grid " << size << "x" << size << ": "
+        << packedTiles->tileCount(TiledGrid::TileKind::Uniform) << " uniform, "
+        << packedTiles->tileCount(TiledGrid::TileKind::Compressed)
+        << " compressed, " << packedTiles->tileCount(TiledGrid::TileKind::Raw)
+        << " raw tiles; memory dense " << dense->residentBytes() / 1048576.0
+        << " MB, tiled " << tiled.residentBytes() / 1048576.0
+        << " MB, compressed " << packed.residentBytes() / 1048576.0
+        << " MB (built in "
+        << std::chrono::duration<double, std::milli>(middle - start).count()
+        << " / "
+        << std::chrono::duration<double, std::milli>(built - middle).count()
+        << " ms)" << std::endl;
+    // Полная распаковка, как в SaveSnapshot, CreatePyramid и SetGridValues
+    auto decodeStart = std::chrono::high_resolution_clock::now();
+    const std::shared_ptr<const double> tiledValues = tiled.denseData();
+    auto decodeMiddle = std::chrono::high_resolution_clock::now();
+    const std::shared_ptr<const double> packedValues = packed.denseData();
+    auto decodeStop = std::chrono::high_resolution_clock::now();
+    const bool decodedExact =
+        std::equal(values.begin(), values.end(), tiledValues.get()) &&
+        std::equal(values.begin(), values.end(), packedValues.get());
+
+    std::cout << "Tiled grid decode: tiled "
+        << std::chrono::duration<double, std::milli>(decodeMiddle - decodeStart).count()
+        << " ms, compressed "
+        << std::chrono::duration<double, std::milli>(decodeStop - decodeMiddle).count()
+        << " ms, exact " << (decodedExact ? "Yes" : "No") << std::endl;
+    std::cout << "Tiled grid random query: dense " << denseNs << " ns, tiled "
+        << tiledNs << " ns, compressed " << packedNs
+        << " ns; row scan: dense " << denseScanNs << " ns, tiled "
+        << tiledScanNs << " ns, compressed " << packedScanNs
+        << " ns; results identical: "
+        << (denseSum == tiledSum && denseSum == packedSum &&
+            denseScanSum == tiledScanSum && denseScanSum == packedScanSum
+                ? "Yes" : "No")
+        << std::endl;
+}
 
-    std::string toString() const override { return body->toString() + "&"; }
-};
-
-class MathematicaParser {
-private:
-    std::string input;
-    size_t pos = 0;
-
-    char peek() const {
-        if (pos >= input.size()) return '\0';
-        return input[pos];
+// Многомерная интерполяция: D = 2 против BicubicInterpolator, D = 3 против
+// прежнего способа (срезы по z и одномерная кубическая интерполяция), D = 4
+// через ссылку
+void reportTensorInterpolator() {
+    const int n = 200000;
+    unsigned state = 777;
+    auto next = [&state](double scale) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * scale / double(1u << 24);
+    };
+
+    const int size = 512;
+    std::vector<double> plane(static_cast<size_t>(size) * size);
+    for (size_t i = 0; i < plane.size(); ++i) plane[i] = std::sin(0.001 * i);
+    BicubicInterpolator bicubic(plane, size, size);
+    TensorInterpolator<2> tensor2(plane, { size, size });
+    double maxDiff2 = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double p[2] = { next(size - 1), next(size - 1) };
+        maxDiff2 = std::max(maxDiff2, std::abs(tensor2.interpolate(p) -
+                                               bicubic.interpolate(p[0], p[1])));
     }
 
-    char consume() {
-        if (pos >= input.size()) return '\0';
-        return input[pos++];
+    const int depth = 128;
+    std::vector<double> volume(static_cast<size_t>(depth) * depth * depth);
+    for (int z = 0; z < depth; ++z)
+        for (int y = 0; y < depth; ++y)
+            for (int x = 0; x < depth; ++x)
+                volume[(static_cast<size_t>(z) * depth + y) * depth + x] =
+                    std::sin(x / 9.0) * std::cos(y / 7.0) + std::sin(z / 5.0);
+    TensorInterpolator<3> tensor3(volume, { depth, depth, depth });
+    std::vector<BicubicInterpolator> slices;
+    for (int z = 0; z < depth; ++z) {
+        slices.emplace_back(std::vector<double>(
+            volume.begin() + static_cast<size_t>(z) * depth * depth,
+            volume.begin() + static_cast<size_t>(z + 1) * depth * depth),
+            depth, depth);
     }
-
-    void skipWhitespace() {
-        while (pos < input.size() && std::isspace(input[pos])) {
-            ++pos;
+    std::vector<double> points(3 * static_cast<size_t>(n));
+    for (double& v : points) v = 1.0 + next(depth - 4);
+
+    std::vector<double> tricubic(n), sliced(n);
+    auto start = std::chrono::high_resolution_clock::now();
+    tensor3.interpolateBatch(points.data(), tricubic.data(), n);
+    auto middle = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n; ++i) {
+        const double* p = &points[3 * i];
+        const int z0 = static_cast<int>(p[2]);
+        double column[4];
+        for (int k = 0; k < 4; ++k) {
+            column[k] = slices[z0 - 1 + k].interpolate(p[0], p[1]);
         }
+        sliced[i] = catmullRom(column, p[2] - z0);
     }
-
-    bool consumeIf(char c) {
-        skipWhitespace();
-        if (peek() == c) {
-            consume();
-            return true;
-        }
-        return false;
+    auto stop = std::chrono::high_resolution_clock::now();
+    double maxDiff3 = 0.0;
+    for (int i = 0; i < n; ++i) {
+        maxDiff3 = std::max(maxDiff3, std::abs(tricubic[i] - sliced[i]));
     }
 
-    bool isIdentifierChar(char c) {
-        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
-    }
+    // Линейная функция в 4D воспроизводится точно; массив — как из Mathematica
+    const int dims4[4] = { 6, 7, 8, 9 };
+    std::vector<double> array4;
+    for (int i = 0; i < dims4[0]; ++i)
+        for (int j = 0; j < dims4[1]; ++j)
+            for (int k = 0; k < dims4[2]; ++k)
+                for (int l = 0; l < dims4[3]; ++l)
+                    array4.push_back(i + 2.0 * j - k + 0.5 * l);
+    FakePackedArrayLink createLink(array4, { 6, 7, 8, 9 });
+    auto grid4 = CreateTensorGridOverLink(createLink);
+    FakePackedArrayLink queryLink({ 1.5, 2.25, 3.75, 4.5, 2.0, 3.0, 4.0, 5.0 },
+                                  { 2, 4 });
+    InterpolateTensorListOverLink(queryLink, *grid4);
+    const double error4 =
+        std::abs(queryLink.output()[0] - (1.5 + 4.5 - 3.75 + 2.25)) +
+        std::abs(queryLink.output()[1] - (2.0 + 6.0 - 4.0 + 2.5));
+
+    std::cout << "Tensor interpolator: D=2 max diff vs bicubic " << maxDiff2
+        << "; D=3 " << n << " points "
+        << std::chrono::duration<double, std::milli>(middle - start).count()
+        << " ms vs slices " << std::chrono::duration<double, std::milli>(
+               stop - middle).count()
+        << " ms, max diff " << maxDiff3 << "; D=4 linear error " << error4
+        << std::endl;
+}
 
-    std::string parseIdentifier() {
-        skipWhitespace();
-        // Если встречаем разделитель, сигнализируем об ошибке или возвращаем
-        // специальное значение
-        char c = peek();
-        if (c == ']' || c == ',' || c == '&') {
-            throw std::runtime_error(
-                "Unexpected delimiter when expecting identifier at position " +
-                std::to_string(pos));
-        }
+// Ядра интерполяции: точность на гладком поле, выбросы на ступеньке,
+// стоимость префильтра и пакетной интерполяции
+void reportCubicKernels(int size) {
+    std::vector<double> field(static_cast<size_t>(size) * size);
+    auto exact = [](double x, double y) {
+        return std::sin(x / 7.0) * std::cos(y / 5.0);
+    };
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            field[static_cast<size_t>(y) * size + x] = exact(x, y);
+
+    const int n = 1000000;
+    // Точки не ближе 16 узлов к краю: у края B-сплайн искажается
+    // граничным условием (повтор крайних узлов)
+    std::vector<double> xy(2 * n);
+    unsigned state = 4242;
+    for (double& v : xy) {
+        state = state * 1664525u + 1013904223u;
+        v = 16.0 + (state >> 8) * (size - 33.0) / double(1u << 24);
+    }
 
-        // Если первый символ – '#' (лямбда-параметр), сразу возвращаем его
-        if (c == '#') {
-            consume();
-            return "#";
+    // Ступенька: ядро Катмулла-Рома выходит за [0, 1], монотонное — нет
+    std::vector<double> step(64 * 64);
+    for (int y = 0; y < 64; ++y)
+        for (int x = 0; x < 64; ++x) step[y * 64 + x] = x < 32 ? 0.0 : 1.0;
+
+    std::cout << "Cubic kernels " << size << "x" << size << ":";
+    for (CubicKernelType kernel :
+         { CubicKernelType::CatmullRom, CubicKernelType::BSpline,
+           CubicKernelType::MonotoneHermite }) {
+        auto start = std::chrono::high_resolution_clock::now();
+        BicubicInterpolator interpolator(field, size, size, kernel);
+        auto built = std::chrono::high_resolution_clock::now();
+        std::vector<double> out(n);
+        interpolator.interpolateBatch(xy.data(), out.data(), n);
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        double maxError = 0.0, nodeError = 0.0;
+        for (int i = 0; i < n; ++i) {
+            maxError = std::max(maxError,
+                                std::abs(out[i] - exact(xy[2 * i], xy[2 * i + 1])));
         }
-
-        std::string result;
-        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
-            result += consume();
-            while (true) {
-                c = peek();
-                // Разрешаем только буквы, цифры и '_'
-                if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
-                    result += consume();
-                }
-                else {
-                    break;
-                }
-            }
+        for (int i = 0; i < 1000; ++i) {
+            const int x = 2 + (i * 37) % (size - 5), y = 2 + (i * 91) % (size - 5);
+            nodeError = std::max(nodeError, std::abs(
+                interpolator.interpolate(x, y) - exact(x, y)));
         }
-        else {
-            throw std::runtime_error(
-                "Unexpected character when expecting identifier: " +
-                std::string(1, c));
+        BicubicInterpolator stepInterpolator(step, 64, 64, kernel);
+        double lowest = 0.0, highest = 1.0;
+        for (double x = 28.0; x < 36.0; x += 0.01) {
+            const double v = stepInterpolator.interpolate(x, 10.5);
+            lowest = std::min(lowest, v);
+            highest = std::max(highest, v);
         }
-        return result;
+
+        std::cout << "\n  " << CubicKernelName(kernel) << ": build "
+            << std::chrono::duration<double, std::milli>(built - start).count()
+            << " ms, batch "
+            << std::chrono::duration<double, std::nano>(stop - built).count() / n
+            << " ns/point, max error " << maxError << ", at nodes "
+            << nodeError << ", step range [" << lowest << ", " << highest << "]";
     }
 
-    double parseNumber() {
-        skipWhitespace();
-        std::string numStr;
-        bool hasDecimal = false;
-        bool hasExponent = false;
+    // Тензорный интерполятор с тем же ядром: узлы воспроизводятся точно
+    const int depth = 24;
+    std::vector<double> volume(depth * depth * depth);
+    for (size_t i = 0; i < volume.size(); ++i) volume[i] = std::sin(0.37 * i);
+    TensorInterpolator<3, BSplineKernel> spline(volume, { depth, depth, depth });
+    double volumeError = 0.0;
+    for (int i = 0; i < 500; ++i) {
+        const int x = 1 + i % 21, y = 1 + (i / 3) % 21, z = 1 + (i / 7) % 21;
+        const double p[3] = { double(x), double(y), double(z) };
+        volumeError = std::max(volumeError, std::abs(spline.interpolate(p) -
+            volume[(static_cast<size_t>(z) * depth + y) * depth + x]));
+    }
+    std::cout << "\n  Tricubic B-spline error at nodes " << volumeError
+        << std::endl;
+}
 
-        if (peek() == '-') {
-            numStr += consume();
+// Экстремум и линия уровня по дереву оценок против плотной выборки
+void reportBoundHierarchy(int size) {
+    std::vector<double> field(static_cast<size_t>(size) * size);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x) {
+            const double dx = x - 0.61 * size, dy = y - 0.37 * size;
+            field[static_cast<size_t>(y) * size + x] =
+                std::exp(-(dx * dx + dy * dy) / (0.02 * size * size)) +
+                0.05 * std::sin(x / 9.0) * std::cos(y / 13.0);
         }
 
-        while (true) {
-            char c = peek();
-            if (std::isdigit(c) || (!hasDecimal && c == '.') ||
-                (!hasExponent && (c == 'e' || c == 'E'))) {
-                if (c == '.') hasDecimal = true;
-                if (c == 'e' || c == 'E') hasExponent = true;
-                numStr += consume();
-            }
-            else {
-                break;
-            }
-        }
+    for (CubicKernelType kernel :
+         { CubicKernelType::CatmullRom, CubicKernelType::MonotoneHermite }) {
+        auto interpolator =
+            std::make_shared<const BicubicInterpolator>(field, size, size, kernel);
+        auto start = std::chrono::high_resolution_clock::now();
+        BoundHierarchy bounds(interpolator);
+        auto built = std::chrono::high_resolution_clock::now();
+        const BoundHierarchy::Extremum top = bounds.maximum(1e-9);
+        auto searched = std::chrono::high_resolution_clock::now();
+
+        // Плотная выборка с шагом в полячейки
+        double sampled = -std::numeric_limits<double>::infinity();
+        for (double y = 0.0; y < size - 1; y += 0.5)
+            for (double x = 0.0; x < size - 1; x += 0.5)
+                sampled = std::max(sampled, interpolator->interpolate(x, y));
+        auto scanned = std::chrono::high_resolution_clock::now();
+
+        size_t visited = 0;
+        const auto contour = bounds.levelSetCells(0.5, &visited);
+        auto contoured = std::chrono::high_resolution_clock::now();
+        size_t thresholdVisited = 0, whole = 0;
+        for (const auto& range : bounds.thresholdCells(0.5, &thresholdVisited))
+            if (!range.partial)
+                whole += size_t(range.x1 - range.x0) * (range.y1 - range.y0);
+
+        std::cout << "Bound hierarchy " << size << "x" << size << " "
+            << CubicKernelName(kernel) << ": build "
+            << std::chrono::duration<double, std::milli>(built - start).count()
+            << " ms, " << bounds.memoryBytes() / 1024 << " KB"
+            << "\n  maximum " << top.value << " at (" << top.x << ", " << top.y
+            << "), bound gap " << top.bound - top.value << ", "
+            << top.visited << " steps, "
+            << std::chrono::duration<double, std::micro>(searched - built).count()
+            << " us; dense scan " << sampled << " in "
+            << std::chrono::duration<double, std::milli>(scanned - searched).count()
+            << " ms"
+            << "\n  level 0.5: " << contour.size() << " cells, " << visited
+            << " visited of " << size_t(size - 1) * (size - 1) << ", "
+            << std::chrono::duration<double, std::micro>(contoured - scanned).count()
+            << " us; threshold: " << whole << " cells whole, "
+            << thresholdVisited << " visited" << std::endl;
+    }
+}
 
-        if (numStr.empty() || numStr == "-" || numStr == ".") {
-            throw std::runtime_error("Invalid number format");
-        }
+// Точки вдоль пути: курсор с окрестностью ячейки против interpolate
+void reportPathCursor(int size) {
+    std::vector<double> field(static_cast<size_t>(size) * size);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            field[static_cast<size_t>(y) * size + x] =
+                std::sin(x / 11.0) * std::cos(y / 17.0);
+
+    // Спираль с шагом около 0.1 ячейки
+    const int n = 2000000;
+    std::vector<double> path(2 * n);
+    for (int i = 0; i < n; ++i) {
+        const double t = 0.05 + 0.95 * i / double(n);
+        const double angle = 0.2 * std::sqrt(double(i));
+        path[2 * i] = 0.5 * size + 0.45 * size * t * std::cos(angle);
+        path[2 * i + 1] = 0.5 * size + 0.45 * size * t * std::sin(angle);
+    }
 
-        return std::stod(numStr);
+    std::cout << "Path cursor " << size << "x" << size << ", " << n
+              << " points:";
+    for (bool tiled : { false, true }) {
+        auto dense = std::make_shared<const BicubicInterpolator>(field, size, size);
+        std::shared_ptr<const BicubicInterpolator> interpolator = dense;
+        if (tiled)
+            interpolator = std::make_shared<const BicubicInterpolator>(
+                std::make_shared<const TiledGrid>(dense->data(), size, size, true));
+
+        std::vector<double> pointwise(n), cursorValues(n);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < n; ++i)
+            pointwise[i] = interpolator->interpolate(path[2 * i], path[2 * i + 1]);
+        auto middle = std::chrono::high_resolution_clock::now();
+        InterpolatorCursor cursor(*interpolator);
+        cursor.interpolateBatch(path.data(), cursorValues.data(), n);
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        double maxDiff = 0.0;
+        for (int i = 0; i < n; ++i)
+            maxDiff = std::max(maxDiff, std::abs(pointwise[i] - cursorValues[i]));
+        std::cout << "\n  " << (tiled ? "compressed tiles" : "dense") << ": interpolate "
+            << std::chrono::duration<double, std::nano>(middle - start).count() / n
+            << " ns/point, cursor "
+            << std::chrono::duration<double, std::nano>(stop - middle).count() / n
+            << " ns/point (" << cursor.hits() << " hits, " << cursor.shifts()
+            << " shifts, " << cursor.fullLoads() << " loads), max diff " << maxDiff;
     }
 
-public:
-    explicit MathematicaParser(std::string in) : input(std::move(in)) {}
+    // Интеграл вдоль кривой: узлы Симпсона идут по порядку
+    auto interpolator = std::make_shared<const BicubicInterpolator>(field, size, size);
+    CurveBatchFunc circle = [size](const double* t, double* x, double* y, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            x[i] = 0.5 * size + 0.4 * size * std::cos(t[i]);
+            y[i] = 0.5 * size + 0.4 * size * std::sin(t[i]);
+        }
+    };
+    ParametricCurveIntegrator integrator(interpolator, circle);
+    auto start = std::chrono::high_resolution_clock::now();
+    const double integral = integrator.integrate(0.0, 6.283185307179586, 1000000);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "\n  Curve integral " << integral << " with 10^6 intervals in "
+        << std::chrono::duration<double, std::milli>(stop - start).count() << " ms"
+        << std::endl;
+}
 
-    std::shared_ptr<Expression> parse() {
-        skipWhitespace();
-        auto expr = parseExpression();
-        skipWhitespace();
+// Варианты ядер по наборам инструкций и строгий режим
+void reportCpuDispatch(int size) {
+    std::vector<double> field(static_cast<size_t>(size) * size);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            field[static_cast<size_t>(y) * size + x] =
+                std::sin(x / 7.0) * std::cos(y / 5.0);
+    BicubicInterpolator interpolator(field, size, size);
+
+    // Точки вдоль строк: почти все попадают в уже загруженную ячейку
+    const int n = 2000000;
+    std::vector<double> xy(2 * n);
+    for (int i = 0; i < n; ++i) {
+        xy[2 * i] = 1.0 + (size - 3.0) * (i % 4096) / 4096.0;
+        xy[2 * i + 1] = 1.0 + (size - 3.0) * (i / 4096) / (n / 4096.0);
+    }
+    std::vector<double> samples(4000001);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = std::sin(1e-5 * i);
+
+    const IsaLevel initial = CpuDispatch::active();
+    std::cout << "CPU dispatch: detected " << CpuDispatch::isaName(CpuDispatch::detected())
+              << ", active " << CpuDispatch::variantName();
+
+    std::vector<double> reference(n), out(n);
+    CpuDispatch::setStrict(true);
+    interpolator.interpolateBatch(xy.data(), reference.data(), n);
+    const double strictSum = FunctionNIntegratorBySimpson::weightedSum(samples, 1e-5);
+    for (int variant = -1; variant <= static_cast<int>(CpuDispatch::detected()); ++variant) {
+        CpuDispatch::setStrict(variant < 0);
+        if (variant >= 0) CpuDispatch::select(static_cast<IsaLevel>(variant));
+
+        auto start = std::chrono::high_resolution_clock::now();
+        interpolator.interpolateBatch(xy.data(), out.data(), n);
+        auto middle = std::chrono::high_resolution_clock::now();
+        double sum = 0.0;
+        for (int repeat = 0; repeat < 10; ++repeat)
+            sum = FunctionNIntegratorBySimpson::weightedSum(samples, 1e-5);
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        double maxDiff = 0.0;
+        for (int i = 0; i < n; ++i)
+            maxDiff = std::max(maxDiff, std::abs(out[i] - reference[i]));
+        std::cout << "\n  " << CpuDispatch::variantName() << ": batch "
+            << std::chrono::duration<double, std::nano>(middle - start).count() / n
+            << " ns/point (max diff from strict " << maxDiff << "), Simpson sum "
+            << std::chrono::duration<double, std::micro>(stop - middle).count() / 10
+            << " us (diff from strict " << sum - strictSum << ")";
+    }
+    CpuDispatch::setStrict(false);
+    CpuDispatch::select(initial);
+    std::cout << std::endl;
+}
 
-        // Проверка на лямбда-функцию (например, Sin[#]&)
-        if (consumeIf('&')) {
-            return std::make_shared<Lambda>(expr);
+// Поток кадров: писатель добавляет кадры, читатели одновременно запрашивают
+void reportSpaceTime(int size, size_t capacity) {
+    auto field = [](double x, double y, double t) {
+        return std::sin(x / 9.0 + 0.7 * t) * std::cos(y / 13.0 - 0.3 * t);
+    };
+    SpaceTimeInterpolator stack(size, size, capacity);
+    const double step = 0.25;
+    const int frames = 400;
+
+    std::vector<std::vector<double>> source(8, std::vector<double>(size_t(size) * size));
+    for (int k = 0; k < 8; ++k)
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                source[k][size_t(y) * size + x] = field(x, y, k * step);
+    for (int k = 0; k < 8; ++k) stack.push(k * step, source[k].data());
+
+    std::atomic<bool> done{ false };
+    std::atomic<std::uint64_t> queries{ 0 };
+    std::atomic<double> worst{ 0.0 };
+    auto reader = [&](unsigned seed) {
+        std::uint64_t count = 0;
+        double maxError = 0.0;
+        while (!done.load()) {
+            double first, last;
+            if (!stack.timeRange(first, last)) continue;
+            seed = seed * 1664525u + 1013904223u;
+            const double x = 2.0 + (seed >> 8) * (size - 5.0) / double(1u << 24);
+            seed = seed * 1664525u + 1013904223u;
+            const double y = 2.0 + (seed >> 8) * (size - 5.0) / double(1u << 24);
+            // Время внутри окна с запасом в 4 кадра на его сдвиг писателем
+            const double t = first + 4 * step + (last - first - 5 * step) * (seed & 1023) / 1024.0;
+            const double value = stack.interpolate(x, y, t);
+            // Ошибка учитывается, только если окно за это время не ушло от t
+            double range0, range1;
+            if (stack.timeRange(range0, range1) && range0 <= first)
+                maxError = std::max(maxError, std::abs(value - field(x, y, t)));
+            ++count;
         }
+        queries += count;
+        double current = worst.load();
+        while (maxError > current && !worst.compare_exchange_weak(current, maxError)) {}
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::thread readers[2] = { std::thread(reader, 7u), std::thread(reader, 11u) };
+    std::vector<double> frame(size_t(size) * size);
+    double pushSeconds = 0.0;
+    for (int k = 8; k < frames; ++k) {
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                frame[size_t(y) * size + x] = field(x, y, k * step);
+        auto before = std::chrono::high_resolution_clock::now();
+        stack.push(k * step, frame.data());
+        pushSeconds += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - before).count();
+        // Кадры приходят с паузами, как от реального источника
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    done = true;
+    for (auto& thread : readers) thread.join();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double first, last;
+    stack.timeRange(first, last);
+    std::cout << "Space-time frames " << size << "x" << size << ", window "
+        << capacity << ": " << stack.framesPushed() << " frames pushed, "
+        << pushSeconds * 1e6 / (frames - 8) << " us/push, " << queries.load()
+        << " concurrent queries in "
+        << std::chrono::duration<double, std::milli>(stop - start).count()
+        << " ms, " << stack.readRetries() << " retries, window t = [" << first
+        << ", " << last << "], max error " << worst.load() << std::endl;
+}
+
+// Повторное создание интерполятора по той же матрице: общая сетка вместо
+// копии, учет сэкономленных байт и копирование при изменении
+void reportGridStore(int size) {
+    std::vector<double> matrix(static_cast<size_t>(size) * size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            matrix[size_t(i) * size + j] = std::sin(0.01 * i) * std::cos(0.02 * j);
+    GridStore& store = GridStore::instance();
+    const std::uint64_t savedBefore = store.bytesSaved();
+    HandleRegistry<const BicubicInterpolator> registry;
+
+    auto create = [&](CubicKernelType kernel) {
+        FakePackedArrayLink link(matrix, { size, size });
+        std::shared_ptr<const BicubicInterpolator> created =
+            CreateInterpolatorOverLink(link, kernel);
+        return registry.insert(store.intern(std::move(created)));
+    };
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<int> handles;
+    for (int k = 0; k < 4; ++k) handles.push_back(create(CubicKernelType::CatmullRom));
+    auto middle = std::chrono::high_resolution_clock::now();
+    // Другое ядро — другая сетка; повтор B-сплайна разделяет коэффициенты
+    const int spline = create(CubicKernelType::BSpline);
+    const int splineCopy = create(CubicKernelType::BSpline);
+    const std::uint64_t saved = store.bytesSaved() - savedBefore;
+
+    auto first = registry.find(handles[0]);
+    auto second = registry.find(handles[1]);
+    const bool shared = first->data() == second->data() &&
+        registry.find(spline)->data() == registry.find(splineCopy)->data() &&
+        first->data() != registry.find(spline)->data();
+
+    // Копирование при записи: меняется только сетка handles[1]
+    const double x = 100.0, y = 200.0;
+    const double before = first->interpolate(x, y);
+    const double update[3] = { x, y, 5.0 };
+    registry.replace(handles[1], store.intern(UpdateGridValues(*second, update, 1)));
+    const double untouched = registry.find(handles[0])->interpolate(x, y);
+    const double changed = registry.find(handles[1])->interpolate(x, y);
+    second.reset();
+    const std::uint64_t savedAfterUpdate = store.bytesSaved() - savedBefore;
+
+    first.reset();
+    for (int handle : handles) registry.erase(handle);
+    registry.erase(spline);
+    registry.erase(splineCopy);
+
+    std::cout << "Grid store " << size << "x" << size << ": 4 identical grids in "
+        << std::chrono::duration<double, std::milli>(middle - start).count()
+        << " ms, shared " << shared << ", saved " << saved / 1048576.0
+        << " MB (" << savedAfterUpdate / 1048576.0 << " MB after update); update "
+        << before << " -> " << changed << ", other handle " << untouched
+        << "; after delete saved " << store.bytesSaved() - savedBefore
+        << " bytes, hits " << store.hits() << std::endl;
+}
 
-        return expr;
+// Сервер в общей памяти против пути через ссылку: задержка одного вызова и
+// пропускная способность пакетов. Клиент работает в дочернем процессе
+void reportSharedMemoryIpc(int size) {
+#ifdef __linux__
+    std::vector<std::vector<double>> grid(size, std::vector<double>(size));
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            grid[i][j] = std::sin(0.01 * i) * std::cos(0.013 * j);
+    HandleRegistry<const BicubicInterpolator> registry;
+    const int handle = registry.insert(std::make_shared<BicubicInterpolator>(grid));
+    auto interpolator = registry.find(handle);
+
+    const size_t batch = 1 << 16;
+    std::vector<double> points(2 * batch);
+    unsigned seed = 5;
+    for (double& value : points) {
+        seed = seed * 1664525u + 1013904223u;
+        value = 1.0 + (seed >> 8) * (size - 3.0) / double(1u << 24);
     }
+    const int calls = 20000;
+    const int batches = 100;
+    auto median = [](std::vector<double>& samples) {
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+            samples.end());
+        return samples[samples.size() / 2];
+    };
+
+    const std::string name = "/bicubic-bench-" + std::to_string(getpid());
+    SharedMemoryServer server(name,
+        [&registry](int h) { return registry.find(h); }, 8, batch);
+    std::cout.flush();
+    const pid_t child = fork();
+    if (child == 0) {
+        int code = 0;
+        try {
+            SharedMemoryClient client(name);
+            std::vector<double> samples(calls);
+            double one = 0.0;
+            for (int i = 0; i < calls; ++i) {
+                auto before = std::chrono::steady_clock::now();
+                client.interpolate(handle, &points[2 * (i % batch)], &one, 1);
+                samples[i] = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - before).count();
+            }
 
-    std::shared_ptr<Expression> parseExpression() {
-        skipWhitespace();
-        // Если следующий символ является разделителем, то ничего читать не надо
-        char c = peek();
-        if (c == ']' || c == ',' || c == '&') {
-            throw std::runtime_error(
-                "Unexpected delimiter when expecting an expression at position " +
-                std::to_string(pos));
-        }
-        // Если константа
-        if (std::isdigit(c) || c == '-' || c == '.') {
-            return std::make_shared<Constant>(parseNumber());
-        }
-        // Проверяем что мдет дальше (функция или переменна)
-        std::string identifier = parseIdentifier();
-        if (identifier.empty()) {
-            throw std::runtime_error("Expected identifier or number at position " +
-                std::to_string(pos));
-        }
-        // Если за идентификатором следует открывающая скобка – это функция
-        if (consumeIf('[')) {
-            std::vector<std::shared_ptr<Expression>> args;
-            skipWhitespace();
-            // Если сразу закрывающая скобка – аргументов нет
-            if (peek() != ']') {
-                // Первый аргумент
-                args.push_back(parseExpression());
-                while (true) {
-                    skipWhitespace();
-                    // Если следующий символ – закрывающая скобка, выходим из цикла
-                    if (peek() == ']') {
-                        break;
-                    }
-                    // Если запятая – пропускаем её и парсим следующий аргумент
-                    if (consumeIf(',')) {
-                        skipWhitespace();
-                        // Если после запятой сразу закрывающая скобка, значит аргумент
-                        // отсутствует
-                        if (peek() == ']') {
-                            break;  // либо можно бросить исключение, если это считать ошибкой
-                        }
-                        args.push_back(parseExpression());
-                    }
-                    else {
-                        throw std::runtime_error("Expected ',' or ']' at position " +
-                            std::to_string(pos));
-                    }
+            // Без копирования: точки пишутся прямо в слот, ответ читается из него
+            double maxDiff = 0.0;
+            auto start = std::chrono::steady_clock::now();
+            for (int k = 0; k < batches; ++k) {
+                SharedMemoryClient::Slot slot = client.acquire();
+                std::copy(points.begin(), points.end(), slot.points);
+                client.evaluate(slot, handle, batch);
+                if (k == 0) {
+                    for (size_t i = 0; i < batch; ++i)
+                        maxDiff = std::max(maxDiff, std::abs(slot.results[i] -
+                            interpolator->interpolate(points[2 * i], points[2 * i + 1])));
                 }
+                client.release(slot);
             }
-            if (!consumeIf(']')) {
-                throw std::runtime_error("Expected closing bracket at position " +
-                    std::to_string(pos));
-            }
-            // Специальная обработка для Rational
-            if (identifier == "Rational" && args.size() == 2) {
-                auto numExpr = std::dynamic_pointer_cast<Constant>(args[0]);
-                auto denomExpr = std::dynamic_pointer_cast<Constant>(args[1]);
-                if (numExpr && denomExpr) {
-                    int num = static_cast<int>(numExpr->compile()({}));
-                    int denom = static_cast<int>(denomExpr->compile()({}));
-                    return std::make_shared<Rational>(num, denom);
-                }
+            const double zeroCopy = std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start).count() / (batches * batch);
+
+            std::string message;
+            try {
+                client.interpolate(handle + 1, points.data(), &one, 1);
+            } catch (const std::invalid_argument& e) {
+                message = e.what();
             }
-            return std::make_shared<Function>(identifier, args);
+            std::cout << "Shared-memory IPC " << size << "x" << size
+                << ": round trip median " << median(samples) << " ns, batch of "
+                << batch << " " << zeroCopy << " ns/point (max diff " << maxDiff
+                << "), unknown handle -> \"" << message << "\"" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Shared-memory client: " << e.what() << std::endl;
+            code = 1;
         }
-        // Иначе – переменная
-        return std::make_shared<Variable>(identifier);
+        std::cout.flush();
+        _exit(code);
     }
-
-    // Метод для преобразования строки FullForm в std::function
-    static std::function<double(double)> parseFunction(
-        const std::string& fullFormStr) {
-        MathematicaParser parser(fullFormStr);
-        auto expr = parser.parse();
-
-        // Если это лямбда, то возвращаем функцию одной переменной
-        if (auto lambda = std::dynamic_pointer_cast<Lambda>(expr)) {
-            return lambda->compileUnary();
-        }
-
-        // Иначе предполагаем, что есть одна переменная 'x'
-        auto compiled = expr->compile();
-        return [compiled](double x) -> double {
-            std::unordered_map<std::string, double> vars = { {"x", x} };
-            return compiled(vars);
-            };
+    int status = 0;
+    if (child > 0) waitpid(child, &status, 0);
+    const std::uint64_t served = server.requests();
+    server.stop();
+
+    // Путь WSTP без ядра: разбор и формирование ответа через ссылку в памяти
+    std::vector<double> samples(calls);
+    for (int i = 0; i < calls; ++i) {
+        auto before = std::chrono::steady_clock::now();
+        FakePackedArrayLink link({ points[2 * (i % batch)], points[2 * (i % batch) + 1] },
+            { 1, 2 });
+        InterpolateListOverLink(link, *interpolator);
+        samples[i] = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - before).count();
     }
-
-    // Метод для преобразования строки FullForm в std::function, принимающую
-    // произвольное количество аргументов
-    static std::function<double(const std::unordered_map<std::string, double>&)>
-        parseMultiVarFunction(const std::string& fullFormStr) {
-        MathematicaParser parser(fullFormStr);
-        auto expr = parser.parse();
-        return expr->compile();
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < batches; ++k) {
+        FakePackedArrayLink link(points, { int(batch), 2 });
+        InterpolateListOverLink(link, *interpolator);
     }
-};
-
-// Вспомогательная функция для проверки равенства значений с плавающей точкой
-bool almostEqual(double a, double b, double epsilon = 1e-10) {
-    return std::abs(a - b) < epsilon;
+    auto middle = std::chrono::steady_clock::now();
+    std::vector<double> out(batch);
+    for (int k = 0; k < batches; ++k)
+        interpolator->interpolateBatch(points.data(), out.data(), batch);
+    auto stop = std::chrono::steady_clock::now();
+    std::cout << "  link path: call median " << median(samples) << " ns, batch "
+        << std::chrono::duration<double, std::nano>(middle - start).count() / (batches * batch)
+        << " ns/point; in-process batch "
+        << std::chrono::duration<double, std::nano>(stop - middle).count() / (batches * batch)
+        << " ns/point; server requests " << served << ", client exit "
+        << (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << std::endl;
+#else
+    (void)size;
+#endif
 }
 
 // Пример использования
@@ -668,6 +1430,38 @@ int main() {
         std::cout << "Unsupported function result: " << unsupportedFunc(2.0)
             << std::endl;
 
+        benchmarkClosuresVsBytecode(complexLambdaStr);
+        benchmarkClosuresVsBytecode(
+            "Times[Sqrt[Plus[1, Power[Cos[x], 2]]], Exp[Times[Rational[-1, 2], x]]]");
+        reportCurveOptimization("Times[Sin[#], Exp[Times[-1, #]]]&",
+            "Times[Power[Sin[x], 2], Times[4, Rational[1, 2]]]");
+        reportCache(complexLambdaStr);
+        benchmarkParse(1000);
+        benchmarkParse(50000);
+        benchmarkNative(complexLambdaStr);
+        reportArcLength();
+        reportLinkReader();
+        benchmarkInterpolateList(100000);
+        for (int size : { 256, 1024, 4096 }) benchmarkCreation(size);
+        reportHandleRegistry();
+        reportJobScheduler();
+        reportSnapshot(4096);
+        benchmarkMetrics(1000000);
+        reportTrace();
+        reportPyramid(2049);
+        reportTiledGrid(4096);
+        reportTensorInterpolator();
+        reportCubicKernels(2048);
+        reportBoundHierarchy(2048);
+        reportPathCursor(2048);
+        reportCpuDispatch(2048);
+        reportSpaceTime(256, 16);
+        reportSharedMemoryIpc(1024);
+        reportGridStore(2048);
+        benchmarkBatch(complexLambdaStr);
+        benchmarkBatch(
+            "Times[Sqrt[Plus[1, Power[Cos[x], 2]]], Exp[Times[Rational[-1, 2], x]]]");
+
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,191 @@
+#include "GridStore.h"
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "Trace.h"
+
+namespace {
+
+// FNV-1a по 8-байтовым словам, как контрольная сумма снимков
+std::uint64_t mix(std::uint64_t hash, std::uint64_t word) {
+  return (hash ^ word) * 1099511628211ull;
+}
+
+std::uint64_t contentHash(const BicubicInterpolator& interpolator) {
+  std::uint64_t hash = 14695981039346656037ull;
+  hash = mix(hash, static_cast<std::uint64_t>(interpolator.rowCount()));
+  hash = mix(hash, static_cast<std::uint64_t>(interpolator.colCount()));
+  hash = mix(hash, static_cast<std::uint64_t>(interpolator.kernel()));
+  const double* data = interpolator.data();
+  const size_t count =
+      static_cast<size_t>(interpolator.rowCount()) * interpolator.colCount();
+  for (size_t i = 0; i < count; ++i) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = mix(hash, word);
+  }
+  return hash;
+}
+
+// Побитное сравнение: -0.0 и 0.0, как и разные NaN, считаются разными
+bool sameGrid(const BicubicInterpolator& a, const BicubicInterpolator& b) {
+  return a.rowCount() == b.rowCount() && a.colCount() == b.colCount() &&
+         a.kernel() == b.kernel() &&
+         std::memcmp(a.data(), b.data(),
+                     static_cast<size_t>(a.rowCount()) * a.colCount() *
+                         sizeof(double)) == 0;
+}
+
+}  // namespace
+
+struct GridStore::Entry {
+  std::uint64_t hash;
+  std::uint64_t bytes;
+  //! Интерполятор живет, пока есть хотя бы одна ссылка (leases > 0)
+  std::weak_ptr<const BicubicInterpolator> grid;
+  size_t leases;
+};
+
+// Состояние разделяется со ссылками: ссылка, пережившая хранилище при
+// завершении процесса, не обращается к разрушенному объекту
+struct GridStore::State {
+  std::mutex mutex;
+  std::unordered_multimap<std::uint64_t, std::shared_ptr<Entry>> entries;
+  std::uint64_t bytesSaved = 0;
+  std::uint64_t uniqueBytes = 0;
+  std::uint64_t hits = 0;
+
+  void release(const std::shared_ptr<Entry>& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--entry->leases > 0) {
+      bytesSaved -= entry->bytes;
+      return;
+    }
+    uniqueBytes -= entry->bytes;
+    auto range = entries.equal_range(entry->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == entry) {
+        entries.erase(it);
+        break;
+      }
+    }
+  }
+};
+
+// Ссылка одного дескриптора на общий интерполятор
+class GridStore::Lease {
+ public:
+  Lease(std::shared_ptr<State> state, std::shared_ptr<Entry> entry,
+        std::shared_ptr<const BicubicInterpolator> grid)
+      : state_(std::move(state)),
+        entry_(std::move(entry)),
+        grid_(std::move(grid)) {}
+  // Интерполятор (если ссылка последняя) разрушается после снятия блокировки
+  ~Lease() { state_->release(entry_); }
+
+  const BicubicInterpolator* get() const { return grid_.get(); }
+
+ private:
+  std::shared_ptr<State> state_;
+  std::shared_ptr<Entry> entry_;
+  std::shared_ptr<const BicubicInterpolator> grid_;
+};
+
+GridStore::GridStore() : state_(std::make_shared<State>()) {}
+
+GridStore& GridStore::instance() {
+  static GridStore store;
+  return store;
+}
+
+/*!
+ * \details
+ * Хеш вычисляется без блокировки; под блокировкой только поиск и проверка
+ * совпадения. Возвращаемый указатель разделяет владение ссылкой, и когда
+ * последняя копия указателя исчезает, ссылка снимается со счета сетки.
+ */
+std::shared_ptr<const BicubicInterpolator> GridStore::intern(
+    std::shared_ptr<const BicubicInterpolator> interpolator) {
+  if (!interpolator || !interpolator->data()) return interpolator;
+  TraceSpan span("grid.intern");
+  const std::uint64_t hash = contentHash(*interpolator);
+  const std::uint64_t bytes = static_cast<std::uint64_t>(
+                                  interpolator->rowCount()) *
+                              interpolator->colCount() * sizeof(double);
+
+  std::shared_ptr<Lease> lease;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    auto range = state_->entries.equal_range(hash);
+    for (auto it = range.first; it != range.second && !lease; ++it) {
+      std::shared_ptr<const BicubicInterpolator> existing =
+          it->second->grid.lock();
+      if (!existing || !sameGrid(*existing, *interpolator)) continue;
+      ++it->second->leases;
+      state_->bytesSaved += bytes;
+      ++state_->hits;
+      lease = std::make_shared<Lease>(state_, it->second, std::move(existing));
+    }
+    if (!lease) {
+      auto entry = std::make_shared<Entry>(Entry{hash, bytes, interpolator, 1});
+      state_->entries.emplace(hash, entry);
+      state_->uniqueBytes += bytes;
+      lease = std::make_shared<Lease>(state_, std::move(entry), interpolator);
+    }
+  }
+  // Копия, оказавшаяся лишней, разрушается здесь, вне блокировки
+  return std::shared_ptr<const BicubicInterpolator>(lease, lease->get());
+}
+
+std::uint64_t GridStore::bytesSaved() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->bytesSaved;
+}
+
+std::uint64_t GridStore::uniqueBytes() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->uniqueBytes;
+}
+
+std::uint64_t GridStore::hits() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->hits;
+}
+
+/*!
+ * \details
+ * Сетка хранит матрицу транспонированной и окруженной рамкой (см.
+ * CreatePaddedInterpolator), поэтому m[[i, j]] — узел (x, y) = (i, j).
+ * Исходная сетка копируется один раз, даже если она хранится плитками;
+ * результат хранится одним массивом.
+ */
+std::unique_ptr<BicubicInterpolator> UpdateGridValues(
+    const BicubicInterpolator& interpolator, const double* updates,
+    size_t count) {
+  if (interpolator.kernel() == CubicKernelType::BSpline) {
+    throw std::invalid_argument(
+        "B-spline grids store coefficients and cannot be updated");
+  }
+  const int rows = interpolator.rowCount();
+  const int cols = interpolator.colCount();
+  const std::shared_ptr<const double> source = interpolator.denseData();
+  std::vector<double> values(source.get(),
+                             source.get() + static_cast<size_t>(rows) * cols);
+  for (size_t k = 0; k < count; ++k) {
+    const double i = updates[3 * k];
+    const double j = updates[3 * k + 1];
+    if (!(i >= 1 && i <= cols - 2 && j >= 1 && j <= rows - 2) ||
+        i != std::floor(i) || j != std::floor(j)) {
+      throw std::invalid_argument("Grid index is out of range");
+    }
+    values[static_cast<size_t>(j) * cols + static_cast<size_t>(i)] =
+        updates[3 * k + 2];
+  }
+  return std::make_unique<BicubicInterpolator>(std::move(values), rows, cols,
+                                               interpolator.kernel());
+}
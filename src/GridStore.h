@@ -0,0 +1,68 @@
+#ifndef GRIDSTORE_H
+#define GRIDSTORE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "BicubicInterpolator.h"
+
+/*!
+ * \class GridStore
+ * \brief Хранилище сеток по содержимому: одинаковые сетки разных
+ * дескрипторов используют один интерполятор.
+ *
+ * Ключ — FNV-1a по значениям сетки вместе с размерами и ядром. Значения
+ * берутся после добавления рамки и фильтрации B-сплайна, поэтому ключ
+ * учитывает граничные условия, а общими становятся и вычисленные
+ * коэффициенты. Совпадение ключа проверяется сравнением значений.
+ *
+ * intern выдает каждому дескриптору свою ссылку на общий интерполятор;
+ * пока ссылок на сетку больше одной, ее размер, умноженный на число
+ * лишних ссылок, учитывается как сэкономленные байты. Сетки неизменяемы:
+ * изменение значений (UpdateGridValues) создает новую сетку, а остальные
+ * дескрипторы продолжают видеть прежнюю (копирование при записи).
+ */
+class GridStore {
+ public:
+  static GridStore& instance();
+
+  /*!
+   * \brief Возвращает интерполятор с той же сеткой, если он уже есть.
+   * \param[in] interpolator Новый интерполятор; сетки из плиток не
+   * объединяются и возвращаются как есть.
+   * \return Ссылка на общий интерполятор для нового дескриптора.
+   */
+  std::shared_ptr<const BicubicInterpolator> intern(
+      std::shared_ptr<const BicubicInterpolator> interpolator);
+
+  //! Байты сеток, которые хранились бы повторно без объединения
+  std::uint64_t bytesSaved() const;
+  //! Байты различных сеток в хранилище
+  std::uint64_t uniqueBytes() const;
+  //! Сколько раз новая сетка оказалась копией существующей
+  std::uint64_t hits() const;
+
+ private:
+  struct Entry;
+  struct State;
+  class Lease;
+
+  GridStore();
+
+  std::shared_ptr<State> state_;
+};
+
+/*!
+ * \brief Копия сетки с измененными значениями.
+ * \param[in] interpolator Исходный интерполятор; не изменяется.
+ * \param[in] updates Тройки {i, j, value}: новое значение узла матрицы
+ * m[[i, j]] Mathematica (индексы с 1, без рамки).
+ * \param[in] count Количество троек.
+ * \return Новый интерполятор с тем же ядром.
+ * \throws std::invalid_argument Для B-сплайна (сетка хранит коэффициенты,
+ * а не значения) или при индексе вне матрицы.
+ */
+std::unique_ptr<BicubicInterpolator> UpdateGridValues(
+    const BicubicInterpolator& interpolator, const double* updates,
+    size_t count);
+#endif
@@ -0,0 +1,253 @@
+#ifndef HANDLEREGISTRY_H
+#define HANDLEREGISTRY_H
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*!
+ * \class HandleRegistry
+ * \brief Таблица объектов по целочисленным дескрипторам (slot map).
+ *
+ * Дескриптор кодирует индекс ячейки (младшие kIndexBits бит) и ее поколение.
+ * Поиск — O(1): индекс сразу дает ячейку, а несовпадение поколения
+ * означает, что объект уже удален и ячейка, возможно, занята другим
+ * (устаревший дескриптор). Освобожденные ячейки используются повторно
+ * с увеличенным поколением в порядке освобождения (FIFO), так что
+ * поколения растут равномерно по всем ячейкам. Ячейка, исчерпавшая
+ * поколения (kGenerationMask), больше не используется: иначе поколение
+ * вернулось бы к 1 и старый дескриптор снова указывал бы на живой объект.
+ *
+ * Объекты хранятся через shared_ptr: удаление из таблицы не разрушает
+ * объект, пока на него ссылаются другие объекты или выполняющиеся
+ * вычисления. Ячейки размещаются фрагментами, которые не перемещаются,
+ * поэтому find не захватывает мьютекс и может вызываться из любых потоков;
+ * insert и erase сериализуются между собой.
+ *
+ * find не блокируется: ячейка хранит две копии указателя и два счетчика
+ * читателей (алгоритм Left-Right). Читатель отмечается в счетчике и
+ * копирует ту копию, на которую указывает leftRight; запись меняет
+ * неактивную копию, переключает читателей на нее и, дождавшись ухода
+ * читателей этой ячейки, обновляет вторую. Ждут только insert, erase и
+ * replace, и только читателей, пришедших до начала записи.
+ */
+template <typename T>
+class HandleRegistry {
+ public:
+  typedef int Handle;
+
+  HandleRegistry() {
+    for (auto& chunk : chunks_) chunk.store(nullptr, std::memory_order_relaxed);
+  }
+  ~HandleRegistry() {
+    for (auto& chunk : chunks_) delete[] chunk.load(std::memory_order_relaxed);
+  }
+  HandleRegistry(const HandleRegistry&) = delete;
+  HandleRegistry& operator=(const HandleRegistry&) = delete;
+
+  /*!
+   * \brief Регистрирует объект.
+   * \return Дескриптор (всегда положительный).
+   * \throws std::length_error Если все kMaxSlots ячеек заняты.
+   */
+  Handle insert(std::shared_ptr<T> object) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    std::uint32_t index;
+    if (!freeList_.empty()) {
+      index = freeList_.front();
+      freeList_.pop_front();
+    } else {
+      if (slotCount_ == kMaxSlots) {
+        throw std::length_error("Handle registry is full");
+      }
+      index = slotCount_++;
+      auto& chunk = chunks_[index >> kChunkBits];
+      if (!chunk.load(std::memory_order_relaxed)) {
+        chunk.store(new Slot[kChunkSize], std::memory_order_release);
+      }
+    }
+
+    Slot& slot = slotAt(index);
+    store(slot, std::move(object));
+    const std::uint32_t generation =
+        slot.generation.load(std::memory_order_relaxed);
+    // Признак live публикуется последним: читатель, увидевший его, видит
+    // объект
+    slot.live.store(true, std::memory_order_release);
+    ++size_;
+    return encode(index, generation);
+  }
+
+  //! Объект по дескриптору или nullptr для неизвестного/устаревшего
+  std::shared_ptr<T> find(Handle handle) const {
+    std::uint32_t index, generation;
+    if (!decode(handle, index, generation)) return nullptr;
+
+    const Slot* chunk =
+        chunks_[index >> kChunkBits].load(std::memory_order_acquire);
+    if (!chunk) return nullptr;
+    const Slot& slot = chunk[index & (kChunkSize - 1)];
+    if (!matches(slot, generation)) return nullptr;
+
+    const std::uint32_t version = slot.versionIndex.load();
+    slot.readers[version].fetch_add(1);
+    std::shared_ptr<T> object;
+    if (matches(slot, generation)) object = slot.objects[slot.leftRight.load()];
+    slot.readers[version].fetch_sub(1, std::memory_order_release);
+    // Ячейка могла быть освобождена и занята заново между проверками
+    return matches(slot, generation) ? object : nullptr;
+  }
+
+  //! Удаляет объект; false, если дескриптор неизвестен или устарел
+  bool erase(Handle handle) {
+    std::uint32_t index, generation;
+    if (!decode(handle, index, generation)) return false;
+
+    std::shared_ptr<T> released;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      if (index >= slotCount_) return false;
+      Slot& slot = slotAt(index);
+      if (!matches(slot, generation)) return false;
+
+      slot.live.store(false, std::memory_order_release);
+      released = store(slot, std::shared_ptr<T>());
+      if (generation != kGenerationMask) {
+        slot.generation.store(generation + 1, std::memory_order_release);
+        freeList_.push_back(index);
+      }
+      --size_;
+    }
+    // Объект разрушается (если это последняя ссылка) вне мьютекса
+    return true;
+  }
+
+  /*!
+   * \brief Заменяет объект под тем же дескриптором.
+   * \return false, если дескриптор неизвестен или устарел.
+   *
+   * Читатели, уже получившие прежний объект через find, продолжают
+   * работать с ним.
+   */
+  bool replace(Handle handle, std::shared_ptr<T> object) {
+    std::uint32_t index, generation;
+    if (!decode(handle, index, generation)) return false;
+
+    std::shared_ptr<T> released;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      if (index >= slotCount_) return false;
+      Slot& slot = slotAt(index);
+      if (!matches(slot, generation)) return false;
+      released = store(slot, std::move(object));
+    }
+    return true;
+  }
+
+  //! Вызывает fn(handle, object) для каждого живого объекта
+  template <typename Fn>
+  void forEach(Fn fn) const {
+    std::vector<std::pair<Handle, std::shared_ptr<T>>> live;
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      for (std::uint32_t index = 0; index < slotCount_; ++index) {
+        const Slot& slot = chunks_[index >> kChunkBits].load(
+            std::memory_order_relaxed)[index & (kChunkSize - 1)];
+        if (!slot.live.load(std::memory_order_relaxed)) continue;
+        live.emplace_back(
+            encode(index, slot.generation.load(std::memory_order_relaxed)),
+            slot.objects[slot.leftRight.load(std::memory_order_relaxed)]);
+      }
+    }
+    // Обратный вызов выполняется без мьютекса и может сам менять таблицу
+    for (auto& entry : live) fn(entry.first, entry.second);
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return size_;
+  }
+
+  static constexpr int kIndexBits = 20;
+  static constexpr std::uint32_t kMaxSlots = 1u << kIndexBits;
+
+ private:
+  struct Slot {
+    //! Начинается с 1: дескриптор никогда не равен 0
+    std::atomic<std::uint32_t> generation{1};
+    std::atomic<bool> live{false};
+    //! Копия objects, которую читают find
+    std::atomic<std::uint32_t> leftRight{0};
+    //! Счетчик readers, в котором отмечаются новые читатели
+    std::atomic<std::uint32_t> versionIndex{0};
+    mutable std::atomic<std::uint32_t> readers[2] = {};
+    std::shared_ptr<T> objects[2];
+  };
+
+  static constexpr int kChunkBits = 10;
+  static constexpr std::uint32_t kChunkSize = 1u << kChunkBits;
+  // Поколение занимает оставшиеся биты положительного int
+  static constexpr std::uint32_t kGenerationMask =
+      (1u << (31 - kIndexBits)) - 1;
+
+  static Handle encode(std::uint32_t index, std::uint32_t generation) {
+    return static_cast<Handle>((generation << kIndexBits) | index);
+  }
+
+  static bool decode(Handle handle, std::uint32_t& index,
+                     std::uint32_t& generation) {
+    if (handle <= 0) return false;
+    const std::uint32_t bits = static_cast<std::uint32_t>(handle);
+    index = bits & (kMaxSlots - 1);
+    generation = bits >> kIndexBits;
+    return generation != 0;
+  }
+
+  static bool matches(const Slot& slot, std::uint32_t generation) {
+    return slot.live.load(std::memory_order_acquire) &&
+           slot.generation.load(std::memory_order_acquire) == generation;
+  }
+
+  /*!
+   * \brief Записывает объект в ячейку; вызывается под writeMutex_.
+   * \return Прежний объект, чтобы он разрушился вне мьютекса.
+   */
+  static std::shared_ptr<T> store(Slot& slot, std::shared_ptr<T> object) {
+    const std::uint32_t side = slot.leftRight.load(std::memory_order_relaxed);
+    std::shared_ptr<T> previous = slot.objects[side];
+    slot.objects[1 - side] = object;
+    slot.leftRight.store(1 - side);
+    // Читатели, отметившиеся до переключения, могут читать objects[side]
+    const std::uint32_t version =
+        slot.versionIndex.load(std::memory_order_relaxed);
+    waitForReaders(slot, 1 - version);
+    slot.versionIndex.store(1 - version);
+    waitForReaders(slot, version);
+    slot.objects[side] = std::move(object);
+    return previous;
+  }
+
+  static void waitForReaders(const Slot& slot, std::uint32_t version) {
+    while (slot.readers[version].load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  Slot& slotAt(std::uint32_t index) {
+    return chunks_[index >> kChunkBits].load(
+        std::memory_order_relaxed)[index & (kChunkSize - 1)];
+  }
+
+  std::array<std::atomic<Slot*>, kMaxSlots / kChunkSize> chunks_;
+  mutable std::mutex writeMutex_;
+  std::deque<std::uint32_t> freeList_;
+  std::uint32_t slotCount_ = 0;
+  size_t size_ = 0;
+};
+#endif
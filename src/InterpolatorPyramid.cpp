@@ -0,0 +1,200 @@
+#include "InterpolatorPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ParallelFor.h"
+#include "Trace.h"
+
+namespace {
+
+// Минимальный размер уровня: бикубическому шаблону нужно 4 узла
+const int kMinLevelSize = 4;
+// Число интервалов Симпсона на отрезке при уточнении
+const int kSegmentIntervals = 8;
+const int kMaxRefineDepth = 24;
+
+inline int clampIndex(int i, int size) {
+  return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+/*!
+ * \brief Следующий уровень: фильтр [1, 2, 1] / 4 по строкам, затем по
+ * столбцам, с прореживанием в 2 раза.
+ */
+std::shared_ptr<const BicubicInterpolator> downsample(
+    const BicubicInterpolator& source, size_t threads) {
+  const int rows = source.rowCount();
+  const int cols = source.colCount();
+  const int outRows = (rows - 1) / 2 + 1;
+  const int outCols = (cols - 1) / 2 + 1;
+  const std::shared_ptr<const double> dense = source.denseData();
+  const double* in = dense.get();
+
+  // Проход по x: rows x outCols
+  std::vector<double> horizontal(static_cast<size_t>(rows) * outCols);
+  ParallelFor(rows, threads, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      const double* row = in + r * cols;
+      double* out = horizontal.data() + r * outCols;
+      for (int j = 0; j < outCols; ++j) {
+        const int c = 2 * j;
+        out[j] = 0.25 * (row[clampIndex(c - 1, cols)] + 2.0 * row[c] +
+                         row[clampIndex(c + 1, cols)]);
+      }
+    }
+  });
+
+  // Проход по y: outRows x outCols
+  std::vector<double> result(static_cast<size_t>(outRows) * outCols);
+  ParallelFor(outRows, threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const int r = 2 * static_cast<int>(i);
+      const double* above = horizontal.data() +
+                            static_cast<size_t>(clampIndex(r - 1, rows)) * outCols;
+      const double* center = horizontal.data() + static_cast<size_t>(r) * outCols;
+      const double* below = horizontal.data() +
+                            static_cast<size_t>(clampIndex(r + 1, rows)) * outCols;
+      double* out = result.data() + i * outCols;
+#pragma omp simd
+      for (int j = 0; j < outCols; ++j) {
+        out[j] = 0.25 * (above[j] + 2.0 * center[j] + below[j]);
+      }
+    }
+  });
+
+  // Значения уровня уже в виде, к которому применяется ядро источника
+  // (для B-сплайна — сглаженные коэффициенты), повторный префильтр не нужен
+  auto flat = std::make_shared<std::vector<double>>(std::move(result));
+  return std::make_shared<const BicubicInterpolator>(
+      std::shared_ptr<const double>(flat, flat->data()), outRows, outCols,
+      source.kernel());
+}
+
+}  // namespace
+
+/*!
+ * \brief Строит все уровни пирамиды.
+ * \param[in] base Исходный интерполятор (уровень 0, не копируется).
+ * \param[in] threads Количество потоков; 0 — по числу ядер.
+ *
+ * \details
+ * Уровни строятся последовательно, строки каждого уровня — параллельно.
+ * Суммарный объем уровней выше нулевого не превышает трети исходной сетки.
+ */
+InterpolatorPyramid::InterpolatorPyramid(
+    std::shared_ptr<const BicubicInterpolator> base, size_t threads) {
+  TraceSpan span("pyramid.build");
+  levels_.push_back(std::move(base));
+  while (true) {
+    const BicubicInterpolator& last = *levels_.back();
+    if ((last.rowCount() - 1) / 2 + 1 < kMinLevelSize ||
+        (last.colCount() - 1) / 2 + 1 < kMinLevelSize) {
+      break;
+    }
+    levels_.push_back(downsample(last, threads));
+  }
+}
+
+double InterpolatorPyramid::levelFor(double footprint) const {
+  if (!(footprint > 1.0)) return 0.0;
+  return std::min(std::log2(footprint),
+                  static_cast<double>(levels_.size() - 1));
+}
+
+/*!
+ * \brief Значение на уровне k в координатах исходной сетки.
+ *
+ * \details
+ * Точки вне сетки ограничиваются без предупреждения: из-за прореживания
+ * крайний узел исходной сетки может лежать за последним узлом уровня.
+ */
+double InterpolatorPyramid::interpolateLevel(size_t k, double x,
+                                             double y) const {
+  const BicubicInterpolator& grid = *levels_[k];
+  const double scale = std::ldexp(1.0, -static_cast<int>(k));
+  const double lx = std::max(
+      0.0, std::min(x * scale, static_cast<double>(grid.colCount() - 1.01)));
+  const double ly = std::max(
+      0.0, std::min(y * scale, static_cast<double>(grid.rowCount() - 1.01)));
+  return grid.interpolate(lx, ly);
+}
+
+/*!
+ * \brief Значение в точке (x, y), усредненное по области размера footprint.
+ * \param[in] footprint Размер области в шагах исходной сетки (например,
+ * расстояние между соседними пикселями изображения); значения <= 1 дают
+ * обычную интерполяцию по исходной сетке.
+ *
+ * \details
+ * Между соседними уровнями значение смешивается линейно по дробной части
+ * номера уровня, чтобы при плавном изменении масштаба не было скачков.
+ */
+double InterpolatorPyramid::interpolate(double x, double y,
+                                        double footprint) const {
+  const double level = levelFor(footprint);
+  const size_t lower = static_cast<size_t>(level);
+  const double blend = level - lower;
+  const double value = interpolateLevel(lower, x, y);
+  if (blend == 0.0 || lower + 1 >= levels_.size()) return value;
+  return value + blend * (interpolateLevel(lower + 1, x, y) - value);
+}
+
+/*!
+ * \details
+ * Отрезок считается формулой Симпсона на уровне, соответствующем шагу
+ * между узлами, и на уровень точнее. Если оценки расходятся больше чем на
+ * tolerance, отрезок делится пополам (шаг и уровень уменьшаются) с
+ * половинным допуском для каждой части. Гладкие участки и участки,
+ * где грубые уровни уже точны, заканчиваются на грубых уровнях.
+ */
+double InterpolatorPyramid::integrateCurve(const CurveBatchFunc& curve,
+                                           double t_start, double t_end,
+                                           double tolerance,
+                                           size_t* samples) const {
+  TraceSpan span("pyramid.integrate");
+  size_t count = 0;
+  const double result =
+      t_start == t_end ? 0.0
+                       : refine(curve, t_start, t_end, tolerance, 0, count);
+  if (samples) *samples = count;
+  return result;
+}
+
+double InterpolatorPyramid::refine(const CurveBatchFunc& curve, double a,
+                                   double b, double tolerance, int depth,
+                                   size_t& samples) const {
+  std::vector<double> t;
+  FunctionNIntegratorBySimpson::nodes(a, b, kSegmentIntervals, t);
+  const size_t count = t.size();
+  std::vector<double> x(count), y(count);
+  curve(t.data(), x.data(), y.data(), count);
+  samples += count;
+
+  double length = 0.0;
+  for (size_t i = 1; i < count; ++i) {
+    length += std::hypot(x[i] - x[i - 1], y[i] - y[i - 1]);
+  }
+  const size_t coarse = static_cast<size_t>(levelFor(length / kSegmentIntervals));
+  const size_t fine = coarse == 0 ? 0 : coarse - 1;
+
+  const double h = (b - a) / kSegmentIntervals;
+  std::vector<double> values(count);
+  for (size_t i = 0; i < count; ++i) values[i] = interpolateLevel(fine, x[i], y[i]);
+  const double fineEstimate =
+      FunctionNIntegratorBySimpson::weightedSum(values, h);
+  if (coarse == 0 || depth >= kMaxRefineDepth) return fineEstimate;
+
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = interpolateLevel(coarse, x[i], y[i]);
+  }
+  const double coarseEstimate =
+      FunctionNIntegratorBySimpson::weightedSum(values, h);
+  if (std::abs(fineEstimate - coarseEstimate) <= tolerance) {
+    return fineEstimate;
+  }
+
+  const double mid = 0.5 * (a + b);
+  return refine(curve, a, mid, 0.5 * tolerance, depth + 1, samples) +
+         refine(curve, mid, b, 0.5 * tolerance, depth + 1, samples);
+}
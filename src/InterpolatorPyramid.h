@@ -0,0 +1,56 @@
+#ifndef INTERPOLATORPYRAMID_H
+#define INTERPOLATORPYRAMID_H
+#include <memory>
+#include <vector>
+
+#include "BicubicInterpolator.h"
+
+/*!
+ * \class InterpolatorPyramid
+ * \brief Пирамида уровней детализации над бикубическим интерполятором.
+ *
+ * Уровень 0 — исходная сетка, каждый следующий получается сглаживанием
+ * сепарабельным фильтром [1, 2, 1] / 4 и прореживанием в 2 раза по каждой
+ * оси, так что узел i уровня k совпадает с узлом i * 2^k исходной сетки.
+ * Запрос с размером области (footprint) в единицах исходной сетки читает
+ * уровень, шаг которого соответствует этой области: меньше наложения
+ * спектров и меньше промахов кэша на крупных масштабах.
+ */
+class InterpolatorPyramid {
+ public:
+  explicit InterpolatorPyramid(
+      std::shared_ptr<const BicubicInterpolator> base, size_t threads = 0);
+
+  size_t levelCount() const { return levels_.size(); }
+  const BicubicInterpolator& level(size_t k) const { return *levels_[k]; }
+
+  //! Дробный номер уровня для области размера footprint
+  double levelFor(double footprint) const;
+
+  double interpolate(double x, double y, double footprint) const;
+  double interpolateLevel(size_t k, double x, double y) const;
+
+  /*!
+   * \brief Интеграл f(x(t), y(t)) dt с уточнением от грубых уровней к
+   * точным.
+   * \param[in] curve Пакетная кривая.
+   * \param[in] tolerance Допустимое расхождение оценок соседних уровней.
+   * \param[out] samples Если задан, получает число вычисленных точек.
+   *
+   * Результат приближает интеграл поля, сглаженного до масштаба шага
+   * выборки на каждом участке (как interpolate с footprint, равным шагу), а
+   * не исходной сетки: составляющие мельче шага отбрасываются, и от
+   * интеграла по исходной сетке результат может отличаться больше чем на
+   * tolerance. Интеграл по исходной сетке дает ParametricCurveIntegrator.
+   */
+  double integrateCurve(const CurveBatchFunc& curve, double t_start,
+                        double t_end, double tolerance,
+                        size_t* samples = nullptr) const;
+
+ private:
+  double refine(const CurveBatchFunc& curve, double a, double b,
+                double tolerance, int depth, size_t& samples) const;
+
+  std::vector<std::shared_ptr<const BicubicInterpolator>> levels_;
+};
+#endif
@@ -1,19 +1,74 @@
 :Evaluate: BeginPackage["BicubicInterpolatorWSTP`"]
 
-:Evaluate: CreateInterpolator::usage = "CreateInterpolator[data] creates an interpolator from 2D data."
+:Evaluate: CreateInterpolator::usage = "CreateInterpolator[data] creates an interpolator from 2D data. CreateInterpolator[data, kernel] uses kernel \"CatmullRom\" (default), \"BSpline\" (smooth, prefiltered once) or \"MonotoneHermite\" (no overshoot)."
 :Evaluate: InterpolatePoint::usage = "InterpolatePoint[handle, x, y] interpolates the value at point (x,y)."
+:Evaluate: InterpolateList::usage = "InterpolateList[handle, points] interpolates at every {x, y} in points (an n x 2 real array)."
 :Evaluate: DeleteInterpolator::usage = "DeleteInterpolator[handle] removes an interpolator."
 
+:Evaluate: SetGridValues::usage = "SetGridValues[handle, {{i, j, value}, ...}] sets data[[i, j]] of the interpolator grid. Handles created from identical data share one grid until it is changed this way; other handles keep the old values. Not available for the \"BSpline\" kernel."
+:Evaluate: TileInterpolator::usage = "TileInterpolator[handle, compress] returns a new interpolator over the same grid stored in 32 x 32 tiles; uniform tiles keep a single value and, with compress True, other tiles are losslessly XOR-compressed."
+:Evaluate: InterpolatorMemory::usage = "InterpolatorMemory[handle] returns the number of bytes held by the interpolator grid."
+:Evaluate: SaveInterpolator::usage = "SaveInterpolator[handle, file] writes a snapshot of the interpolator grid to file."
+:Evaluate: LoadInterpolator::usage = "LoadInterpolator[file] memory-maps a snapshot and returns a new interpolator handle."
+:Evaluate: SaveAllInterpolators::usage = "SaveAllInterpolators[dir] snapshots every interpolator into dir and returns their number."
+:Evaluate: RestoreAllInterpolators::usage = "RestoreAllInterpolators[dir] restores the interpolators saved in dir and returns rules oldHandle -> newHandle."
+:Evaluate: CreateSimpsonIntegrator::usage = "CreateSimpsonIntegrator[func, n] creates an integrator of the pure function func (e.g. Sin[#]&) by Simpson's rule with n intervals and returns its handle, or $Failed if func cannot be compiled."
+:Evaluate: IntegrateSimpson::usage = "IntegrateSimpson[handle, a, b] integrates the function of a Simpson integrator from a to b; returns Indeterminate for an unknown handle."
+:Evaluate: CreateCurveIntegrator::usage = "CreateCurveIntegrator[handle, xFunc, yFunc] creates an integrator of the interpolated surface along the curve {xFunc[t], yFunc[t]} given as pure functions, and returns its handle, or $Failed. The integrator keeps the grid alive after DeleteInterpolator[handle]."
+:Evaluate: IntegrateCurve::usage = "IntegrateCurve[handle, t0, t1, n] returns the integral of the interpolated surface f[xFunc[t], yFunc[t]] dt from t0 to t1 by Simpson's rule with n intervals; Indeterminate for an unknown handle."
+:Evaluate: IntegrateCurveArcLength::usage = "IntegrateCurveArcLength[handle, t0, t1, n] returns the line integral of the interpolated surface f over the curve, the integral of f[xFunc[t], yFunc[t]] Sqrt[xFunc'[t]^2 + yFunc'[t]^2] dt from t0 to t1 by Simpson's rule with n intervals; Indeterminate for an unknown handle."
+:Evaluate: CreateTensorInterpolator::usage = "CreateTensorInterpolator[array] creates a tricubic (depth 3) or 4D (depth 4) interpolator; array[[i, j, ...]] is the value at x = i - 1, y = j - 1, ..."
+:Evaluate: InterpolateTensorList::usage = "InterpolateTensorList[handle, points] interpolates at every point of an n x d real array, d being the interpolator dimension."
+:Evaluate: DeleteTensorInterpolator::usage = "DeleteTensorInterpolator[handle] removes a tensor interpolator."
+:Evaluate: CreatePyramid::usage = "CreatePyramid[handle] builds prefiltered half-resolution levels of the interpolator grid and returns a pyramid handle."
+:Evaluate: InterpolatePyramid::usage = "InterpolatePyramid[pyramid, x, y, footprint] interpolates at (x, y) on the level matching footprint, the query spacing in grid cells."
+:Evaluate: IntegratePyramidCurve::usage = "IntegratePyramidCurve[pyramid, xFunc, yFunc, t0, t1, tol] integrates along the curve starting on coarse levels and refining where the estimates of neighbouring levels differ by more than tol. The result approximates the integral of the field smoothed to the sampling step, not of the base grid; use IntegrateCurve for the latter."
+:Evaluate: DeletePyramid::usage = "DeletePyramid[pyramid] removes a pyramid."
+:Evaluate: CreateBoundHierarchy::usage = "CreateBoundHierarchy[handle] builds a tree of per-cell lower and upper bounds of the interpolated surface and returns its handle."
+:Evaluate: SurfaceMaximum::usage = "SurfaceMaximum[bounds, tol] returns {value, {x, y}} of the surface maximum, within tol of the true maximum."
+:Evaluate: SurfaceMinimum::usage = "SurfaceMinimum[bounds, tol] returns {value, {x, y}} of the surface minimum, within tol of the true minimum."
+:Evaluate: LevelSetCells::usage = "LevelSetCells[bounds, level] returns {x0, y0, x1, y1, partial} rectangles of cells [x0, x1) x [y0, y1) the contour at level may cross."
+:Evaluate: ThresholdCells::usage = "ThresholdCells[bounds, t] returns {x0, y0, x1, y1, partial} rectangles of cells where the surface may be >= t; partial is False where it is >= t everywhere."
+:Evaluate: DeleteBoundHierarchy::usage = "DeleteBoundHierarchy[bounds] removes a bound hierarchy."
+:Evaluate: CreateFrameStack::usage = "CreateFrameStack[rows, cols, capacity] creates a space-time interpolator over a sliding window of the last capacity frames of size rows x cols."
+:Evaluate: PushFrame::usage = "PushFrame[stack, t, frame] appends a rows x cols frame taken at time t (increasing), evicting the oldest frame of a full window, and returns the number of frames in the window."
+:Evaluate: InterpolateSpaceTime::usage = "InterpolateSpaceTime[stack, x, y, t] interpolates cubically in x, y and t within the frame window. Frames are indexed like CreateInterpolator: x, y address frame[[x, y]], zero outside the frame."
+:Evaluate: FrameTimeRange::usage = "FrameTimeRange[stack] returns {first, last} times of the frames in the window."
+:Evaluate: DeleteFrameStack::usage = "DeleteFrameStack[stack] removes a space-time interpolator."
+:Evaluate: StartSharedMemoryServer::usage = "StartSharedMemoryServer[name, slots, capacity] lets local processes run InterpolateList on interpolator handles through the POSIX shared-memory segment name with slots request slots (a power of two, at least 4) of capacity points each (Linux only). A slot a client does not submit or release within 1 second is taken back."
+:Evaluate: StopSharedMemoryServer::usage = "StopSharedMemoryServer[] stops the shared-memory server and removes its segment."
+:Evaluate: IntegrateSimpsonAsync::usage = "IntegrateSimpsonAsync[handle, a, b] starts IntegrateSimpson on a worker thread and returns a job id."
+:Evaluate: IntegrateCurveAsync::usage = "IntegrateCurveAsync[handle, t0, t1, n] starts IntegrateCurve on a worker thread and returns a job id."
+:Evaluate: IntegrateCurveArcLengthAsync::usage = "IntegrateCurveArcLengthAsync[handle, t0, t1, n] starts IntegrateCurveArcLength on a worker thread and returns a job id."
+:Evaluate: JobStatus::usage = "JobStatus[job] returns \"Pending\", \"Running\", \"Done\", \"Failed\", \"Cancelled\" or \"Unknown\". Only the 4096 most recent unfetched results are kept; older jobs become \"Unknown\"."
+:Evaluate: JobResult::usage = "JobResult[job] waits for the job and returns its value, $Canceled or $Failed. The job is forgotten afterwards."
+:Evaluate: CancelJob::usage = "CancelJob[job] cancels a queued job; a running integration stops at its next block of points."
+
+:Evaluate: InterpolatorStats::usage = "InterpolatorStats[] returns call counts, out-of-range counts and latency quantiles per handle and entry point in Prometheus text format; latency over all handles of an entry point is bicubic_entry_latency_seconds."
+:Evaluate: SetStrictMode::usage = "SetStrictMode[True|False] switches compute kernels to the scalar variant without FMA whose results are bit-identical on every x86-64 processor. InterpolatorStats[] reports the variant in use."
+:Evaluate: InterpolatorStatsDump::usage = "InterpolatorStatsDump[file, seconds] rewrites file with InterpolatorStats[] every seconds; seconds <= 0 stops it."
+
+:Evaluate: SetTracing::usage = "SetTracing[True|False] switches recording of trace spans."
+:Evaluate: ExportTrace::usage = "ExportTrace[file] writes recorded spans as Chrome trace_event JSON, clears them and returns their number."
+
 :Evaluate: Begin["`Private`"]
 
 :Begin:
 :Function:       WSTPCreateInterpolator
 :Pattern:        CreateInterpolator[mat_]
-:Arguments:      {mat}
+:Arguments:      {Developer`ToPackedArray[N[mat]]}
 :ArgumentTypes:  {Manual}
 :ReturnType:     Manual
 :End:
 
+:Begin:
+:Function:       WSTPCreateInterpolatorWithKernel
+:Pattern:        CreateInterpolator[mat_, kernel_String]
+:Arguments:      {kernel, Developer`ToPackedArray[N[mat]]}
+:ArgumentTypes:  {String, Manual}
+:ReturnType:     Manual
+:End:
+
 :Begin:
 :Function:       WSTPInterpolatePoint
 :Pattern:        InterpolatePoint[x_Real, y_Real, handle_Integer]
@@ -22,6 +77,14 @@
 :ReturnType:     Real
 :End:
 
+:Begin:
+:Function:       WSTPInterpolateList
+:Pattern:        InterpolateList[handle_Integer, points_]
+:Arguments:      {handle, Developer`ToPackedArray[N[points]]}
+:ArgumentTypes:  {Integer, Manual}
+:ReturnType:     Manual
+:End:
+
 :Begin:
 :Function:       WSTPDeleteInterpolator
 :Pattern:        DeleteInterpolator[handle_Integer]
@@ -38,12 +101,68 @@
 :ReturnType:     Manual
 :End:
 
+:Begin:
+:Function: WSTPSetGridValues
+:Pattern: SetGridValues[handle_Integer, updates_]
+:Arguments: {handle, Developer`ToPackedArray[N[updates]]}
+:ArgumentTypes: {Integer, Manual}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPTileInterpolator
+:Pattern: TileInterpolator[handle_Integer, compress:(True | False)]
+:Arguments: {handle, ToString[compress]}
+:ArgumentTypes: {Integer, String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolatorMemory
+:Pattern: InterpolatorMemory[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSaveInterpolator
+:Pattern: SaveInterpolator[handle_Integer, file_String]
+:Arguments: {handle, file}
+:ArgumentTypes: {Integer, String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPLoadInterpolator
+:Pattern: LoadInterpolator[file_String]
+:Arguments: {file}
+:ArgumentTypes: {String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSaveAllInterpolators
+:Pattern: SaveAllInterpolators[dir_String]
+:Arguments: {dir}
+:ArgumentTypes: {String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPRestoreAllInterpolators
+:Pattern: RestoreAllInterpolators[dir_String]
+:Arguments: {dir}
+:ArgumentTypes: {String}
+:ReturnType: Manual
+:End:
+
 :Begin:
 :Function: WSTPCreateSimpsonIntegrator
-:Pattern: CreateSimpsonIntegrator[func_, n_Integer]
+:Pattern: CreateSimpsonIntegrator[func_Function, n_Integer]
 :Arguments: {n, func}
 :ArgumentTypes: {Integer, Manual}
-:ReturnType: Integer
+:ReturnType: Manual
 :End:
 
 :Begin:
@@ -56,10 +175,274 @@
 
 :Begin:
 :Function: WSTPCreateCurveIntegrator
-:Pattern: CreateCurveIntegrator[interpHandle_Integer, xFunc_, yFunc_]
+:Pattern: CreateCurveIntegrator[interpHandle_Integer, xFunc_Function, yFunc_Function]
 :Arguments: {interpHandle, xFunc, yFunc}
 :ArgumentTypes: {Integer, Manual}
-:ReturnType: Integer
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPIntegrateCurve
+:Pattern: IntegrateCurve[handle_Integer, t0_Real, t1_Real, n_Integer]
+:Arguments: {handle, t0, t1, n}
+:ArgumentTypes: {Integer, Real, Real, Integer}
+:ReturnType: Real
+:End:
+
+:Begin:
+:Function: WSTPIntegrateCurveArcLength
+:Pattern: IntegrateCurveArcLength[handle_Integer, t0_Real, t1_Real, n_Integer]
+:Arguments: {handle, t0, t1, n}
+:ArgumentTypes: {Integer, Real, Real, Integer}
+:ReturnType: Real
+:End:
+
+:Begin:
+:Function: WSTPCreateTensorInterpolator
+:Pattern: CreateTensorInterpolator[array_]
+:Arguments: {Developer`ToPackedArray[N[array]]}
+:ArgumentTypes: {Manual}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolateTensorList
+:Pattern: InterpolateTensorList[handle_Integer, points_]
+:Arguments: {handle, Developer`ToPackedArray[N[points]]}
+:ArgumentTypes: {Integer, Manual}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPDeleteTensorInterpolator
+:Pattern: DeleteTensorInterpolator[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPCreatePyramid
+:Pattern: CreatePyramid[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolatePyramid
+:Pattern: InterpolatePyramid[handle_Integer, x_?NumericQ, y_?NumericQ, footprint_?NumericQ]
+:Arguments: {handle, N[x], N[y], N[footprint]}
+:ArgumentTypes: {Integer, Real, Real, Real}
+:ReturnType: Real
+:End:
+
+:Begin:
+:Function: WSTPIntegratePyramidCurve
+:Pattern: IntegratePyramidCurve[handle_Integer, xFunc_Function, yFunc_Function, t0_Real, t1_Real, tol_Real]
+:Arguments: {handle, t0, t1, tol, xFunc, yFunc}
+:ArgumentTypes: {Integer, Real, Real, Real, Manual}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPDeletePyramid
+:Pattern: DeletePyramid[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPCreateBoundHierarchy
+:Pattern: CreateBoundHierarchy[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSurfaceMaximum
+:Pattern: SurfaceMaximum[handle_Integer, tol_?NumericQ]
+:Arguments: {handle, N[tol]}
+:ArgumentTypes: {Integer, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSurfaceMinimum
+:Pattern: SurfaceMinimum[handle_Integer, tol_?NumericQ]
+:Arguments: {handle, N[tol]}
+:ArgumentTypes: {Integer, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPLevelSetCells
+:Pattern: LevelSetCells[handle_Integer, level_?NumericQ]
+:Arguments: {handle, N[level]}
+:ArgumentTypes: {Integer, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPThresholdCells
+:Pattern: ThresholdCells[handle_Integer, t_?NumericQ]
+:Arguments: {handle, N[t]}
+:ArgumentTypes: {Integer, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPDeleteBoundHierarchy
+:Pattern: DeleteBoundHierarchy[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPCreateFrameStack
+:Pattern: CreateFrameStack[rows_Integer, cols_Integer, capacity_Integer]
+:Arguments: {rows, cols, capacity}
+:ArgumentTypes: {Integer, Integer, Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPPushFrame
+:Pattern: PushFrame[handle_Integer, t_?NumericQ, frame_]
+:Arguments: {handle, N[t], Developer`ToPackedArray[N[frame]]}
+:ArgumentTypes: {Integer, Real, Manual}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolateSpaceTime
+:Pattern: InterpolateSpaceTime[handle_Integer, x_?NumericQ, y_?NumericQ, t_?NumericQ]
+:Arguments: {handle, N[x], N[y], N[t]}
+:ArgumentTypes: {Integer, Real, Real, Real}
+:ReturnType: Real
+:End:
+
+:Begin:
+:Function: WSTPFrameTimeRange
+:Pattern: FrameTimeRange[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPDeleteFrameStack
+:Pattern: DeleteFrameStack[handle_Integer]
+:Arguments: {handle}
+:ArgumentTypes: {Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPStartSharedMemoryServer
+:Pattern: StartSharedMemoryServer[name_String, slots_Integer, capacity_Integer]
+:Arguments: {name, slots, capacity}
+:ArgumentTypes: {String, Integer, Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPStopSharedMemoryServer
+:Pattern: StopSharedMemoryServer[]
+:Arguments: {}
+:ArgumentTypes: {}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPIntegrateSimpsonAsync
+:Pattern: IntegrateSimpsonAsync[handle_Integer, a_Real, b_Real]
+:Arguments: {handle, a, b}
+:ArgumentTypes: {Integer, Real, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPIntegrateCurveAsync
+:Pattern: IntegrateCurveAsync[handle_Integer, t0_Real, t1_Real, n_Integer]
+:Arguments: {handle, t0, t1, n}
+:ArgumentTypes: {Integer, Real, Real, Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPIntegrateCurveArcLengthAsync
+:Pattern: IntegrateCurveArcLengthAsync[handle_Integer, t0_Real, t1_Real, n_Integer]
+:Arguments: {handle, t0, t1, n}
+:ArgumentTypes: {Integer, Real, Real, Integer}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPJobStatus
+:Pattern: JobStatus[job_Integer]
+:Arguments: {job}
+:ArgumentTypes: {Integer64}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPJobResult
+:Pattern: JobResult[job_Integer]
+:Arguments: {job}
+:ArgumentTypes: {Integer64}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPCancelJob
+:Pattern: CancelJob[job_Integer]
+:Arguments: {job}
+:ArgumentTypes: {Integer64}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolatorStats
+:Pattern: InterpolatorStats[]
+:Arguments: {}
+:ArgumentTypes: {}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPInterpolatorStatsDump
+:Pattern: InterpolatorStatsDump[file_String, seconds_?NumericQ]
+:Arguments: {file, N[seconds]}
+:ArgumentTypes: {String, Real}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSetStrictMode
+:Pattern: SetStrictMode[flag:(True | False)]
+:Arguments: {ToString[flag]}
+:ArgumentTypes: {String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPSetTracing
+:Pattern: SetTracing[flag:(True | False)]
+:Arguments: {ToString[flag]}
+:ArgumentTypes: {String}
+:ReturnType: Manual
+:End:
+
+:Begin:
+:Function: WSTPExportTrace
+:Pattern: ExportTrace[file_String]
+:Arguments: {file}
+:ArgumentTypes: {String}
+:ReturnType: Manual
 :End:
 
 :Evaluate: End[]
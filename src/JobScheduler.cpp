@@ -0,0 +1,214 @@
+#include "JobScheduler.h"
+
+#include <algorithm>
+#include <exception>
+
+/*!
+ * \brief Запускает пул.
+ * \param[in] threads Количество рабочих потоков; 0 — по числу ядер.
+ */
+JobScheduler::JobScheduler(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(&JobScheduler::workerLoop, this);
+  }
+}
+
+/*!
+ * \brief Останавливает пул.
+ *
+ * \details
+ * Задания из очереди отменяются, выполняющиеся получают запрос на отмену;
+ * деструктор ждет завершения всех рабочих потоков.
+ */
+JobScheduler::~JobScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (auto& entry : jobs_) {
+      entry.second->context.cancelled_.store(true);
+      if (entry.second->status == Status::Pending) {
+        entry.second->status = Status::Cancelled;
+      }
+    }
+    queue_.clear();
+  }
+  queueReady_.notify_all();
+  jobFinished_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+JobScheduler::JobId JobScheduler::submit(Task task) {
+  auto job = std::make_shared<Job>();
+  job->task = std::move(task);
+
+  JobId id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = nextId_++;
+    jobs_.emplace(id, std::move(job));
+    queue_.push_back(id);
+  }
+  queueReady_.notify_one();
+  return id;
+}
+
+JobScheduler::Status JobScheduler::status(JobId id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  return it == jobs_.end() ? Status::Unknown : it->second->status;
+}
+
+/*!
+ * \brief Отменяет задание.
+ * \return false, если задание неизвестно или уже завершено.
+ *
+ * \details
+ * Задание из очереди не будет запущено. Выполняющееся задание видит
+ * JobContext::cancelled(); его результат будет отброшен.
+ */
+bool JobScheduler::cancel(JobId id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it == jobs_.end() || finished(it->second->status)) return false;
+
+  Job& job = *it->second;
+  job.context.cancelled_.store(true);
+  if (job.status == Status::Pending) {
+    job.status = Status::Cancelled;
+    queue_.erase(std::find(queue_.begin(), queue_.end(), id));
+    retire(id);
+    jobFinished_.notify_all();
+  }
+  return true;
+}
+
+// Забирает завершенное задание; вызывается под mutex_
+JobScheduler::Result JobScheduler::take(JobId id) {
+  auto it = jobs_.find(id);
+  Result result;
+  result.status = it->second->status;
+  result.value = it->second->value;
+  result.error = std::move(it->second->error);
+  jobs_.erase(it);
+  return result;
+}
+
+// Учитывает завершенное задание и забывает самые старые незабранные;
+// вызывается под mutex_
+void JobScheduler::retire(JobId id) {
+  finished_.push_back(id);
+  while (finished_.size() > kMaxUnfetched) {
+    auto it = jobs_.find(finished_.front());
+    if (it != jobs_.end() && it->second->waiters == 0) jobs_.erase(it);
+    finished_.pop_front();
+  }
+}
+
+/*!
+ * \brief Забирает результат, если задание завершено.
+ * \return false, если задание еще в очереди или выполняется; в result
+ * тогда записывается только текущий статус.
+ */
+bool JobScheduler::tryFetch(JobId id, Result& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it == jobs_.end() || !finished(it->second->status)) {
+    result = Result();
+    if (it != jobs_.end()) result.status = it->second->status;
+    return false;
+  }
+  result = take(id);
+  return true;
+}
+
+/*!
+ * \brief Ждет завершения задания и забирает результат.
+ * \return Статус Unknown, если задание неизвестно или его результат
+ * забрал другой вызов.
+ */
+JobScheduler::Result JobScheduler::wait(JobId id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it == jobs_.end()) return Result();
+
+  std::shared_ptr<Job> job = it->second;
+  ++job->waiters;
+  jobFinished_.wait(lock, [&] { return finished(job->status); });
+  --job->waiters;
+  // Пока поток ждал, задание мог забрать другой wait или tryFetch
+  if (jobs_.find(id) == jobs_.end()) return Result();
+  return take(id);
+}
+
+size_t JobScheduler::pendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+const char* JobScheduler::statusName(Status status) {
+  switch (status) {
+    case Status::Pending:
+      return "Pending";
+    case Status::Running:
+      return "Running";
+    case Status::Done:
+      return "Done";
+    case Status::Failed:
+      return "Failed";
+    case Status::Cancelled:
+      return "Cancelled";
+    case Status::Unknown:
+      break;
+  }
+  return "Unknown";
+}
+
+void JobScheduler::workerLoop() {
+  while (true) {
+    JobId id;
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queueReady_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) return;
+      id = queue_.front();
+      job = jobs_.at(id);
+      queue_.pop_front();
+      job->status = Status::Running;
+    }
+
+    double value = 0.0;
+    std::string error;
+    bool failed = false;
+    try {
+      value = job->task(job->context);
+    } catch (const std::exception& e) {
+      failed = true;
+      error = e.what();
+    } catch (...) {
+      failed = true;
+      error = "Unknown error";
+    }
+    // Замыкание может удерживать крупные объекты: отпускаем их сразу
+    job->task = nullptr;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (job->context.cancelled()) {
+        job->status = Status::Cancelled;
+      } else if (failed) {
+        job->status = Status::Failed;
+        job->error = std::move(error);
+      } else {
+        job->status = Status::Done;
+        job->value = value;
+      }
+      retire(id);
+    }
+    jobFinished_.notify_all();
+  }
+}
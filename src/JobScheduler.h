@@ -0,0 +1,110 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \class JobContext
+ * \brief Состояние задания, доступное самой задаче.
+ *
+ * Отмена кооперативная: длинная задача может периодически проверять
+ * cancelled() и завершаться досрочно. Результат отмененного задания
+ * отбрасывается в любом случае.
+ */
+class JobContext {
+ public:
+  bool cancelled() const {
+    return cancelled_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend class JobScheduler;
+  std::atomic<bool> cancelled_{false};
+};
+
+/*!
+ * \class JobScheduler
+ * \brief Пул потоков с заданиями, идентифицируемыми целыми числами.
+ *
+ * submit сразу возвращает номер задания; результат забирается позже через
+ * tryFetch (без ожидания) или wait. Забранное задание удаляется из таблицы.
+ * Из завершенных, но не забранных заданий хранятся kMaxUnfetched
+ * последних: более старые забываются (статус Unknown), если их результат
+ * никто не ждет в wait.
+ * Планировщик не зависит от WSTP: асинхронные точки входа в
+ * WSTPFunctions.cpp лишь ставят в очередь замыкания над объектами из
+ * таблиц дескрипторов.
+ */
+class JobScheduler {
+ public:
+  typedef std::int64_t JobId;
+  typedef std::function<double(const JobContext&)> Task;
+
+  enum class Status { Pending, Running, Done, Failed, Cancelled, Unknown };
+
+  //! Итог задания: значение для Done, текст ошибки для Failed
+  struct Result {
+    Status status = Status::Unknown;
+    double value = 0.0;
+    std::string error;
+  };
+
+  explicit JobScheduler(size_t threads = 0);
+  ~JobScheduler();
+  JobScheduler(const JobScheduler&) = delete;
+  JobScheduler& operator=(const JobScheduler&) = delete;
+
+  JobId submit(Task task);
+  Status status(JobId id) const;
+  bool cancel(JobId id);
+
+  bool tryFetch(JobId id, Result& result);
+  Result wait(JobId id);
+
+  size_t threadCount() const { return workers_.size(); }
+  size_t pendingCount() const;
+
+  static const char* statusName(Status status);
+
+  //! Сколько незабранных результатов хранится
+  static constexpr size_t kMaxUnfetched = 4096;
+
+ private:
+  struct Job {
+    Task task;
+    Status status = Status::Pending;
+    double value = 0.0;
+    std::string error;
+    JobContext context;
+    size_t waiters = 0;  //!< Вызовы wait, ожидающие это задание
+  };
+
+  void workerLoop();
+  static bool finished(Status status) {
+    return status == Status::Done || status == Status::Failed ||
+           status == Status::Cancelled;
+  }
+  Result take(JobId id);
+  void retire(JobId id);
+
+  mutable std::mutex mutex_;
+  std::condition_variable queueReady_;
+  std::condition_variable jobFinished_;
+  std::deque<JobId> queue_;
+  //! Завершенные задания в порядке завершения (могут быть уже забраны)
+  std::deque<JobId> finished_;
+  std::unordered_map<JobId, std::shared_ptr<Job>> jobs_;
+  JobId nextId_ = 1;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+#endif
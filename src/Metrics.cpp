@@ -0,0 +1,343 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuDispatch.h"
+#include "GridStore.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+std::uint64_t ShardedCounter::value() const {
+  std::uint64_t total = 0;
+  for (const Shard& shard : shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+// Потоки получают ячейки по кругу при первом обращении
+size_t ShardedCounter::shardIndex() {
+  static std::atomic<size_t> nextShard{0};
+  thread_local const size_t shard =
+      nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return shard;
+}
+
+namespace {
+
+// Номер старшего единичного бита, value != 0
+int highestBit(std::uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<int>(index);
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+}  // namespace
+
+size_t LatencyHistogram::bucketIndex(std::uint64_t value) {
+  const std::uint64_t exact = 2u << kSubBucketBits;
+  if (value < exact) return static_cast<size_t>(value);
+
+  const int exponent = highestBit(value);
+  const int shift = exponent - kSubBucketBits;
+  const size_t sub =
+      static_cast<size_t>(value >> shift) & ((1u << kSubBucketBits) - 1);
+  return static_cast<size_t>(exact) +
+         static_cast<size_t>(exponent - kSubBucketBits - 1) *
+             (1u << kSubBucketBits) +
+         sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+  const size_t exact = 2u << kSubBucketBits;
+  if (index < exact) return index;
+
+  const size_t offset = index - exact;
+  const int shift = static_cast<int>(offset >> kSubBucketBits) + 1;
+  const std::uint64_t sub = offset & ((1u << kSubBucketBits) - 1);
+  const std::uint64_t lower = ((1ull << kSubBucketBits) + sub) << shift;
+  return lower + ((1ull << shift) - 1);
+}
+
+void LatencyHistogram::record(std::uint64_t value) {
+  buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::count() const {
+  std::uint64_t total = 0;
+  for (const auto& bucket : buckets_) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::uint64_t LatencyHistogram::quantile(double q) const {
+  const std::uint64_t total = count();
+  if (total == 0) return 0;
+
+  const std::uint64_t rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(std::min(1.0, std::max(0.0, q)) * total +
+                                    0.5));
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return bucketUpperBound(i);
+  }
+  return bucketUpperBound(kBuckets - 1);
+}
+
+void LatencyHistogram::mergeInto(LatencyHistogram& target) const {
+  for (size_t i = 0; i < kBuckets; ++i) {
+    const std::uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+    if (n != 0) target.buckets_[i].fetch_add(n, std::memory_order_relaxed);
+  }
+  target.sum_.fetch_add(sum(), std::memory_order_relaxed);
+}
+
+Metrics& Metrics::instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+Metrics::~Metrics() { stopDump(); }
+
+/*!
+ * \brief Метрики пары (точка входа, дескриптор).
+ *
+ * \details
+ * Последняя найденная пара запоминается в потоке: повторные вызовы с тем же
+ * дескриптором не захватывают мьютекс. forget сбрасывает эти кэши через
+ * счетчик эпох.
+ */
+std::shared_ptr<EntryMetrics> Metrics::entry(EntryPoint point, int handle) {
+  struct Cached {
+    const Metrics* owner = nullptr;
+    std::uint64_t id = 0;
+    std::uint64_t epoch = 0;
+    std::shared_ptr<EntryMetrics> metrics;
+  };
+  thread_local Cached cached;
+
+  const std::uint64_t id = key(point, handle);
+  const std::uint64_t epoch = epoch_.load(std::memory_order_acquire);
+  if (cached.owner == this && cached.id == id && cached.epoch == epoch) {
+    return cached.metrics;
+  }
+
+  std::shared_ptr<EntryMetrics> metrics;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    if (it != entries_.end()) metrics = it->second;
+  }
+  if (!metrics) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto& slot = entries_[id];
+    if (!slot) slot = std::make_shared<EntryMetrics>();
+    metrics = slot;
+  }
+  cached = {this, id, epoch, metrics};
+  return metrics;
+}
+
+/*!
+ * \brief Удаляет метрики дескриптора.
+ *
+ * \details
+ * Можно вызывать, пока для дескриптора выполняются MetricsScope (например,
+ * на потоке сервера общей памяти): они владеют метриками совместно и
+ * досчитывают в уже удаленную запись.
+ */
+void Metrics::forget(EntryPoint point, int handle) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (entries_.erase(key(point, handle)) != 0) {
+    epoch_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+const char* Metrics::entryName(EntryPoint point) {
+  switch (point) {
+    case EntryPoint::Create:
+      return "create";
+    case EntryPoint::Point:
+      return "point";
+    case EntryPoint::Batch:
+      return "batch";
+    case EntryPoint::Simpson:
+      return "simpson";
+    case EntryPoint::Curve:
+      return "curve";
+    case EntryPoint::kCount:
+      break;
+  }
+  return "unknown";
+}
+
+/*!
+ * \brief Текущие метрики в текстовом формате Prometheus.
+ *
+ * \details
+ * Для каждой пары (точка входа, дескриптор) выводятся счетчики и сводка
+ * задержек с квантилями 0.5, 0.9, 0.99 и 0.999. Счетчики выводятся только
+ * по дескрипторам: суммы по точке входа считает Prometheus, и
+ * sum(bicubic_calls_total) не учитывает вызовы дважды. Квантили же не
+ * складываются, поэтому задержки всех дескрипторов точки входа выводятся
+ * отдельной сводкой bicubic_entry_latency_seconds.
+ */
+std::string Metrics::prometheusText() const {
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+  struct Row {
+    std::string labels;
+    std::uint64_t calls, points, outOfRange, failures;
+    const LatencyHistogram* latency;
+  };
+  std::vector<Row> rows;
+  std::map<int, std::unique_ptr<LatencyHistogram>> totals;
+
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::map<std::uint64_t, const EntryMetrics*> sorted;
+  for (const auto& entry : entries_) {
+    sorted.emplace(entry.first, entry.second.get());
+  }
+
+  for (const auto& entry : sorted) {
+    const int point = static_cast<int>(entry.first >> 32);
+    const int handle = static_cast<int>(entry.first & 0xffffffffu);
+    const EntryMetrics& m = *entry.second;
+
+    auto& total = totals[point];
+    if (!total) total = std::make_unique<LatencyHistogram>();
+    m.latencyNs.mergeInto(*total);
+
+    rows.push_back({std::string("entry=\"") +
+                        entryName(static_cast<EntryPoint>(point)) +
+                        "\",handle=\"" + std::to_string(handle) + "\"",
+                    m.calls.value(), m.points.value(), m.outOfRange.value(),
+                    m.failures.value(), &m.latencyNs});
+  }
+
+  std::ostringstream out;
+  auto counter = [&](const char* name, const char* help,
+                     std::uint64_t Row::*field) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name
+        << " counter\n";
+    for (const Row& row : rows) {
+      out << name << '{' << row.labels << "} " << row.*field << '\n';
+    }
+  };
+  out << "# HELP bicubic_kernel_variant Compute kernel variant in use.\n"
+      << "# TYPE bicubic_kernel_variant gauge\n"
+      << "bicubic_kernel_variant{variant=\"" << CpuDispatch::variantName()
+      << "\",detected=\"" << CpuDispatch::isaName(CpuDispatch::detected())
+      << "\"} 1\n";
+  const GridStore& grids = GridStore::instance();
+  out << "# HELP bicubic_grid_bytes Bytes of distinct dense grids.\n"
+      << "# TYPE bicubic_grid_bytes gauge\n"
+      << "bicubic_grid_bytes " << grids.uniqueBytes() << '\n'
+      << "# HELP bicubic_grid_bytes_saved Bytes not stored again because "
+         "handles share identical grids.\n"
+      << "# TYPE bicubic_grid_bytes_saved gauge\n"
+      << "bicubic_grid_bytes_saved " << grids.bytesSaved() << '\n'
+      << "# HELP bicubic_grid_dedup_hits_total New grids found identical to "
+         "an existing one.\n"
+      << "# TYPE bicubic_grid_dedup_hits_total counter\n"
+      << "bicubic_grid_dedup_hits_total " << grids.hits() << '\n';
+  counter("bicubic_calls_total", "Calls per entry point.", &Row::calls);
+  counter("bicubic_points_total", "Points evaluated.", &Row::points);
+  counter("bicubic_out_of_range_total",
+          "Points clamped to the grid because they were outside it.",
+          &Row::outOfRange);
+  counter("bicubic_failures_total", "Calls that returned $Failed or NaN.",
+          &Row::failures);
+
+  auto summary = [&](const char* name, const char* help,
+                     const std::vector<std::pair<std::string,
+                                                 const LatencyHistogram*>>&
+                         series) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name
+        << " summary\n";
+    for (const auto& entry : series) {
+      const LatencyHistogram& latency = *entry.second;
+      for (double q : quantiles) {
+        out << name << '{' << entry.first << ",quantile=\"" << q << "\"} "
+            << latency.quantile(q) * 1e-9 << '\n';
+      }
+      out << name << "_sum{" << entry.first << "} " << latency.sum() * 1e-9
+          << '\n'
+          << name << "_count{" << entry.first << "} " << latency.count()
+          << '\n';
+    }
+  };
+  std::vector<std::pair<std::string, const LatencyHistogram*>> series;
+  for (const Row& row : rows) series.emplace_back(row.labels, row.latency);
+  summary("bicubic_latency_seconds", "Call latency per handle.", series);
+  series.clear();
+  for (const auto& total : totals) {
+    series.emplace_back(std::string("entry=\"") +
+                            entryName(static_cast<EntryPoint>(total.first)) +
+                            "\"",
+                        total.second.get());
+  }
+  summary("bicubic_entry_latency_seconds", "Call latency over all handles.",
+          series);
+  return out.str();
+}
+
+/*!
+ * \brief Запускает периодическую запись prometheusText() в файл.
+ * \param[in] path Файл; заменяется целиком при каждой записи.
+ * \param[in] intervalSeconds Период; значение <= 0 только останавливает
+ * текущую выгрузку.
+ */
+void Metrics::startDump(const std::string& path, double intervalSeconds) {
+  stopDump();
+  if (intervalSeconds <= 0) return;
+
+  std::lock_guard<std::mutex> lock(dumpMutex_);
+  dumpStop_ = false;
+  dumpThread_ = std::thread(
+      &Metrics::dumpLoop, this, path,
+      std::chrono::milliseconds(static_cast<long long>(intervalSeconds * 1000)));
+}
+
+void Metrics::stopDump() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(dumpMutex_);
+    dumpStop_ = true;
+    thread = std::move(dumpThread_);
+  }
+  dumpWake_.notify_all();
+  if (thread.joinable()) thread.join();
+}
+
+void Metrics::dumpLoop(std::string path, std::chrono::milliseconds interval) {
+  const std::string partial = path + ".partial";
+  std::unique_lock<std::mutex> lock(dumpMutex_);
+  while (!dumpWake_.wait_for(lock, interval, [this] { return dumpStop_; })) {
+    lock.unlock();
+    {
+      std::ofstream out(partial, std::ios::trunc);
+      out << prometheusText();
+    }
+    // Читатель файла никогда не видит его недописанным
+    std::error_code error;
+    std::filesystem::rename(partial, path, error);
+    lock.lock();
+  }
+}
@@ -0,0 +1,176 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/*!
+ * \file Metrics.h
+ * \brief Счетчики вызовов и гистограммы задержек по дескрипторам и точкам
+ * входа.
+ *
+ * При сборке с BICUBIC_DISABLE_METRICS MetricsScope превращается в пустой
+ * класс со встроенными пустыми методами, и инструментирование не стоит
+ * ничего. Остальные классы при этом доступны, но не получают данных.
+ */
+
+//! Инструментированные точки входа
+enum class EntryPoint { Create, Point, Batch, Simpson, Curve, kCount };
+
+/*!
+ * \class ShardedCounter
+ * \brief Счетчик, разнесенный по нескольким строкам кэша.
+ *
+ * Каждый поток увеличивает свою ячейку, поэтому параллельные вызовы не
+ * борются за одну строку кэша; value() суммирует ячейки.
+ */
+class ShardedCounter {
+ public:
+  void add(std::uint64_t n = 1) {
+    shards_[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+  std::uint64_t value() const;
+
+  static constexpr size_t kShards = 16;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+  static size_t shardIndex();
+
+  std::array<Shard, kShards> shards_;
+};
+
+/*!
+ * \class LatencyHistogram
+ * \brief Логарифмически-линейная гистограмма (в духе HdrHistogram).
+ *
+ * Значения до 32 хранятся точно, далее каждая октава делится на 16
+ * интервалов, так что относительная погрешность квантилей не больше 1/16
+ * во всем диапазоне uint64. Запись — два атомарных сложения без
+ * блокировок (интервал и сумма); читатель может увидеть одно без другого.
+ */
+class LatencyHistogram {
+ public:
+  void record(std::uint64_t value);
+
+  std::uint64_t count() const;
+  std::uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  //! Верхняя граница интервала, содержащего квантиль q (0 <= q <= 1)
+  std::uint64_t quantile(double q) const;
+  void mergeInto(LatencyHistogram& target) const;
+
+  static constexpr int kSubBucketBits = 4;
+  static constexpr size_t kBuckets =
+      (2 << kSubBucketBits) + (64 - kSubBucketBits - 1) * (1 << kSubBucketBits);
+
+  static size_t bucketIndex(std::uint64_t value);
+  static std::uint64_t bucketUpperBound(size_t index);
+
+ private:
+  std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+  std::atomic<std::uint64_t> sum_{0};
+};
+
+//! Метрики одной точки входа одного дескриптора
+struct EntryMetrics {
+  ShardedCounter calls;
+  ShardedCounter points;
+  ShardedCounter outOfRange;
+  ShardedCounter failures;
+  LatencyHistogram latencyNs;
+};
+
+/*!
+ * \class Metrics
+ * \brief Реестр метрик процесса и периодическая выгрузка в формате
+ * Prometheus.
+ */
+class Metrics {
+ public:
+  static Metrics& instance();
+  ~Metrics();
+
+  //! Метрики (точка входа, дескриптор); создаются при первом обращении.
+  //! Ссылка остается действительной и после forget
+  std::shared_ptr<EntryMetrics> entry(EntryPoint point, int handle);
+  void forget(EntryPoint point, int handle);
+
+  std::string prometheusText() const;
+
+  void startDump(const std::string& path, double intervalSeconds);
+  void stopDump();
+
+  static const char* entryName(EntryPoint point);
+
+ private:
+  Metrics() = default;
+  void dumpLoop(std::string path, std::chrono::milliseconds interval);
+
+  static std::uint64_t key(EntryPoint point, int handle) {
+    return (static_cast<std::uint64_t>(point) << 32) |
+           static_cast<std::uint32_t>(handle);
+  }
+
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<std::uint64_t, std::shared_ptr<EntryMetrics>> entries_;
+  std::atomic<std::uint64_t> epoch_{0};
+
+  std::mutex dumpMutex_;
+  std::condition_variable dumpWake_;
+  bool dumpStop_ = false;
+  std::thread dumpThread_;
+};
+
+#ifndef BICUBIC_DISABLE_METRICS
+/*!
+ * \class MetricsScope
+ * \brief Учитывает один вызов точки входа: число вызовов и время от
+ * создания до разрушения.
+ */
+class MetricsScope {
+ public:
+  MetricsScope(EntryPoint point, int handle)
+      : metrics_(Metrics::instance().entry(point, handle)),
+        start_(std::chrono::steady_clock::now()) {}
+  ~MetricsScope() {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    metrics_->calls.add();
+    metrics_->latencyNs.record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+            .count()));
+  }
+  MetricsScope(const MetricsScope&) = delete;
+  MetricsScope& operator=(const MetricsScope&) = delete;
+
+  void addPoints(std::uint64_t n) { metrics_->points.add(n); }
+  void addOutOfRange(std::uint64_t n) {
+    if (n != 0) metrics_->outOfRange.add(n);
+  }
+  void fail() { metrics_->failures.add(); }
+
+ private:
+  // Совместное владение: forget на другом потоке не разрушает метрики,
+  // пока вызов не завершится
+  std::shared_ptr<EntryMetrics> metrics_;
+  std::chrono::steady_clock::time_point start_;
+};
+#else
+class MetricsScope {
+ public:
+  MetricsScope(EntryPoint, int) {}
+  void addPoints(std::uint64_t) {}
+  void addOutOfRange(std::uint64_t) {}
+  void fail() {}
+};
+#endif
+#endif
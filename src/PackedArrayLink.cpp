@@ -0,0 +1,292 @@
+#include "PackedArrayLink.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "Trace.h"
+
+bool FakePackedArrayLink::getRealArray(const double*& data,
+                                       std::vector<int>& dims) {
+  data = input_.data();
+  dims = inputDims_;
+  return true;
+}
+
+bool FakePackedArrayLink::putRealArray(const double* data,
+                                       const std::vector<int>& dims) {
+  size_t count = 1;
+  for (int d : dims) count *= static_cast<size_t>(d);
+  output_.assign(data, data + count);
+  outputDims_ = dims;
+  return true;
+}
+
+bool FakePackedArrayLink::putSymbol(const std::string& symbol) {
+  symbol_ = symbol;
+  return true;
+}
+
+/*!
+ * \brief Читает массив точек n x 2, интерполирует и отправляет ответ.
+ * \param[in] link Ссылка с упакованным массивом точек.
+ * \param[in] interpolator Интерполятор.
+ * \param[out] points Если задан, получает количество точек.
+ * \param[out] outside Если задан, получает количество точек вне сетки.
+ * \return true, если ответ — массив из n значений; false, если
+ * отправлен $Failed.
+ *
+ * \details
+ * Весь список читается одним вызовом и отправляется одним вызовом, так
+ * что число транзакций по ссылке не зависит от количества точек.
+ */
+bool InterpolateListOverLink(PackedArrayLink& link,
+                             const BicubicInterpolator& interpolator,
+                             size_t* points, size_t* outside) {
+  const double* xy = nullptr;
+  std::vector<int> dims;
+  bool received;
+  {
+    TraceSpan span("link.decode");
+    received = link.getRealArray(xy, dims);
+  }
+  if (!received) {
+    link.putSymbol("$Failed");
+    return false;
+  }
+
+  if (dims.size() != 2 || dims[1] != 2) {
+    link.releaseRealArray();
+    link.putSymbol("$Failed");
+    return false;
+  }
+
+  const int n = dims[0];
+  std::vector<double> values;
+  size_t clamped;
+  try {
+    values.resize(static_cast<size_t>(n));
+    clamped = interpolator.interpolateBatch(xy, values.data(), values.size());
+  } catch (...) {
+    link.releaseRealArray();
+    throw;
+  }
+  link.releaseRealArray();
+  if (points) *points = values.size();
+  if (outside) *outside = clamped;
+
+  TraceSpan span("link.encode");
+  return link.putRealArray(values.data(), {n});
+}
+
+/*!
+ * \brief Транспонирует матрицу Mathematica внутрь сетки с рамкой.
+ * \param[in] matrix Матрица rows x cols по строкам.
+ * \param[out] grid Сетка (cols + 2) x (rows + 2) по строкам; заполняется
+ * только внутренняя часть, рамка остается как есть.
+ *
+ * \details
+ * Узел (x, y) сетки — элемент m[[x, y]] матрицы (индексы с 1), как при
+ * создании интерполятора.
+ */
+void TransposeIntoPadded(const double* matrix, int rows, int cols,
+                         double* grid) {
+  const size_t gridCols = static_cast<size_t>(rows) + 2;
+  // Транспонирование блоками, чтобы и чтение, и запись оставались в кэше
+  const size_t kBlock = 32;
+  const size_t n = static_cast<size_t>(rows);
+  const size_t m = static_cast<size_t>(cols);
+  for (size_t i0 = 0; i0 < n; i0 += kBlock) {
+    const size_t iEnd = std::min(n, i0 + kBlock);
+    for (size_t j0 = 0; j0 < m; j0 += kBlock) {
+      const size_t jEnd = std::min(m, j0 + kBlock);
+      for (size_t j = j0; j < jEnd; ++j) {
+        double* target = grid + (j + 1) * gridCols + 1;
+        for (size_t i = i0; i < iEnd; ++i) target[i] = matrix[i * m + j];
+      }
+    }
+  }
+}
+
+/*!
+ * \brief Создает интерполятор из матрицы Mathematica за один проход.
+ * \param[in] matrix Матрица rows x cols по строкам (m[[i, j]] =
+ * matrix[i * cols + j]).
+ * \param[in] rows Количество строк матрицы.
+ * \param[in] cols Количество столбцов матрицы.
+ * \param[in] kernel Ядро интерполяции.
+ * \return Интерполятор над транспонированной матрицей, окруженной рамкой
+ * из нулей шириной в один узел.
+ *
+ * \details
+ * Первый индекс матрицы Mathematica соответствует координате x, поэтому
+ * сетка транспонируется. Окончательный массив размера (cols + 2) x
+ * (rows + 2) заполняется сразу на своем месте и передается в интерполятор
+ * без дальнейших копий.
+ */
+std::unique_ptr<BicubicInterpolator> CreatePaddedInterpolator(
+    const double* matrix, int rows, int cols, CubicKernelType kernel) {
+  if (rows <= 0 || cols <= 0) {
+    throw std::invalid_argument("Input data cannot be empty");
+  }
+  TraceSpan span("grid.transpose_pad");
+
+  const size_t gridRows = static_cast<size_t>(cols) + 2;
+  const size_t gridCols = static_cast<size_t>(rows) + 2;
+  std::vector<double> grid(gridRows * gridCols, 0.0);
+  TransposeIntoPadded(matrix, rows, cols, grid.data());
+
+  return std::make_unique<BicubicInterpolator>(
+      std::move(grid), static_cast<int>(gridRows), static_cast<int>(gridCols),
+      kernel);
+}
+
+/*!
+ * \brief Читает матрицу одним упакованным массивом и создает интерполятор.
+ * \param[in] link Ссылка с вещественной матрицей глубины 2.
+ * \param[in] kernel Ядро интерполяции.
+ * \return Интерполятор или nullptr, если данные не являются матрицей.
+ */
+std::unique_ptr<BicubicInterpolator> CreateInterpolatorOverLink(
+    PackedArrayLink& link, CubicKernelType kernel) {
+  const double* matrix = nullptr;
+  std::vector<int> dims;
+  {
+    TraceSpan span("link.decode");
+    if (!link.getRealArray(matrix, dims)) return nullptr;
+  }
+
+  std::unique_ptr<BicubicInterpolator> interpolator;
+  try {
+    if (dims.size() == 2 && dims[0] > 0 && dims[1] > 0) {
+      interpolator = CreatePaddedInterpolator(matrix, dims[0], dims[1], kernel);
+    }
+  } catch (...) {
+    link.releaseRealArray();
+    throw;
+  }
+  link.releaseRealArray();
+  return interpolator;
+}
+
+namespace {
+
+/*!
+ * \brief Переставляет оси массива Mathematica в порядок TensorInterpolator.
+ *
+ * \details
+ * В массиве Mathematica быстрее всех меняется последний индекс, а первый
+ * соответствует координате x; в сетке быстрее всех меняется x. Узлы
+ * назначения перебираются подряд, смещение источника обновляется как у
+ * счетчика с переносом.
+ */
+template <int D>
+TensorInterpolator<D> createTensor(const double* array, const int* dims) {
+  typename TensorInterpolator<D>::Extents extents;
+  size_t sourceStrides[D];
+  size_t count = 1;
+  for (int d = D - 1; d >= 0; --d) {
+    extents[d] = dims[d];
+    sourceStrides[d] = count;
+    count *= static_cast<size_t>(dims[d]);
+  }
+
+  TraceSpan span("grid.transpose");
+  std::vector<double> grid(count);
+  int index[D] = {};
+  size_t source = 0;
+  for (size_t target = 0; target < count; ++target) {
+    grid[target] = array[source];
+    for (int d = 0; d < D; ++d) {
+      if (++index[d] < dims[d]) {
+        source += sourceStrides[d];
+        break;
+      }
+      index[d] = 0;
+      source -= (dims[d] - 1) * sourceStrides[d];
+    }
+  }
+  return TensorInterpolator<D>(std::move(grid), extents);
+}
+
+}  // namespace
+
+/*!
+ * \brief Читает массив глубины 3 или 4 и создает объемную сетку.
+ * \return Сетка или nullptr, если глубина или размеры не подходят.
+ *
+ * \details
+ * В отличие от CreatePaddedInterpolator, рамка из нулей не добавляется.
+ */
+std::unique_ptr<TensorGrid> CreateTensorGridOverLink(PackedArrayLink& link) {
+  const double* array = nullptr;
+  std::vector<int> dims;
+  {
+    TraceSpan span("link.decode");
+    if (!link.getRealArray(array, dims)) return nullptr;
+  }
+
+  std::unique_ptr<TensorGrid> grid;
+  const bool positive =
+      std::all_of(dims.begin(), dims.end(), [](int d) { return d > 0; });
+  try {
+    if (positive && dims.size() == 3) {
+      grid = std::make_unique<TensorGrid>(createTensor<3>(array, dims.data()));
+    } else if (positive && dims.size() == 4) {
+      grid = std::make_unique<TensorGrid>(createTensor<4>(array, dims.data()));
+    }
+  } catch (...) {
+    link.releaseRealArray();
+    throw;
+  }
+  link.releaseRealArray();
+  return grid;
+}
+
+/*!
+ * \brief Читает массив точек n x D (D — размерность сетки), интерполирует
+ * и отправляет ответ, как InterpolateListOverLink.
+ */
+bool InterpolateTensorListOverLink(PackedArrayLink& link,
+                                   const TensorGrid& grid, size_t* points,
+                                   size_t* outside) {
+  const double* coordinates = nullptr;
+  std::vector<int> dims;
+  bool received;
+  {
+    TraceSpan span("link.decode");
+    received = link.getRealArray(coordinates, dims);
+  }
+  if (!received) {
+    link.putSymbol("$Failed");
+    return false;
+  }
+
+  const int dimension = std::visit(
+      [](const auto& tensor) { return tensor.kDimension; }, grid);
+  if (dims.size() != 2 || dims[1] != dimension) {
+    link.releaseRealArray();
+    link.putSymbol("$Failed");
+    return false;
+  }
+
+  const int n = dims[0];
+  std::vector<double> values;
+  size_t clamped;
+  try {
+    values.resize(static_cast<size_t>(n));
+    clamped = std::visit(
+        [&](const auto& tensor) {
+          return tensor.interpolateBatch(coordinates, values.data(),
+                                         values.size());
+        },
+        grid);
+  } catch (...) {
+    link.releaseRealArray();
+    throw;
+  }
+  link.releaseRealArray();
+  if (points) *points = values.size();
+  if (outside) *outside = clamped;
+
+  TraceSpan span("link.encode");
+  return link.putRealArray(values.data(), {n});
+}
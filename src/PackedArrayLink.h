@@ -0,0 +1,77 @@
+#ifndef PACKEDARRAYLINK_H
+#define PACKEDARRAYLINK_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BicubicInterpolator.h"
+#include "TensorInterpolator.h"
+
+/*!
+ * \class PackedArrayLink
+ * \brief Минимальный интерфейс ссылки для обмена упакованными массивами.
+ *
+ * Логика разбора и формирования ответов (InterpolateListOverLink)
+ * работает только через этот интерфейс, поэтому ее можно проверить на
+ * FakePackedArrayLink без Mathematica. Реализация для WSTP — в
+ * WSTPFunctions.cpp.
+ */
+class PackedArrayLink {
+ public:
+  virtual ~PackedArrayLink() = default;
+
+  //! Читает упакованный вещественный массив; data действителен до release
+  virtual bool getRealArray(const double*& data, std::vector<int>& dims) = 0;
+  virtual void releaseRealArray() = 0;
+  virtual bool putRealArray(const double* data,
+                            const std::vector<int>& dims) = 0;
+  virtual bool putSymbol(const std::string& symbol) = 0;
+};
+
+/*!
+ * \class FakePackedArrayLink
+ * \brief Ссылка в памяти: отдает заданный входной массив и сохраняет ответ.
+ */
+class FakePackedArrayLink : public PackedArrayLink {
+ public:
+  FakePackedArrayLink(std::vector<double> input, std::vector<int> dims)
+      : input_(std::move(input)), inputDims_(std::move(dims)) {}
+
+  bool getRealArray(const double*& data, std::vector<int>& dims) override;
+  void releaseRealArray() override { released_ = true; }
+  bool putRealArray(const double* data, const std::vector<int>& dims) override;
+  bool putSymbol(const std::string& symbol) override;
+
+  const std::vector<double>& output() const { return output_; }
+  const std::vector<int>& outputDims() const { return outputDims_; }
+  const std::string& symbol() const { return symbol_; }
+  bool released() const { return released_; }
+
+ private:
+  std::vector<double> input_;
+  std::vector<int> inputDims_;
+  std::vector<double> output_;
+  std::vector<int> outputDims_;
+  std::string symbol_;
+  bool released_ = false;
+};
+
+void TransposeIntoPadded(const double* matrix, int rows, int cols,
+                         double* grid);
+std::unique_ptr<BicubicInterpolator> CreatePaddedInterpolator(
+    const double* matrix, int rows, int cols,
+    CubicKernelType kernel = CubicKernelType::CatmullRom);
+std::unique_ptr<BicubicInterpolator> CreateInterpolatorOverLink(
+    PackedArrayLink& link,
+    CubicKernelType kernel = CubicKernelType::CatmullRom);
+bool InterpolateListOverLink(PackedArrayLink& link,
+                             const BicubicInterpolator& interpolator,
+                             size_t* points = nullptr,
+                             size_t* outside = nullptr);
+
+std::unique_ptr<TensorGrid> CreateTensorGridOverLink(PackedArrayLink& link);
+bool InterpolateTensorListOverLink(PackedArrayLink& link,
+                                   const TensorGrid& grid,
+                                   size_t* points = nullptr,
+                                   size_t* outside = nullptr);
+#endif
@@ -0,0 +1,33 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief Выполняет body(begin, end) над частями диапазона [0, count) в
+ * threads потоках (0 — по числу ядер); часть не короче minChunk.
+ *
+ * Первая часть выполняется в вызывающем потоке.
+ */
+template <typename Body>
+void ParallelFor(size_t count, size_t threads, Body body,
+                 size_t minChunk = 64) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, std::max<size_t>(1, count / minChunk));
+  if (threads <= 1) {
+    body(size_t(0), count);
+    return;
+  }
+  std::vector<std::thread> workers;
+  const size_t chunk = (count + threads - 1) / threads;
+  for (size_t begin = chunk; begin < count; begin += chunk) {
+    workers.emplace_back(body, begin, std::min(count, begin + chunk));
+  }
+  body(size_t(0), std::min(count, chunk));
+  for (auto& worker : workers) worker.join();
+}
+#endif
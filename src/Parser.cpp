@@ -1,77 +1,97 @@
-#include <cmath>
-#include <functional>
-#include <map>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <exception>
 
+#include "BicubicInterpolator.h"
+#include "ExpressionReader.h"
+#include "Trace.h"
 #include "wstp.h"
 
-// Вспомогательная функция для парсинга аргумента
+/*!
+ * \class WSTPExpressionSource
+ * \brief Поток лексем выражения, читаемый прямо со ссылки WSTP.
+ */
+class WSTPExpressionSource : public ExpressionSource {
+ public:
+  explicit WSTPExpressionSource(WSLINK link) : link_(link) {}
 
-std::vector<std::string> WM_expression_heads_{"Plus"};
-
-void Decompose(std::string str) {
-    
-}
-
-double ParseExpression(WSLINK link) {
-  const char* head;
-  int len;
-
-  if (!WSGetFunction(link, &head, &len)) {
-    throw std::runtime_error("Failed to parse function");
+  Token peek() override {
+    if (!hasPending_) {
+      pending_ = WSGetNext(link_);
+      hasPending_ = true;
+    }
+    switch (pending_) {
+      case WSTKFUNC:
+        return Token::Function;
+      case WSTKINT:
+        return Token::Integer;
+      case WSTKREAL:
+        return Token::Real;
+      case WSTKSYM:
+        return Token::Symbol;
+      default:
+        return Token::Error;
+    }
   }
 
-  // Обработка стандартных операций
-  if (std::strcmp(head, "Plus") == 0) {
-    double a = ParseExpression(link);
-    double b = ParseExpression(link);
-    return a + b;
-  } else if (std::strcmp(head, "Times") == 0) {
-    double a = ParseExpression(link);
-    double b = ParseExpression(link);
-    return a * b;
-  } else if (std::strcmp(head, "Sin") == 0) {
-    double arg = ParseExpression(link);
-    return sin(arg);
+  bool getFunction(std::string& head, int& argCount) override {
+    if (peek() != Token::Function) return false;
+    hasPending_ = false;
+    // Голова функции — следующий объект ссылки
+    const char* symbol = nullptr;
+    if (!WSGetArgCount(link_, &argCount) || WSGetNext(link_) != WSTKSYM ||
+        !WSGetSymbol(link_, &symbol)) {
+      return false;
+    }
+    head = symbol;
+    WSReleaseSymbol(link_, symbol);
+    return true;
   }
 
-  // Обработка Slot[1] (аргумента функции #)
-  else if (std::strcmp(head, "Slot") == 0) {
-    int slot_num;
-    WSGetInteger(link, &slot_num);
-    return std::numeric_limits<double>::quiet_NaN();  // Маркер аргумента
+  bool getInteger(long long& value) override {
+    if (peek() != Token::Integer) return false;
+    hasPending_ = false;
+    wsint64 v = 0;
+    if (!WSGetInteger64(link_, &v)) return false;
+    value = static_cast<long long>(v);
+    return true;
   }
 
-  // Обработка числовых констант
-  else if (std::strcmp(head, "Real") == 0) {
-    double value;
-    WSGetReal(link, &value);
-    return value;
+  bool getReal(double& value) override {
+    if (peek() != Token::Real) return false;
+    hasPending_ = false;
+    return WSGetReal64(link_, &value) != 0;
   }
 
-  throw std::runtime_error("Unsupported operation: " + std::string(head));
-}
-
-// Основная функция парсинга
-std::function<double(double)> ParseFunctionFromWSTP() {
-  // 1. Получить выражение Function[...]
-  const char* head;
-  int len;
-  WSGetFunction(stdlink, &head, &len);
-
-  if (std::strcmp(head, "Function") != 0) {
-    throw std::runtime_error("Expected Function expression");
+  bool getSymbol(std::string& name) override {
+    if (peek() != Token::Symbol) return false;
+    hasPending_ = false;
+    const char* symbol = nullptr;
+    if (!WSGetSymbol(link_, &symbol)) return false;
+    name = symbol;
+    WSReleaseSymbol(link_, symbol);
+    return true;
   }
 
-  // 2. Парсим тело функции
-  double result = ParseExpression(stdlink);
+ private:
+  WSLINK link_;
+  int pending_ = 0;
+  bool hasPending_ = false;
+};
 
-  // 3. Собираем лямбда-функцию
-  return [](double x) {
-    // Здесь должна быть логика подстановки x вместо Slot[1]
-    // В реальной реализации нужно отслеживать позиции Slot
-    // Это упрощенный пример!
-    return x;  // Заглушка
-  };
-}
\ No newline at end of file
+/*!
+ * \brief Читает count функций со stdlink и компилирует их в одну программу.
+ * \param[in] count 1 для подынтегральной функции, 2 для кривой (x, y).
+ * \param[in] withDerivatives Добавить выходы с производными по параметру.
+ * \return Программа с выходами в порядке функций (затем производные).
+ * \throws std::runtime_error Если на ссылке нет ожидаемого выражения.
+ */
+std::shared_ptr<const BytecodeProgram> ParseFunctionsFromWSTP(
+    int count, bool withDerivatives) {
+  TraceSpan span("link.read_function");
+  WSTPExpressionSource source(stdlink);
+  ExpressionReader reader(source);
+  return std::make_shared<const BytecodeProgram>(
+      reader.compileFunctions(count, withDerivatives));
+}
@@ -0,0 +1,157 @@
+#include "SharedMemoryClient.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Шаг ожидания, после которого проверяется, что сервер еще работает
+const int kPollMs = 100;
+
+}  // namespace
+
+SharedMemoryClient::SharedMemoryClient(const std::string& name, int timeoutMs)
+    : timeoutMs_(timeoutMs) {
+#ifdef __linux__
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) throw std::runtime_error("Cannot open " + name);
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(shm_ipc::ShmHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Invalid shared-memory segment " + name);
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  void* data =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("Cannot map " + name);
+  header_ = static_cast<shm_ipc::ShmHeader*>(data);
+
+  const bool valid =
+      std::memcmp(header_->magic, shm_ipc::kMagic, sizeof(shm_ipc::kMagic)) ==
+          0 &&
+      header_->version == shm_ipc::kVersion &&
+      sizeof(shm_ipc::ShmHeader) + header_->slotCount * header_->slotBytes <=
+          size_;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!valid) {
+    munmap(header_, size_);
+    header_ = nullptr;
+    throw std::runtime_error("Invalid shared-memory segment " + name);
+  }
+#else
+  (void)name;
+  throw std::runtime_error("Shared-memory client requires Linux");
+#endif
+}
+
+SharedMemoryClient::~SharedMemoryClient() {
+#ifdef __linux__
+  if (header_) munmap(header_, size_);
+#endif
+}
+
+size_t SharedMemoryClient::slotCapacity() const {
+  return static_cast<size_t>(header_->slotCapacity);
+}
+
+// Ожидание с проверкой, что сервер не остановлен
+bool SharedMemoryClient::waitFor(std::atomic<std::uint32_t>& word,
+                                 std::uint32_t expected) {
+  for (int waited = 0; waited < timeoutMs_; waited += kPollMs) {
+    if (shm_ipc::WaitFor(word, expected,
+                         std::min(kPollMs, timeoutMs_ - waited))) {
+      return true;
+    }
+    if (header_->running.load(std::memory_order_acquire) == 0) return false;
+  }
+  return false;
+}
+
+SharedMemoryClient::Slot SharedMemoryClient::acquire() {
+  if (header_->running.load(std::memory_order_acquire) == 0) {
+    throw std::runtime_error("Shared-memory server is stopped");
+  }
+  const std::uint32_t ticket =
+      header_->tail.fetch_add(1, std::memory_order_relaxed);
+  shm_ipc::ShmSlot* slot =
+      shm_ipc::SlotAt(header_, ticket & (header_->slotCount - 1));
+  // Номер уже выдан и не отменяется: если слот так и не освободится,
+  // сервер по истечении своего срока пропустит эту заявку
+  if (!waitFor(slot->sequence, ticket)) {
+    throw std::runtime_error("Shared-memory server did not free a slot");
+  }
+  return {shm_ipc::SlotPoints(slot),
+          shm_ipc::SlotResults(slot, header_->slotCapacity), slotCapacity(),
+          ticket};
+}
+
+size_t SharedMemoryClient::evaluate(Slot& slot, int handle, size_t n) {
+  shm_ipc::ShmSlot* header =
+      shm_ipc::SlotAt(header_, slot.ticket & (header_->slotCount - 1));
+  // Слишком большую заявку все равно отправляем: сервер ждет этот номер
+  header->handle = handle;
+  header->count = n;
+  std::uint32_t expected = slot.ticket;
+  if (!header->sequence.compare_exchange_strong(expected, slot.ticket + 1,
+                                                std::memory_order_acq_rel)) {
+    throw std::runtime_error("Shared-memory server abandoned the request");
+  }
+  shm_ipc::WakeAll(header->sequence);
+  if (!waitFor(header->sequence, slot.ticket + 2)) {
+    throw std::runtime_error("Shared-memory server did not respond");
+  }
+
+  switch (header->status) {
+    case shm_ipc::kShmOk:
+      return static_cast<size_t>(header->outside);
+    case shm_ipc::kShmUnknownHandle:
+      throw std::invalid_argument("Unknown interpolator handle");
+    case shm_ipc::kShmBadRequest:
+      throw std::invalid_argument("Request exceeds slot capacity");
+    default:
+      throw std::runtime_error("Interpolation failed");
+  }
+}
+
+void SharedMemoryClient::release(Slot& slot) {
+  shm_ipc::ShmSlot* header =
+      shm_ipc::SlotAt(header_, slot.ticket & (header_->slotCount - 1));
+  // Если сервер уже забрал слот, он принадлежит следующей заявке
+  std::uint32_t expected = slot.ticket + 2;
+  if (header->sequence.compare_exchange_strong(
+          expected, slot.ticket + header_->slotCount,
+          std::memory_order_acq_rel)) {
+    shm_ipc::WakeAll(header->sequence);
+  }
+}
+
+size_t SharedMemoryClient::interpolate(int handle, const double* xy,
+                                       double* out, size_t n) {
+  size_t outside = 0;
+  for (size_t begin = 0; begin < n; begin += slotCapacity()) {
+    const size_t count = std::min(slotCapacity(), n - begin);
+    Slot slot = acquire();
+    std::copy(xy + 2 * begin, xy + 2 * (begin + count), slot.points);
+    try {
+      outside += evaluate(slot, handle, count);
+    } catch (const std::invalid_argument&) {
+      // Сервер ответил отказом: слот свободен для следующей заявки. Без
+      // ответа слот не освобождается, иначе сервер мог бы еще писать в него
+      release(slot);
+      throw;
+    }
+    std::copy(slot.results, slot.results + count, out + begin);
+    release(slot);
+  }
+  return outside;
+}
@@ -0,0 +1,76 @@
+#ifndef SHAREDMEMORYCLIENT_H
+#define SHAREDMEMORYCLIENT_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "SharedMemoryProtocol.h"
+
+/*!
+ * \class SharedMemoryClient
+ * \brief Клиент сервера интерполяции в общей памяти (SharedMemoryServer).
+ *
+ * Библиотека клиента не зависит ни от интерполятора, ни от WSTP. Без
+ * копирования:
+ * \code
+ * SharedMemoryClient client("/bicubic");
+ * SharedMemoryClient::Slot slot = client.acquire();
+ * // slot.points[2 * i], slot.points[2 * i + 1] — координаты точки i
+ * client.evaluate(slot, handle, n);
+ * // slot.results[i] — значение в точке i
+ * client.release(slot);
+ * \endcode
+ * Между acquire и evaluate, а также между ответом и release другие заявки
+ * ждут, поэтому слот нужно заполнять и освобождать сразу: слот, который
+ * клиент держит дольше срока abandonMs сервера, сервер забирает. Объект
+ * можно использовать из нескольких потоков: у каждой заявки свой слот.
+ */
+class SharedMemoryClient {
+ public:
+  struct Slot {
+    double* points;
+    double* results;
+    size_t capacity;
+    std::uint32_t ticket;
+  };
+
+  /*!
+   * \param[in] name Имя сегмента, заданное серверу.
+   * \param[in] timeoutMs Наибольшее время ожидания слота или ответа.
+   * \throws std::runtime_error Если сегмент не открывается, его формат не
+   * совпадает или система не Linux.
+   */
+  explicit SharedMemoryClient(const std::string& name, int timeoutMs = 5000);
+  ~SharedMemoryClient();
+  SharedMemoryClient(const SharedMemoryClient&) = delete;
+  SharedMemoryClient& operator=(const SharedMemoryClient&) = delete;
+
+  //! Наибольшее число точек в одной заявке
+  size_t slotCapacity() const;
+
+  //! Занимает слот для следующей заявки
+  Slot acquire();
+  /*!
+   * \brief Отправляет n точек из slot.points и ждет ответа в slot.results.
+   * \return Количество точек вне сетки.
+   * \throws std::invalid_argument Если дескриптор неизвестен или n больше
+   * емкости слота.
+   * \throws std::runtime_error Если сервер остановлен, не ответил или
+   * уже забрал слот.
+   */
+  size_t evaluate(Slot& slot, int handle, size_t n);
+  //! Освобождает слот; результаты после этого недоступны
+  void release(Slot& slot);
+
+  //! Интерполяция с копированием xy в слоты и результатов в out; пакет
+  //! больше емкости слота делится на части
+  size_t interpolate(int handle, const double* xy, double* out, size_t n);
+
+ private:
+  bool waitFor(std::atomic<std::uint32_t>& word, std::uint32_t expected);
+
+  shm_ipc::ShmHeader* header_ = nullptr;
+  size_t size_ = 0;
+  int timeoutMs_;
+};
+#endif
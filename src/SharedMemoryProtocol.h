@@ -0,0 +1,181 @@
+#ifndef SHAREDMEMORYPROTOCOL_H
+#define SHAREDMEMORYPROTOCOL_H
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/*!
+ * \file SharedMemoryProtocol.h
+ * \brief Формат сегмента общей памяти для локального обмена с сервером
+ * интерполяции (SharedMemoryServer, SharedMemoryClient).
+ *
+ * Сегмент POSIX (shm_open) начинается с заголовка ShmHeader, за которым
+ * идут slotCount слотов по slotBytes байт. Слот — заголовок ShmSlot и
+ * буферы точек (2 * slotCapacity значений x, y) и результатов
+ * (slotCapacity значений). Клиент пишет точки прямо в буфер слота, сервер
+ * читает их оттуда и пишет результаты в тот же слот: данные не копируются
+ * ни при отправке, ни при получении.
+ *
+ * Слоты образуют кольцо заявок. Клиент берет номер заявки ticket из
+ * общего счетчика tail; заявка живет в слоте ticket % slotCount, а слово
+ * sequence слота проходит значения
+ *   ticket              — слот свободен для этой заявки;
+ *   ticket + 1          — точки записаны, заявка отправлена;
+ *   ticket + 2          — результат готов;
+ *   ticket + slotCount  — слот освобожден для следующего круга.
+ * Значения различны, только если slotCount >= 4 (kMinSlots): при двух
+ * слотах «результат готов» совпадает с «освобожден», при одном еще и
+ * «освобожден» с «отправлена».
+ * Сервер обрабатывает заявки строго по порядку номеров. Если заявка
+ * ticket не отправлена за время abandonMs сервера, он забирает слот: слот,
+ * не освобожденный клиентом прошлого круга, переводится в ticket, а
+ * неотправленная заявка пропускается (sequence = ticket + slotCount, status
+ * = kShmFailed). Поэтому клиент меняет sequence только сравнением с
+ * обменом: отправка и освобождение опоздавшего клиента не затирают
+ * состояние следующей заявки. Ожидание и пробуждение — futex на слове
+ * sequence (межпроцессный, без FUTEX_PRIVATE).
+ *
+ * Работает только в Linux; на других системах конструкторы сервера и
+ * клиента бросают std::runtime_error.
+ */
+
+namespace shm_ipc {
+
+const char kMagic[8] = {'B', 'I', 'C', 'U', 'B', 'S', 'H', 'M'};
+const std::uint32_t kVersion = 1;
+//! Наименьшее число слотов, при котором состояния sequence различимы
+const std::uint32_t kMinSlots = 4;
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+              "Shared-memory words must be lock-free");
+
+struct ShmHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t slotCount;
+  std::uint64_t slotCapacity;
+  std::uint64_t slotBytes;
+  //! 1, пока сервер работает; 0 — клиенты прекращают ожидание
+  std::atomic<std::uint32_t> running;
+  //! Следующий номер заявки
+  std::atomic<std::uint32_t> tail;
+  std::uint8_t reserved[24];
+};
+static_assert(sizeof(ShmHeader) == 64,
+              "Shared-memory header must be 64 bytes");
+
+//! Коды ответа в поле status слота
+enum ShmStatus : std::int32_t {
+  kShmOk = 0,
+  kShmUnknownHandle = -1,
+  kShmBadRequest = -2,
+  kShmFailed = -3,
+};
+
+struct ShmSlot {
+  std::atomic<std::uint32_t> sequence;
+  std::int32_t handle;
+  std::uint64_t count;
+  std::int32_t status;
+  std::uint32_t reserved0;
+  //! Точки вне сетки (при status == kShmOk)
+  std::uint64_t outside;
+  std::uint8_t reserved[32];
+};
+static_assert(sizeof(ShmSlot) == 64,
+              "Shared-memory slot header must be 64 bytes");
+
+//! Размер слота с буферами, кратный строке кэша
+inline std::uint64_t SlotBytes(std::uint64_t capacity) {
+  const std::uint64_t bytes = sizeof(ShmSlot) + 3 * capacity * sizeof(double);
+  return (bytes + 63) / 64 * 64;
+}
+
+//! Слот index при размере слота slotBytes; сервер передает свой размер,
+//! а не поле заголовка, доступное клиентам на запись
+inline ShmSlot* SlotAt(ShmHeader* header, std::uint32_t index,
+                       std::uint64_t slotBytes) {
+  return reinterpret_cast<ShmSlot*>(reinterpret_cast<unsigned char*>(header) +
+                                    sizeof(ShmHeader) + index * slotBytes);
+}
+
+inline ShmSlot* SlotAt(ShmHeader* header, std::uint32_t index) {
+  return SlotAt(header, index, header->slotBytes);
+}
+
+inline double* SlotPoints(ShmSlot* slot) {
+  return reinterpret_cast<double*>(slot + 1);
+}
+
+inline double* SlotResults(ShmSlot* slot, std::uint64_t capacity) {
+  return SlotPoints(slot) + 2 * capacity;
+}
+
+//! Проверок перед засыпанием: короткий ответ сервера дешевле дождаться
+const int kSpinCount = 2000;
+
+//! На одном процессоре ожидание вращением только отнимает время у второй
+//! стороны, и ждать нужно сразу через futex
+inline int SpinCount() {
+  static const int count =
+      std::thread::hardware_concurrency() > 1 ? kSpinCount : 0;
+  return count;
+}
+
+/*!
+ * \brief Ждет, пока word не станет равным expected, или пока не истечет
+ * timeoutMs миллисекунд.
+ * \return true, если значение дождались.
+ */
+inline bool WaitFor(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+                    int timeoutMs) {
+  for (int spin = SpinCount(); spin > 0; --spin) {
+    if (word.load(std::memory_order_acquire) == expected) return true;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+#ifdef __linux__
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  for (;;) {
+    const std::uint32_t current = word.load(std::memory_order_acquire);
+    if (current == expected) return true;
+    const auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) return false;
+    const long long ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)
+            .count();
+    timespec timeout = {static_cast<time_t>(ns / 1000000000),
+                        static_cast<long>(ns % 1000000000)};
+    // Засыпает, только если слово все еще равно current
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT,
+            current, &timeout, nullptr, 0);
+  }
+#else
+  (void)timeoutMs;
+  return word.load(std::memory_order_acquire) == expected;
+#endif
+}
+
+//! Будит всех, кто ждет изменения word
+inline void WakeAll(std::atomic<std::uint32_t>& word) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE,
+          0x7fffffff, nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+}  // namespace shm_ipc
+#endif
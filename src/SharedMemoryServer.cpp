@@ -0,0 +1,195 @@
+#include "SharedMemoryServer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Metrics.h"
+#include "Trace.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Период проверки флага остановки, пока заявок нет
+const int kPollMs = 100;
+
+}  // namespace
+
+SharedMemoryServer::SharedMemoryServer(const std::string& name, Lookup lookup,
+                                       std::uint32_t slotCount,
+                                       std::uint64_t slotCapacity,
+                                       int abandonMs)
+    : name_(name),
+      lookup_(std::move(lookup)),
+      slotCount_(slotCount),
+      slotCapacity_(slotCapacity),
+      abandonMs_(abandonMs) {
+  // При slotCount < kMinSlots состояния слова sequence совпадают (см.
+  // SharedMemoryProtocol.h)
+  if (slotCount < shm_ipc::kMinSlots || (slotCount & (slotCount - 1)) != 0 ||
+      slotCapacity == 0 || abandonMs <= 0) {
+    throw std::invalid_argument(
+        "Slot count must be a power of two not less than 4, capacity and "
+        "abandon timeout positive");
+  }
+#ifdef __linux__
+  size_ = sizeof(shm_ipc::ShmHeader) +
+          slotCount * shm_ipc::SlotBytes(slotCapacity);
+  shm_unlink(name_.c_str());
+  const int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) throw std::runtime_error("Cannot create " + name_);
+  if (ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+    ::close(fd);
+    shm_unlink(name_.c_str());
+    throw std::runtime_error("Cannot allocate " + name_);
+  }
+  void* data =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    shm_unlink(name_.c_str());
+    throw std::runtime_error("Cannot map " + name_);
+  }
+
+  // Сегмент после ftruncate заполнен нулями; атомарные поля пишутся на
+  // месте, признак формата — последним
+  header_ = static_cast<shm_ipc::ShmHeader*>(data);
+  header_->version = shm_ipc::kVersion;
+  header_->slotCount = slotCount;
+  header_->slotCapacity = slotCapacity;
+  header_->slotBytes = shm_ipc::SlotBytes(slotCapacity);
+  for (std::uint32_t i = 0; i < slotCount; ++i) {
+    slotAt(i)->sequence.store(i, std::memory_order_relaxed);
+  }
+  header_->tail.store(0, std::memory_order_relaxed);
+  header_->running.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, shm_ipc::kMagic, sizeof(shm_ipc::kMagic));
+
+  thread_ = std::thread(&SharedMemoryServer::serve, this);
+#else
+  throw std::runtime_error("Shared-memory server requires Linux");
+#endif
+}
+
+SharedMemoryServer::~SharedMemoryServer() { stop(); }
+
+shm_ipc::ShmSlot* SharedMemoryServer::slotAt(std::uint32_t index) const {
+  return shm_ipc::SlotAt(header_, index, shm_ipc::SlotBytes(slotCapacity_));
+}
+
+/*!
+ * \details
+ * Клиенты, ожидающие ответа, просыпаются и видят running == 0. Отображение
+ * у клиентов остается действительным до их munmap, удаляется только имя.
+ */
+void SharedMemoryServer::stop() {
+#ifdef __linux__
+  if (!header_) return;
+  stop_.store(true);
+  if (thread_.joinable()) thread_.join();
+  header_->running.store(0, std::memory_order_release);
+  for (std::uint32_t i = 0; i < slotCount_; ++i) {
+    shm_ipc::WakeAll(slotAt(i)->sequence);
+  }
+  munmap(header_, size_);
+  shm_unlink(name_.c_str());
+  header_ = nullptr;
+#endif
+}
+
+// Заявки обслуживаются строго по номерам, как их выдает счетчик tail;
+// заявку, которую не отправили за abandonMs_, сервер забирает
+void SharedMemoryServer::serve() {
+  const std::uint32_t mask = slotCount_ - 1;
+  std::uint32_t ticket = 0;
+  int waited = 0;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    shm_ipc::ShmSlot* slot = slotAt(ticket & mask);
+    if (shm_ipc::WaitFor(slot->sequence, ticket + 1, kPollMs)) {
+      process(slot);
+      slot->sequence.store(ticket + 2, std::memory_order_release);
+      shm_ipc::WakeAll(slot->sequence);
+      ++ticket;
+      waited = 0;
+      continue;
+    }
+    waited += kPollMs;
+    if (waited < abandonMs_) continue;
+    waited = 0;
+    if (reclaim(slot, ticket)) ++ticket;
+  }
+}
+
+/*!
+ * \brief Забирает слот заявки ticket у клиента, который его задерживает.
+ * \return true, если заявка ticket пропущена.
+ *
+ * \details
+ * Слот, не освобожденный клиентом прошлого круга (ticket - slotCount + 2),
+ * переводится в ticket, и заявка ticket получает полный срок ожидания.
+ * Неотправленная заявка (или постороннее значение sequence) пропускается.
+ * Клиенты меняют sequence сравнением с обменом, поэтому если клиент успел
+ * изменить слово, сервер ничего не делает и ждет дальше.
+ */
+bool SharedMemoryServer::reclaim(shm_ipc::ShmSlot* slot,
+                                 std::uint32_t ticket) {
+  std::uint32_t current = slot->sequence.load(std::memory_order_acquire);
+  if (current == ticket + 1) return false;
+  if (current == ticket - slotCount_ + 2) {
+    if (slot->sequence.compare_exchange_strong(current, ticket,
+                                               std::memory_order_acq_rel)) {
+      shm_ipc::WakeAll(slot->sequence);
+    }
+    return false;
+  }
+  slot->status = shm_ipc::kShmFailed;
+  if (!slot->sequence.compare_exchange_strong(current, ticket + slotCount_,
+                                              std::memory_order_acq_rel)) {
+    return false;
+  }
+  abandoned_.fetch_add(1, std::memory_order_relaxed);
+  shm_ipc::WakeAll(slot->sequence);
+  return true;
+}
+
+void SharedMemoryServer::process(shm_ipc::ShmSlot* slot) {
+  TraceSpan span("shm.request");
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  // Поля слота может менять клиент: каждое читается один раз, и дальше
+  // используются только проверенные копии
+  const int handle = slot->handle;
+  const std::uint64_t requested = slot->count;
+  slot->outside = 0;
+  if (requested > slotCapacity_) {
+    slot->status = shm_ipc::kShmBadRequest;
+    return;
+  }
+  const std::shared_ptr<const BicubicInterpolator> interpolator =
+      lookup_(handle);
+  // Метрики заводятся только для известных дескрипторов: иначе каждый
+  // неверный дескриптор клиента оставлял бы запись навсегда
+  if (!interpolator) {
+    slot->status = shm_ipc::kShmUnknownHandle;
+    return;
+  }
+
+  MetricsScope metrics(EntryPoint::Batch, handle);
+  try {
+    const size_t count = static_cast<size_t>(requested);
+    const size_t outside = interpolator->interpolateBatch(
+        shm_ipc::SlotPoints(slot),
+        shm_ipc::SlotResults(slot, slotCapacity_), count);
+    metrics.addPoints(count);
+    metrics.addOutOfRange(outside);
+    slot->outside = outside;
+    slot->status = shm_ipc::kShmOk;
+  } catch (...) {
+    metrics.fail();
+    slot->status = shm_ipc::kShmFailed;
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef SHAREDMEMORYSERVER_H
+#define SHAREDMEMORYSERVER_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "BicubicInterpolator.h"
+#include "SharedMemoryProtocol.h"
+
+/*!
+ * \class SharedMemoryServer
+ * \brief Обслуживает пакетную интерполяцию для локальных процессов через
+ * общую память (формат — SharedMemoryProtocol.h).
+ *
+ * Сервер создает сегмент name (shm_open) и в отдельном потоке выполняет
+ * заявки по порядку: находит интерполятор по дескриптору через lookup
+ * (обычно таблицу интерполяторов WSTP) и пишет результаты в слот заявки.
+ * Вызовы учитываются в Metrics как EntryPoint::Batch.
+ *
+ * Клиент, взявший заявку и не отправивший ее (или не освободивший слот
+ * после ответа), задерживает следующие заявки не дольше abandonMs: затем
+ * сервер забирает слот, и заявка этого клиента завершается ошибкой.
+ */
+class SharedMemoryServer {
+ public:
+  typedef std::function<std::shared_ptr<const BicubicInterpolator>(int)>
+      Lookup;
+
+  /*!
+   * \param[in] name Имя сегмента POSIX, например "/bicubic"; прежний
+   * сегмент с тем же именем заменяется.
+   * \param[in] slotCount Количество слотов, степень двойки не меньше
+   * shm_ipc::kMinSlots.
+   * \param[in] slotCapacity Наибольшее число точек в одной заявке.
+   * \param[in] abandonMs Сколько ждать отправки заявки или освобождения
+   * слота, прежде чем забрать слот.
+   * \throws std::invalid_argument При неверных размерах.
+   * \throws std::runtime_error Если сегмент не создается или система не
+   * Linux.
+   */
+  SharedMemoryServer(const std::string& name, Lookup lookup,
+                     std::uint32_t slotCount = 8,
+                     std::uint64_t slotCapacity = 1 << 16,
+                     int abandonMs = 1000);
+  ~SharedMemoryServer();
+  SharedMemoryServer(const SharedMemoryServer&) = delete;
+  SharedMemoryServer& operator=(const SharedMemoryServer&) = delete;
+
+  //! Останавливает обслуживание и удаляет сегмент
+  void stop();
+
+  const std::string& name() const { return name_; }
+  std::uint64_t requests() const {
+    return requests_.load(std::memory_order_relaxed);
+  }
+  //! Заявки, пропущенные из-за того, что клиент их не отправил
+  std::uint64_t abandoned() const {
+    return abandoned_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  shm_ipc::ShmSlot* slotAt(std::uint32_t index) const;
+  void serve();
+  void process(shm_ipc::ShmSlot* slot);
+  bool reclaim(shm_ipc::ShmSlot* slot, std::uint32_t ticket);
+
+  std::string name_;
+  Lookup lookup_;
+  // Размеры сегмента; поля заголовка доступны клиентам на запись, поэтому
+  // сервер на них не полагается
+  std::uint32_t slotCount_;
+  std::uint64_t slotCapacity_;
+  int abandonMs_;
+  shm_ipc::ShmHeader* header_ = nullptr;
+  size_t size_ = 0;
+  std::atomic<bool> stop_{false};
+  std::atomic<std::uint64_t> requests_{0};
+  std::atomic<std::uint64_t> abandoned_{0};
+  std::thread thread_;
+};
+#endif
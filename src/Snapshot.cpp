@@ -0,0 +1,270 @@
+#include "Snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include "GridStore.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'B', 'I', 'C', 'U', 'B', 'S', 'N', 'P'};
+const std::uint32_t kVersion = 1;
+const std::uint32_t kByteOrderMark = 0x01020304;
+const char* kManifestName = "snapshots.manifest";
+
+// FNV-1a по 8-байтовым словам: в несколько раз быстрее побайтового
+std::uint64_t checksum(const double* data, size_t count) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < count; ++i) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash ^= word;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Запись во временный файл и переименование: прерванная запись не портит
+// предыдущий снимок
+void writeAtomically(const std::filesystem::path& path,
+                     const std::function<void(std::ofstream&)>& write) {
+  const std::filesystem::path partial = path.string() + ".partial";
+  {
+    std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Cannot open " + partial.string() +
+                               " for writing");
+    }
+    write(out);
+    out.flush();
+    if (!out) throw std::runtime_error("Failed to write " + partial.string());
+  }
+  std::error_code error;
+  std::filesystem::rename(partial, path, error);
+  if (error) {
+    std::filesystem::remove(partial, error);
+    throw std::runtime_error("Failed to replace " + path.string());
+  }
+}
+
+}  // namespace
+
+/*!
+ * \brief Отображает файл в память.
+ * \throws std::runtime_error Если файл не открывается или пуст.
+ */
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+  std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  file->file_ = handle;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+    throw std::runtime_error("Cannot map empty file " + path);
+  }
+  file->mapping_ =
+      CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!file->mapping_) throw std::runtime_error("Cannot map " + path);
+  file->data_ = static_cast<const unsigned char*>(
+      MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!file->data_) throw std::runtime_error("Cannot map " + path);
+  file->size_ = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Cannot open " + path);
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("Cannot map empty file " + path);
+  }
+  void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+  file->data_ = static_cast<const unsigned char*>(data);
+  file->size_ = static_cast<size_t>(info.st_size);
+#endif
+  return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+#else
+  if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+}
+
+/*!
+ * \brief Сохраняет сетку интерполятора в файл снимка.
+ * \param[in] interpolator Интерполятор; сетка из плиток сохраняется
+ * распакованной.
+ * \param[in] path Путь к файлу; существующий файл заменяется атомарно.
+ * \throws std::runtime_error При ошибке записи.
+ */
+void SaveSnapshot(const BicubicInterpolator& interpolator,
+                  const std::string& path) {
+  const size_t count = static_cast<size_t>(interpolator.rowCount()) *
+                       interpolator.colCount();
+  const std::shared_ptr<const double> values = interpolator.denseData();
+
+  SnapshotHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrder = kByteOrderMark;
+  header.rows = interpolator.rowCount();
+  header.cols = interpolator.colCount();
+  header.payloadBytes = count * sizeof(double);
+  header.flags = static_cast<std::uint32_t>(interpolator.kernel());
+  header.checksum = checksum(values.get(), count);
+
+  writeAtomically(path, [&](std::ofstream& out) {
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(values.get()),
+              static_cast<std::streamsize>(header.payloadBytes));
+  });
+}
+
+/*!
+ * \brief Восстанавливает интерполятор из файла снимка.
+ * \param[in] path Путь к файлу.
+ * \param[in] verifyChecksum Проверять ли контрольную сумму данных.
+ * \return Интерполятор, работающий прямо над отображенным файлом.
+ * \throws std::runtime_error Если файл поврежден, имеет другую версию или
+ * порядок байтов.
+ *
+ * \details
+ * Данные не копируются: страницы подгружаются системой по мере обращения,
+ * а отображение живет, пока жив интерполятор. Проверка контрольной суммы
+ * читает файл целиком; без нее восстановление занимает микросекунды
+ * независимо от размера сетки.
+ */
+std::shared_ptr<const BicubicInterpolator> LoadSnapshot(
+    const std::string& path, bool verifyChecksum) {
+  std::shared_ptr<const MappedFile> file = MappedFile::open(path);
+  if (file->size() < sizeof(SnapshotHeader)) {
+    throw std::runtime_error("Snapshot " + path + " is truncated");
+  }
+
+  SnapshotHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error(path + " is not a snapshot file");
+  }
+  if (header.byteOrder != kByteOrderMark) {
+    throw std::runtime_error("Snapshot " + path +
+                             " was written with a different byte order");
+  }
+  if (header.version != kVersion ||
+      header.flags > static_cast<std::uint32_t>(CubicKernelType::MonotoneHermite)) {
+    throw std::runtime_error("Unsupported snapshot version " +
+                             std::to_string(header.version) + " in " + path);
+  }
+  if (header.rows <= 0 || header.cols <= 0 ||
+      header.payloadBytes != static_cast<std::uint64_t>(header.rows) *
+                                 static_cast<std::uint64_t>(header.cols) *
+                                 sizeof(double) ||
+      file->size() - sizeof(SnapshotHeader) < header.payloadBytes) {
+    throw std::runtime_error("Snapshot " + path + " is truncated");
+  }
+
+  const double* values =
+      reinterpret_cast<const double*>(file->data() + sizeof(SnapshotHeader));
+  const size_t count = header.payloadBytes / sizeof(double);
+  if (verifyChecksum && checksum(values, count) != header.checksum) {
+    throw std::runtime_error("Snapshot " + path + " is corrupted");
+  }
+
+  return std::make_shared<const BicubicInterpolator>(
+      std::shared_ptr<const double>(file, values), header.rows, header.cols,
+      static_cast<CubicKernelType>(header.flags));
+}
+
+/*!
+ * \brief Сохраняет все интерполяторы таблицы в каталог.
+ * \return Количество сохраненных интерполяторов.
+ *
+ * \details
+ * Каждый интерполятор пишется в отдельный файл interpolator_<handle>.bcsnap,
+ * список файлов — в snapshots.manifest. Манифест записывается последним,
+ * поэтому восстановление никогда не видит частично сохраненный набор и
+ * не подхватывает снимки давно удаленных дескрипторов.
+ */
+size_t SaveAllSnapshots(
+    const HandleRegistry<const BicubicInterpolator>& registry,
+    const std::string& directory) {
+  std::filesystem::create_directories(directory);
+  std::vector<std::pair<int, std::string>> saved;
+  registry.forEach(
+      [&](int handle, const std::shared_ptr<const BicubicInterpolator>& object) {
+        const std::string name =
+            "interpolator_" + std::to_string(handle) + ".bcsnap";
+        SaveSnapshot(*object,
+                     (std::filesystem::path(directory) / name).string());
+        saved.emplace_back(handle, name);
+      });
+
+  writeAtomically(std::filesystem::path(directory) / kManifestName,
+                  [&](std::ofstream& out) {
+                    for (const auto& entry : saved) {
+                      out << entry.first << ' ' << entry.second << '\n';
+                    }
+                  });
+  return saved.size();
+}
+
+/*!
+ * \brief Восстанавливает интерполяторы, сохраненные SaveAllSnapshots.
+ * \return Пары (старый дескриптор, новый дескриптор).
+ * \throws std::runtime_error Если манифест или один из снимков не читается;
+ * в этом случае таблица не изменяется.
+ */
+std::vector<std::pair<int, int>> RestoreAllSnapshots(
+    HandleRegistry<const BicubicInterpolator>& registry,
+    const std::string& directory, bool verifyChecksum) {
+  const std::filesystem::path manifestPath =
+      std::filesystem::path(directory) / kManifestName;
+  std::ifstream manifest(manifestPath);
+  if (!manifest) {
+    throw std::runtime_error("Cannot open " + manifestPath.string());
+  }
+
+  std::vector<std::pair<int, std::shared_ptr<const BicubicInterpolator>>>
+      loaded;
+  int handle;
+  std::string name;
+  while (manifest >> handle >> name) {
+    loaded.emplace_back(
+        handle,
+        LoadSnapshot((std::filesystem::path(directory) / name).string(),
+                     verifyChecksum));
+  }
+
+  std::vector<std::pair<int, int>> handles;
+  // Как и при создании сеток, одинаковые снимки делят один интерполятор
+  for (auto& entry : loaded) {
+    handles.emplace_back(
+        entry.first,
+        registry.insert(GridStore::instance().intern(std::move(entry.second))));
+  }
+  return handles;
+}
@@ -0,0 +1,70 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BicubicInterpolator.h"
+#include "HandleRegistry.h"
+
+/*!
+ * \brief Заголовок файла снимка (64 байта, данные идут сразу за ним).
+ *
+ * Данные — значения сетки по строкам в формате double. Контрольная сумма —
+ * FNV-1a по 8-байтовым словам данных. Поле flags хранит ядро интерполяции
+ * (CubicKernelType; 0 — Катмулл-Ром, так что ранние снимки читаются как
+ * прежде); для B-сплайна данные — коэффициенты. Резерв предназначен для
+ * настроек границ и производных таблиц и должен быть нулевым.
+ */
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::int32_t rows;
+  std::int32_t cols;
+  std::uint64_t payloadBytes;
+  std::uint64_t checksum;
+  std::uint32_t flags;
+  std::uint8_t reserved[20];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "Snapshot header must be 64 bytes");
+
+/*!
+ * \class MappedFile
+ * \brief Файл, отображенный в память только для чтения.
+ */
+class MappedFile {
+ public:
+  static std::shared_ptr<const MappedFile> open(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile() = default;
+
+  const unsigned char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+void SaveSnapshot(const BicubicInterpolator& interpolator,
+                  const std::string& path);
+std::shared_ptr<const BicubicInterpolator> LoadSnapshot(
+    const std::string& path, bool verifyChecksum = true);
+
+size_t SaveAllSnapshots(
+    const HandleRegistry<const BicubicInterpolator>& registry,
+    const std::string& directory);
+std::vector<std::pair<int, int>> RestoreAllSnapshots(
+    HandleRegistry<const BicubicInterpolator>& registry,
+    const std::string& directory, bool verifyChecksum = true);
+#endif
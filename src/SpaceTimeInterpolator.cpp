@@ -0,0 +1,191 @@
+#include "SpaceTimeInterpolator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "CubicKernel.h"
+#include "Trace.h"
+
+/*!
+ * \brief Создает пустое окно.
+ * \param[in] rows Количество строк кадра.
+ * \param[in] cols Количество столбцов кадра.
+ * \param[in] capacity Количество кадров в окне.
+ * \throws std::invalid_argument Если какой-либо размер не положителен.
+ */
+SpaceTimeInterpolator::SpaceTimeInterpolator(int rows, int cols,
+                                             size_t capacity)
+    : rows_(rows), cols_(cols), capacity_(capacity) {
+  if (rows <= 0 || cols <= 0 || capacity == 0) {
+    throw std::invalid_argument("Frame size and capacity must be positive");
+  }
+  slots_ = capacity_ + kSpareSlots;
+  frameSize_ = static_cast<size_t>(rows_) * cols_;
+  values_.reset(new double[slots_ * frameSize_]);
+  times_.reset(new std::atomic<double>[slots_]);
+  for (size_t i = 0; i < slots_; ++i) {
+    times_[i].store(0.0, std::memory_order_relaxed);
+  }
+}
+
+SpaceTimeInterpolator::~SpaceTimeInterpolator() = default;
+
+/*!
+ * \details
+ * Кадр пишется в слот, вышедший из окна kSpareSlots кадров назад; до
+ * записи увеличивается счетчик начатых кадров, после — опубликованных.
+ * Читатели, которые еще могут читать этот слот, увидят счетчик начатых
+ * кадров и повторят чтение.
+ */
+void SpaceTimeInterpolator::push(double time, const double* values) {
+  TraceSpan span("frames.push");
+  std::lock_guard<std::mutex> lock(pushMutex_);
+  const std::uint64_t frame = published_.load(std::memory_order_relaxed);
+  if (!std::isfinite(time) || (frame > 0 && !(time > frameTime(frame - 1)))) {
+    throw std::invalid_argument("Frame times must be finite and increasing");
+  }
+
+  started_.store(frame + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  const size_t slot = frame % slots_;
+  std::copy(values, values + frameSize_, values_.get() + slot * frameSize_);
+  times_[slot].store(time, std::memory_order_relaxed);
+  published_.store(frame + 1, std::memory_order_release);
+}
+
+double SpaceTimeInterpolator::frameTime(std::uint64_t frame) const {
+  return times_[frame % slots_].load(std::memory_order_relaxed);
+}
+
+// Бикубическое значение кадра в ячейке (x0, y0)
+double SpaceTimeInterpolator::frameValue(std::uint64_t frame, int x0, int y0,
+                                         double dx, double dy) const {
+  const double* values = values_.get() + (frame % slots_) * frameSize_;
+  double temp[4];
+  for (int j = 0; j < 4; ++j) {
+    const int y = std::max(0, std::min(rows_ - 1, y0 - 1 + j));
+    const double* row = values + static_cast<size_t>(y) * cols_;
+    double p[4];
+    for (int i = 0; i < 4; ++i) {
+      p[i] = row[std::max(0, std::min(cols_ - 1, x0 - 1 + i))];
+    }
+    temp[j] = catmullRom(p, dx);
+  }
+  return catmullRom(temp, dy);
+}
+
+double SpaceTimeInterpolator::evaluate(double x, double y, double t,
+                                       bool& outside) const {
+  outside = !(x >= 0 && x < cols_ - 1 && y >= 0 && y < rows_ - 1);
+  if (outside) {
+    x = std::max(0.0, std::min(static_cast<double>(cols_ - 1.01), x));
+    y = std::max(0.0, std::min(static_cast<double>(rows_ - 1.01), y));
+  }
+  const int x0 = static_cast<int>(std::floor(x));
+  const int y0 = static_cast<int>(std::floor(y));
+  const double dx = x - x0, dy = y - y0;
+
+  for (;;) {
+    const std::uint64_t end = published_.load(std::memory_order_acquire);
+    if (end == 0) {
+      throw std::runtime_error("Space-time interpolator has no frames");
+    }
+    const std::uint64_t first = end > capacity_ ? end - capacity_ : 0;
+
+    // Последний кадр окна с моментом не позже t
+    const double firstTime = frameTime(first), lastTime = frameTime(end - 1);
+    const bool outsideTime = !(t >= firstTime && t <= lastTime);
+    const double time = std::max(firstTime, std::min(lastTime, t));
+    std::uint64_t low = first, high = end - 1;
+    while (low < high) {
+      const std::uint64_t middle = low + (high - low + 1) / 2;
+      if (frameTime(middle) <= time) {
+        low = middle;
+      } else {
+        high = middle - 1;
+      }
+    }
+
+    double result;
+    if (end - first == 1) {
+      result = frameValue(first, x0, y0, dx, dy);
+    } else {
+      const std::uint64_t k = std::min(low, end - 2);
+      std::uint64_t frames[4];
+      double times[4], v[4];
+      for (int i = 0; i < 4; ++i) {
+        const std::int64_t index = static_cast<std::int64_t>(k) - 1 + i;
+        frames[i] = static_cast<std::uint64_t>(std::max<std::int64_t>(
+            first, std::min<std::int64_t>(end - 1, index)));
+        times[i] = frameTime(frames[i]);
+        v[i] = frameValue(frames[i], x0, y0, dx, dy);
+      }
+      // Эрмитов сплайн на [times[1], times[2]]; производные по разностям
+      // соседних кадров (у края окна — односторонние)
+      const double h = times[2] - times[1];
+      const double u = (time - times[1]) / h;
+      const double m1 = h * (v[2] - v[0]) / (times[2] - times[0]);
+      const double m2 = h * (v[3] - v[1]) / (times[3] - times[1]);
+      const double u2 = u * u, u3 = u2 * u;
+      result = (2.0 * u3 - 3.0 * u2 + 1.0) * v[1] + (u3 - 2.0 * u2 + u) * m1 +
+               (-2.0 * u3 + 3.0 * u2) * v[2] + (u3 - u2) * m2;
+    }
+
+    // Прочитанные кадры не моложе first; запись кадра first + slots_
+    // затерла бы самый старый из них
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (started_.load(std::memory_order_relaxed) <= first + slots_) {
+      outside = outside || outsideTime;
+      return result;
+    }
+    retries_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+double SpaceTimeInterpolator::interpolate(double x, double y, double t) const {
+  bool outside;
+  const double value = evaluate(x, y, t, outside);
+  if (outside) {
+    std::cerr << "Warning: Interpolation point (" << x << ", " << y << ", "
+              << t << ") is outside the data range or frame window\n";
+  }
+  return value;
+}
+
+size_t SpaceTimeInterpolator::interpolateBatch(const double* xyt, double* out,
+                                               size_t n) const {
+  TraceSpan span("frames.batch");
+  size_t outside = 0;
+  for (size_t i = 0; i < n; ++i) {
+    bool pointOutside;
+    out[i] = evaluate(xyt[3 * i], xyt[3 * i + 1], xyt[3 * i + 2], pointOutside);
+    if (pointOutside) ++outside;
+  }
+  if (outside != 0) {
+    std::cerr << "Warning: " << outside << " of " << n
+              << " interpolation points are outside the data range or frame "
+                 "window\n";
+  }
+  return outside;
+}
+
+bool SpaceTimeInterpolator::timeRange(double& first, double& last) const {
+  for (;;) {
+    const std::uint64_t end = published_.load(std::memory_order_acquire);
+    if (end == 0) return false;
+    const std::uint64_t oldest = end > capacity_ ? end - capacity_ : 0;
+    first = frameTime(oldest);
+    last = frameTime(end - 1);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (started_.load(std::memory_order_relaxed) <= oldest + slots_) {
+      return true;
+    }
+  }
+}
+
+size_t SpaceTimeInterpolator::frameCount() const {
+  const std::uint64_t end = published_.load(std::memory_order_acquire);
+  return static_cast<size_t>(std::min<std::uint64_t>(end, capacity_));
+}
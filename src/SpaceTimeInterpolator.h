@@ -0,0 +1,88 @@
+#ifndef SPACETIMEINTERPOLATOR_H
+#define SPACETIMEINTERPOLATOR_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/*!
+ * \class SpaceTimeInterpolator
+ * \brief Интерполяция по (x, y, t) в скользящем окне последних кадров.
+ *
+ * Кадры — сетки rows x cols по строкам (как в BicubicInterpolator) с
+ * возрастающими моментами времени. В окне хранятся последние capacity
+ * кадров; новый кадр вытесняет самый старый. Память под кадры выделяется
+ * один раз в конструкторе, push только копирует значения в свободный слот.
+ *
+ * По x и y используется ядро Катмулла-Рома, по t — кубический эрмитов
+ * сплайн с производными по разностям соседних кадров; при равномерном шаге
+ * по времени это тоже Катмулл-Ром. За краями окна кадры повторяют крайние.
+ *
+ * Один поток может добавлять кадры, пока другие читают, и никто никого не
+ * ждет. Слотов на kSpareSlots больше, чем кадров в окне: кадр,
+ * вытесненный из окна, перезаписывается не сразу. Читатель проверяет после
+ * вычисления, что писатель не начал перезаписывать прочитанные кадры
+ * (счетчик начатых кадров, как в seqlock), и в этом редком случае
+ * повторяет вычисление с новым окном.
+ */
+class SpaceTimeInterpolator {
+ public:
+  static constexpr size_t kSpareSlots = 2;
+
+  SpaceTimeInterpolator(int rows, int cols, size_t capacity);
+  ~SpaceTimeInterpolator();
+
+  /*!
+   * \brief Добавляет кадр values (rows * cols значений по строкам).
+   * \throws std::invalid_argument Если time не больше времени последнего
+   * кадра.
+   */
+  void push(double time, const double* values);
+
+  //! Значение в точке; точки вне сетки или окна ограничиваются с
+  //! предупреждением. \throws std::runtime_error Если кадров еще нет.
+  double interpolate(double x, double y, double t) const;
+  /*!
+   * \brief Интерполяция во множестве точек x0, y0, t0, x1, ...
+   * \return Количество точек вне сетки или окна (предупреждение одно на
+   * пакет).
+   */
+  size_t interpolateBatch(const double* xyt, double* out, size_t n) const;
+
+  //! Моменты первого и последнего кадров окна; false, если кадров нет
+  bool timeRange(double& first, double& last) const;
+  //! Кадров в окне
+  size_t frameCount() const;
+  size_t capacity() const { return capacity_; }
+  std::uint64_t framesPushed() const {
+    return published_.load(std::memory_order_acquire);
+  }
+  //! Повторы чтения из-за перезаписи кадров
+  std::uint64_t readRetries() const {
+    return retries_.load(std::memory_order_relaxed);
+  }
+  int rowCount() const { return rows_; }
+  int colCount() const { return cols_; }
+
+ private:
+  double evaluate(double x, double y, double t, bool& outside) const;
+  double frameValue(std::uint64_t frame, int x0, int y0, double dx,
+                    double dy) const;
+  double frameTime(std::uint64_t frame) const;
+
+  int rows_;
+  int cols_;
+  size_t capacity_;
+  size_t slots_;
+  size_t frameSize_;
+  std::unique_ptr<double[]> values_;
+  std::unique_ptr<std::atomic<double>[]> times_;
+
+  // Писатели упорядочиваются между собой; читатели блокировку не берут
+  std::mutex pushMutex_;
+  std::atomic<std::uint64_t> started_{0};
+  std::atomic<std::uint64_t> published_{0};
+  mutable std::atomic<std::uint64_t> retries_{0};
+};
+#endif
@@ -0,0 +1,241 @@
+#ifndef TENSORINTERPOLATOR_H
+#define TENSORINTERPOLATOR_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+#include "CubicKernel.h"
+
+namespace tensor_detail {
+
+/*!
+ * \brief Интерполяция по окрестности 4^(K+1) узлов вдоль осей 0..K.
+ * \param[in] base Узел окрестности с наименьшими индексами по осям > K.
+ * \param[in] offsets offsets[d][i] — смещение i-го узла окрестности по оси d.
+ * \param[in] t Дробные координаты точки внутри ячейки по каждой оси.
+ *
+ * Рекурсия раскрывается при компиляции: для каждой размерности и каждого
+ * ядра получается плоская последовательность из 4^D чтений без циклов.
+ */
+template <typename Kernel, int K>
+inline double contract(const double* base, const std::ptrdiff_t (*offsets)[4],
+                       const double* t) {
+  double p[4];
+  for (int i = 0; i < 4; ++i) {
+    if constexpr (K == 0) {
+      p[i] = base[offsets[0][i]];
+    } else {
+      p[i] = contract<Kernel, K - 1>(base + offsets[K][i], offsets, t);
+    }
+  }
+  return Kernel::interpolate(p, t[K]);
+}
+
+/*!
+ * \brief Окрестность целиком внутри сетки: corner — ее первый узел,
+ * узлы по оси d идут с шагом strides[d].
+ */
+template <typename Kernel, int D>
+struct InteriorKernel {
+  static double apply(const double* corner, const size_t* strides,
+                      const double* t) {
+    std::ptrdiff_t offsets[D][4];
+    for (int d = 0; d < D; ++d) {
+      for (int i = 0; i < 4; ++i) {
+        offsets[d][i] = static_cast<std::ptrdiff_t>(i * strides[d]);
+      }
+    }
+    return contract<Kernel, D - 1>(corner, offsets, t);
+  }
+};
+
+// Для D = 2 и 3 строки окрестности передаются ядру напрямую, без копий и
+// таблицы смещений
+template <typename Kernel>
+struct InteriorKernel<Kernel, 2> {
+  static double apply(const double* corner, const size_t* strides,
+                      const double* t) {
+    const size_t sy = strides[1];
+    const double rows[4] = {Kernel::interpolate(corner, t[0]),
+                            Kernel::interpolate(corner + sy, t[0]),
+                            Kernel::interpolate(corner + 2 * sy, t[0]),
+                            Kernel::interpolate(corner + 3 * sy, t[0])};
+    return Kernel::interpolate(rows, t[1]);
+  }
+};
+
+template <typename Kernel>
+struct InteriorKernel<Kernel, 3> {
+  static double apply(const double* corner, const size_t* strides,
+                      const double* t) {
+    double planes[4];
+    for (int k = 0; k < 4; ++k) {
+      planes[k] = InteriorKernel<Kernel, 2>::apply(corner + k * strides[2],
+                                                   strides, t);
+    }
+    return Kernel::interpolate(planes, t[2]);
+  }
+};
+
+}  // namespace tensor_detail
+
+/*!
+ * \class TensorInterpolator
+ * \brief Интерполяция тензорным произведением кубических ядер на сетке
+ * размерности D; Kernel — ядро из CubicKernel.h.
+ *
+ * Сетка хранится так же, как в BicubicInterpolator: одним массивом, первая
+ * координата меняется быстрее всех (для D = 2 — values[y * nx + x]), и
+ * массивом интерполятор владеет совместно с источником. Граничные условия
+ * те же: узлы за краем заменяются крайними, точки вне сетки ограничиваются
+ * с предупреждением. Для D = 2 результат совпадает с BicubicInterpolator
+ * с тем же ядром.
+ */
+template <int D, typename Kernel = CatmullRomKernel>
+class TensorInterpolator {
+  static_assert(D >= 1 && D <= 8, "Unsupported tensor dimension");
+
+ public:
+  //! extents[d] — количество узлов по координате d
+  typedef std::array<int, D> Extents;
+  static constexpr int kDimension = D;
+
+  TensorInterpolator(std::vector<double> data, const Extents& extents)
+      : extents_(extents) {
+    const size_t count = init();
+    if (data.size() != count) {
+      throw std::invalid_argument("Input data size does not match extents");
+    }
+    if constexpr (Kernel::kPrefilter) {
+      BSplinePrefilter(data.data(), extents_.data(), D);
+    }
+    auto flat = std::make_shared<std::vector<double>>(std::move(data));
+    values_ = flat->data();
+    storage_ = std::shared_ptr<const double>(flat, values_);
+  }
+
+  //! Над внешним буфером не менее чем из произведения extents значений;
+  //! для ядра с префильтром буфер содержит уже готовые коэффициенты
+  TensorInterpolator(std::shared_ptr<const double> data, const Extents& extents)
+      : storage_(std::move(data)), extents_(extents) {
+    init();
+    if (!storage_) throw std::invalid_argument("Input data cannot be empty");
+    values_ = storage_.get();
+  }
+
+  //! Значение в точке point[0..D-1]
+  double interpolate(const double* point) const {
+    if (!isInRange(point)) {
+      std::cerr << "Warning: Interpolation point is outside the data range\n";
+      double clamped[D];
+      clamp(point, clamped);
+      return interpolateClamped(clamped);
+    }
+    return interpolateClamped(point);
+  }
+  double interpolate(const std::array<double, D>& point) const {
+    return interpolate(point.data());
+  }
+
+  /*!
+   * \brief Интерполяция во множестве точек.
+   * \param[in] points Координаты точек подряд по D значений.
+   * \param[out] out Массив из n значений.
+   * \return Количество точек вне сетки (предупреждение одно на пакет).
+   */
+  size_t interpolateBatch(const double* points, double* out, size_t n) const {
+    size_t outside = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const double* point = points + i * D;
+      if (isInRange(point)) {
+        out[i] = interpolateClamped(point);
+      } else {
+        ++outside;
+        double clamped[D];
+        clamp(point, clamped);
+        out[i] = interpolateClamped(clamped);
+      }
+    }
+    if (outside != 0) {
+      std::cerr << "Warning: " << outside << " of " << n
+                << " interpolation points are outside the data range\n";
+    }
+    return outside;
+  }
+
+  bool isInRange(const double* point) const {
+    for (int d = 0; d < D; ++d) {
+      if (!(point[d] >= 0 && point[d] < extents_[d] - 1)) return false;
+    }
+    return true;
+  }
+
+  int extent(int d) const { return extents_[d]; }
+  const Extents& extents() const { return extents_; }
+  const double* data() const { return values_; }
+
+ private:
+  // Проверяет размеры, вычисляет шаги; возвращает число узлов
+  size_t init() {
+    size_t count = 1;
+    for (int d = 0; d < D; ++d) {
+      if (extents_[d] <= 0) {
+        throw std::invalid_argument("Input data cannot be empty");
+      }
+      strides_[d] = count;
+      count *= static_cast<size_t>(extents_[d]);
+    }
+    return count;
+  }
+
+  void clamp(const double* point, double* clamped) const {
+    for (int d = 0; d < D; ++d) {
+      clamped[d] = std::max(
+          0.0, std::min(static_cast<double>(extents_[d] - 1.01), point[d]));
+    }
+  }
+
+  double interpolateClamped(const double* point) const {
+    double t[D];
+    int first[D];
+    bool interior = true;
+    for (int d = 0; d < D; ++d) {
+      const int i0 = static_cast<int>(std::floor(point[d]));
+      t[d] = point[d] - i0;
+      first[d] = i0 - 1;
+      interior = interior && i0 >= 1 && i0 + 2 < extents_[d];
+    }
+
+    if (interior) {
+      size_t corner = 0;
+      for (int d = 0; d < D; ++d) corner += first[d] * strides_[d];
+      return tensor_detail::InteriorKernel<Kernel, D>::apply(
+          values_ + corner, strides_.data(), t);
+    }
+
+    // У края: смещения узлов с ограничением индексов по каждой оси
+    std::ptrdiff_t offsets[D][4];
+    for (int d = 0; d < D; ++d) {
+      for (int i = 0; i < 4; ++i) {
+        const int index = std::max(0, std::min(extents_[d] - 1, first[d] + i));
+        offsets[d][i] = static_cast<std::ptrdiff_t>(index * strides_[d]);
+      }
+    }
+    return tensor_detail::contract<Kernel, D - 1>(values_, offsets, t);
+  }
+
+  std::shared_ptr<const double> storage_;
+  const double* values_ = nullptr;
+  Extents extents_;
+  std::array<size_t, D> strides_;
+};
+
+//! Объемные сетки, доступные через WSTP
+typedef std::variant<TensorInterpolator<3>, TensorInterpolator<4>> TensorGrid;
+#endif
@@ -0,0 +1,296 @@
+#include "TiledGrid.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "Trace.h"
+
+namespace {
+
+const int kTileMask = TiledGrid::kTileSize - 1;
+// Сжатие оставляется, только если экономит не меньше четверти плитки
+const size_t kMaxCompressedBytes = TiledGrid::kTileValues * sizeof(double) * 3 / 4;
+// Плиток в кэше потока: 4 x 4 по 8 КБ
+const size_t kCacheTiles = 16;
+
+std::atomic<std::uint64_t> nextGridId{1};
+
+std::uint64_t toBits(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double fromBits(std::uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Заголовок сжатой плитки: смещения начала каждой строки в данных плитки
+const size_t kRowTableBytes = TiledGrid::kTileSize * sizeof(std::uint16_t);
+
+/*!
+ * \brief Сжимает плитку XOR-разностями с предыдущим значением строки.
+ *
+ * \details
+ * У близких чисел двойной точности совпадают знак, порядок и старшие
+ * разряды мантиссы, а у коротких десятичных дробей — младшие нулевые
+ * разряды. Для каждого значения пишется байт заголовка (число нулевых
+ * старших байтов разности << 4 | число нулевых младших байтов) и
+ * оставшиеся байты разности; повтор предыдущего значения стоит один байт.
+ * Каждая строка кодируется заново от нуля, а ее начало записано в
+ * заголовке плитки, поэтому строку можно распаковать отдельно.
+ */
+void compressTile(const double* values, std::vector<std::uint8_t>& out) {
+  const size_t table = out.size();
+  out.resize(table + kRowTableBytes);
+  const size_t data = out.size();
+  for (int j = 0; j < TiledGrid::kTileSize; ++j) {
+    // Не больше 9 байт на значение: смещение помещается в 16 бит
+    const std::uint16_t start = static_cast<std::uint16_t>(out.size() - data);
+    std::memcpy(&out[table + j * sizeof(start)], &start, sizeof(start));
+    std::uint64_t previous = 0;
+    for (int i = 0; i < TiledGrid::kTileSize; ++i) {
+      const std::uint64_t bits = toBits(values[j * TiledGrid::kTileSize + i]);
+      std::uint64_t delta = bits ^ previous;
+      previous = bits;
+      if (delta == 0) {
+        out.push_back(8 << 4);
+        continue;
+      }
+      int lead = 0, trail = 0;
+      while ((delta >> (56 - 8 * lead)) == 0) ++lead;
+      while ((delta & 0xFF) == 0) {
+        delta >>= 8;
+        ++trail;
+      }
+      out.push_back(static_cast<std::uint8_t>(lead << 4 | trail));
+      for (int b = 0; b < 8 - lead - trail; ++b) {
+        out.push_back(static_cast<std::uint8_t>(delta >> (8 * b)));
+      }
+    }
+  }
+}
+
+//! Распаковывает строку row сжатой плитки tile в values (kTileSize значений)
+void decompressRow(const std::uint8_t* tile, int row, double* values) {
+  std::uint16_t start;
+  std::memcpy(&start, tile + row * sizeof(start), sizeof(start));
+  const std::uint8_t* in = tile + kRowTableBytes + start;
+  std::uint64_t previous = 0;
+  for (int i = 0; i < TiledGrid::kTileSize; ++i) {
+    const int lead = *in >> 4;
+    const int trail = *in & 0x0F;
+    const int bytes = 8 - lead - trail;
+    // Читаются сразу 8 байт (за данными есть запас), лишние отбрасываются
+    std::uint64_t delta;
+    std::memcpy(&delta, in + 1, sizeof(delta));
+    delta &= bytes == 8 ? ~std::uint64_t(0)
+                        : (std::uint64_t(1) << (8 * bytes)) - 1;
+    in += 1 + bytes;
+    previous ^= delta << (8 * trail);
+    values[i] = fromBits(previous);
+  }
+}
+
+//! Распакованные строки плитки в кэше потока; rows — маска готовых строк
+struct CachedTile {
+  std::uint64_t grid = 0;
+  size_t index = 0;
+  std::uint32_t rows = 0;
+  std::array<double, TiledGrid::kTileValues> values;
+};
+
+}  // namespace
+
+/*!
+ * \brief Разбивает сетку на плитки.
+ * \param[in] values Значения по строкам; после построения не нужны.
+ * \param[in] rows Количество строк.
+ * \param[in] cols Количество столбцов.
+ * \param[in] compress Сжимать неоднородные плитки, если это выгодно.
+ * \throws std::invalid_argument Если размеры не положительны.
+ *
+ * \details
+ * Крайние плитки дополняются повтором последних значений строки и
+ * столбца, поэтому сетка, однородная у края, дает однородные плитки.
+ */
+TiledGrid::TiledGrid(const double* values, int rows, int cols, bool compress)
+    : rows_(rows),
+      cols_(cols),
+      tilesX_((cols + kTileMask) >> kTileBits),
+      tilesY_((rows + kTileMask) >> kTileBits),
+      id_(nextGridId.fetch_add(1, std::memory_order_relaxed)) {
+  if (!values || rows <= 0 || cols <= 0) {
+    throw std::invalid_argument("Input data cannot be empty");
+  }
+  TraceSpan span("grid.tile");
+  tiles_.resize(static_cast<size_t>(tilesX_) * tilesY_);
+
+  std::vector<double> tile(kTileValues);
+  std::vector<std::uint8_t> packed;
+  for (int ty = 0; ty < tilesY_; ++ty) {
+    for (int tx = 0; tx < tilesX_; ++tx) {
+      for (int j = 0; j < kTileSize; ++j) {
+        const int y = std::min(ty * kTileSize + j, rows - 1);
+        const double* row = values + static_cast<size_t>(y) * cols;
+        for (int i = 0; i < kTileSize; ++i) {
+          tile[j * kTileSize + i] = row[std::min(tx * kTileSize + i, cols - 1)];
+        }
+      }
+
+      Tile& entry = tiles_[static_cast<size_t>(ty) * tilesX_ + tx];
+      const std::uint64_t first = toBits(tile[0]);
+      bool uniform = true;
+      for (int i = 1; i < kTileValues && uniform; ++i) {
+        uniform = toBits(tile[i]) == first;
+      }
+      if (uniform) {
+        entry = {TileKind::Uniform, 0, 0, tile[0]};
+        continue;
+      }
+
+      if (compress) {
+        packed.clear();
+        compressTile(tile.data(), packed);
+        if (packed.size() <= kMaxCompressedBytes) {
+          entry = {TileKind::Compressed,
+                   static_cast<std::uint32_t>(packed.size()),
+                   compressed_.size(), 0.0};
+          compressed_.insert(compressed_.end(), packed.begin(), packed.end());
+          continue;
+        }
+      }
+      entry = {TileKind::Raw, 0, raw_.size(), 0.0};
+      raw_.insert(raw_.end(), tile.begin(), tile.end());
+    }
+  }
+  // Запас для чтения по 8 байт в decompressTile
+  compressed_.resize(compressed_.size() + sizeof(std::uint64_t));
+  raw_.shrink_to_fit();
+  compressed_.shrink_to_fit();
+}
+
+const double* TiledGrid::tileRows(size_t index, int first, int count,
+                                  int& mask) const {
+  const Tile& tile = tiles_[index];
+  if (tile.kind == TileKind::Uniform) {
+    mask = 0;
+    return &tile.value;
+  }
+  mask = kTileValues - 1;
+  if (tile.kind == TileKind::Raw) return raw_.data() + tile.offset;
+
+  // Слот по младшим битам номеров плитки по x и y: плитки любой окрестности
+  // 4 x 4 попадают в разные слоты и не вытесняют друг друга. Распаковываются
+  // только нужные строки, так что случайный запрос стоит четырех строк, а
+  // не всей плитки
+  thread_local std::vector<CachedTile> cache(kCacheTiles);
+  const size_t tx = index % tilesX_, ty = index / tilesX_;
+  CachedTile& slot = cache[(tx & 3) | (ty & 3) << 2];
+  if (slot.grid != id_ || slot.index != index) {
+    slot.grid = id_;
+    slot.index = index;
+    slot.rows = 0;
+  }
+  const std::uint8_t* data = compressed_.data() + tile.offset;
+  for (int row = first; row < first + count; ++row) {
+    if (slot.rows & (std::uint32_t(1) << row)) continue;
+    decompressRow(data, row, slot.values.data() + row * kTileSize);
+    slot.rows |= std::uint32_t(1) << row;
+  }
+  return slot.values.data();
+}
+
+double TiledGrid::value(int x, int y) const {
+  int mask;
+  const double* tile = tileRows(
+      static_cast<size_t>(y >> kTileBits) * tilesX_ + (x >> kTileBits),
+      y & kTileMask, 1, mask);
+  return tile[((y & kTileMask) << kTileBits | (x & kTileMask)) & mask];
+}
+
+/*!
+ * \details
+ * Если окрестность целиком лежит в одной плитке (так для большинства точек),
+ * плитка находится один раз; иначе каждое значение читается отдельно.
+ */
+void TiledGrid::stencil(int x0, int y0, double points[4][4]) const {
+  const int left = x0 - 1, top = y0 - 1;
+  if (left >= 0 && top >= 0 && x0 + 2 < cols_ && y0 + 2 < rows_ &&
+      (left >> kTileBits) == ((x0 + 2) >> kTileBits) &&
+      (top >> kTileBits) == ((y0 + 2) >> kTileBits)) {
+    int mask;
+    const double* tile = tileRows(
+        static_cast<size_t>(top >> kTileBits) * tilesX_ + (left >> kTileBits),
+        top & kTileMask, 4, mask);
+    const int base = (top & kTileMask) << kTileBits | (left & kTileMask);
+    for (int j = 0; j < 4; ++j) {
+      for (int i = 0; i < 4; ++i) {
+        points[j][i] = tile[(base + (j << kTileBits) + i) & mask];
+      }
+    }
+    return;
+  }
+
+  for (int j = 0; j < 4; ++j) {
+    const int y = std::max(0, std::min(rows_ - 1, top + j));
+    for (int i = 0; i < 4; ++i) {
+      points[j][i] = value(std::max(0, std::min(cols_ - 1, left + i)), y);
+    }
+  }
+}
+
+/*!
+ * \details
+ * Плитки распаковываются по одной прямо в out, минуя кэш потока: обход по
+ * строкам сетки через value вытеснял бы каждую сжатую плитку из кэша
+ * kTileSize раз.
+ */
+void TiledGrid::decode(double* out) const {
+  TraceSpan span("grid.decode");
+  std::array<double, kTileValues> buffer;
+  for (int ty = 0; ty < tilesY_; ++ty) {
+    const int height = std::min(kTileSize, rows_ - ty * kTileSize);
+    for (int tx = 0; tx < tilesX_; ++tx) {
+      const int width = std::min(kTileSize, cols_ - tx * kTileSize);
+      const Tile& tile = tiles_[static_cast<size_t>(ty) * tilesX_ + tx];
+      const double* values = nullptr;
+      if (tile.kind == TileKind::Raw) {
+        values = raw_.data() + tile.offset;
+      } else if (tile.kind == TileKind::Compressed) {
+        const std::uint8_t* data = compressed_.data() + tile.offset;
+        for (int j = 0; j < height; ++j) {
+          decompressRow(data, j, buffer.data() + j * kTileSize);
+        }
+        values = buffer.data();
+      }
+      for (int j = 0; j < height; ++j) {
+        double* target = out +
+                         static_cast<size_t>(ty * kTileSize + j) * cols_ +
+                         static_cast<size_t>(tx) * kTileSize;
+        if (values) {
+          std::copy(values + j * kTileSize, values + j * kTileSize + width,
+                    target);
+        } else {
+          std::fill(target, target + width, tile.value);
+        }
+      }
+    }
+  }
+}
+
+size_t TiledGrid::residentBytes() const {
+  return sizeof(*this) + tiles_.capacity() * sizeof(Tile) +
+         raw_.capacity() * sizeof(double) + compressed_.capacity();
+}
+
+size_t TiledGrid::tileCount(TileKind kind) const {
+  size_t count = 0;
+  for (const Tile& tile : tiles_) count += tile.kind == kind;
+  return count;
+}
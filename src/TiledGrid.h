@@ -0,0 +1,68 @@
+#ifndef TILEDGRID_H
+#define TILEDGRID_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \class TiledGrid
+ * \brief Сетка значений, хранимая плитками kTileSize x kTileSize.
+ *
+ * Плитка, все значения которой побитно совпадают (нулевая рамка, пустые
+ * области, насыщение), хранится одним числом. Остальные плитки хранятся
+ * как есть или, если включено сжатие и оно выгодно, XOR-разностями соседних
+ * значений без потерь. Каждая строка сжатой плитки кодируется отдельно и
+ * распаковывается при обращении в небольшой кэш потока, поэтому запрос
+ * читает только нужные строки, а объект неизменяем и безопасен для
+ * одновременного чтения.
+ */
+class TiledGrid {
+ public:
+  static constexpr int kTileBits = 5;
+  static constexpr int kTileSize = 1 << kTileBits;
+  static constexpr int kTileValues = kTileSize * kTileSize;
+
+  enum class TileKind : std::uint8_t { Uniform, Raw, Compressed };
+
+  //! Разбивает на плитки массив по строкам values[y * cols + x]
+  TiledGrid(const double* values, int rows, int cols, bool compress);
+
+  int rowCount() const { return rows_; }
+  int colCount() const { return cols_; }
+
+  double value(int x, int y) const;
+  //! points[j][i] = value(x0 - 1 + i, y0 - 1 + j), индексы ограничены сеткой
+  void stencil(int x0, int y0, double points[4][4]) const;
+  //! Распаковывает всю сетку по строкам в out (rows * cols значений)
+  void decode(double* out) const;
+
+  //! Байты, занятые плитками и их описаниями
+  size_t residentBytes() const;
+  size_t tileCount(TileKind kind) const;
+
+ private:
+  struct Tile {
+    TileKind kind;
+    std::uint32_t size;  // Длина сжатых данных в байтах
+    size_t offset;       // Смещение в raw_ или compressed_
+    double value;        // Значение однородной плитки
+  };
+
+  /*!
+   * \brief Значения плитки по строкам, в которых готовы по крайней мере
+   * строки [first, first + count); mask равен 0 для однородной плитки (все
+   * индексы указывают на одно значение) и kTileValues - 1 иначе.
+   */
+  const double* tileRows(size_t index, int first, int count,
+                         int& mask) const;
+
+  int rows_;
+  int cols_;
+  int tilesX_;
+  int tilesY_;
+  std::uint64_t id_;  // Ключ кэша потока; не повторяется в пределах процесса
+  std::vector<Tile> tiles_;
+  std::vector<double> raw_;
+  std::vector<std::uint8_t> compressed_;
+};
+#endif
@@ -0,0 +1,149 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  std::uint64_t startNs;
+  std::uint64_t durationNs;
+};
+
+/*!
+ * \brief Кольцевой буфер одного потока.
+ *
+ * Пишет только поток-владелец: событие заполняется, затем счетчик head
+ * публикуется с release. Читатель копирует события и по повторному чтению
+ * head отбрасывает те, которые могли быть затерты во время копирования.
+ * clear не трогает head, а запоминает его значение в cleared: события с
+ * меньшими номерами при выгрузке пропускаются.
+ */
+struct ThreadBuffer {
+  std::uint32_t threadId;
+  std::atomic<std::uint64_t> head{0};
+  //! Изменяется только под buffersMutex
+  std::atomic<std::uint64_t> cleared{0};
+  std::vector<TraceEvent> events = std::vector<TraceEvent>(Tracer::kCapacity);
+};
+
+// Буферы живут до конца процесса, чтобы события завершившихся потоков
+// тоже попадали в выгрузку
+std::mutex buffersMutex;
+std::vector<std::shared_ptr<ThreadBuffer>>& buffers() {
+  static std::vector<std::shared_ptr<ThreadBuffer>> all;
+  return all;
+}
+
+ThreadBuffer& localBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+    auto created = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    created->threadId = static_cast<std::uint32_t>(buffers().size() + 1);
+    buffers().push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+const std::chrono::steady_clock::time_point kEpoch =
+    std::chrono::steady_clock::now();
+
+void writeJsonString(std::ostringstream& out, const char* text) {
+  out << '"';
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') out << '\\';
+    out << *c;
+  }
+  out << '"';
+}
+
+}  // namespace
+
+std::atomic<bool> Tracer::enabled_{false};
+
+void Tracer::setEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+std::uint64_t Tracer::nowNs() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - kEpoch)
+          .count());
+}
+
+void Tracer::record(const char* name, std::uint64_t startNs,
+                    std::uint64_t durationNs) {
+  ThreadBuffer& buffer = localBuffer();
+  const std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head % kCapacity] = {name, startNs, durationNs};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+/*!
+ * \brief Выгружает события всех потоков в формате Chrome trace_event.
+ * \param[out] eventCount Если задан, получает количество событий.
+ * \return JSON-объект {"traceEvents": [...]} с событиями типа "X".
+ */
+std::string Tracer::exportChrome(size_t* eventCount) {
+  std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    snapshot = buffers();
+  }
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  size_t written = 0;
+  std::vector<TraceEvent> events;
+  for (const auto& buffer : snapshot) {
+    const std::uint64_t cleared =
+        buffer->cleared.load(std::memory_order_relaxed);
+    const std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const std::uint64_t first =
+        std::max(cleared, head > kCapacity ? head - kCapacity : 0);
+    events.clear();
+    for (std::uint64_t i = first; i < head; ++i) {
+      events.push_back(buffer->events[i % kCapacity]);
+    }
+    // События, которые владелец успел перезаписать, отбрасываются
+    const std::uint64_t after = buffer->head.load(std::memory_order_acquire);
+    // (включая событие с номером after, которое может записываться сейчас)
+    const std::uint64_t valid =
+        after + 1 > kCapacity ? std::max(first, after + 1 - kCapacity) : first;
+
+    for (std::uint64_t i = valid; i < head; ++i) {
+      const TraceEvent& event = events[i - first];
+      if (written++ != 0) out << ',';
+      out << "{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+          << ",\"ts\":" << event.startNs / 1000.0
+          << ",\"dur\":" << event.durationNs / 1000.0 << '}';
+    }
+  }
+  out << "],\"displayTimeUnit\":\"ns\"}";
+  if (eventCount) *eventCount = written;
+  return out.str();
+}
+
+/*!
+ * \brief Очищает буферы.
+ *
+ * \details
+ * Можно вызывать при включенной трассировке: счетчики потоков не
+ * изменяются, сдвигается только граница выгрузки. Событие, которое
+ * другой поток записывает в этот момент, может сохраниться.
+ */
+void Tracer::clear() {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const auto& buffer : buffers()) {
+    buffer->cleared.store(buffer->head.load(std::memory_order_acquire),
+                          std::memory_order_relaxed);
+  }
+}
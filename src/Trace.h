@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*!
+ * \class Tracer
+ * \brief Запись интервалов выполнения в кольцевые буферы потоков.
+ *
+ * Каждый поток пишет в собственный буфер на kCapacity событий без
+ * блокировок; при переполнении старые события затираются. exportChrome
+ * выгружает события всех потоков в формате trace_event (chrome://tracing,
+ * Perfetto). Трассировка включается во время работы; в выключенном
+ * состоянии TraceSpan стоит одной загрузки атомарного флага.
+ */
+class Tracer {
+ public:
+  static constexpr size_t kCapacity = 1 << 14;
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void setEnabled(bool enabled);
+
+  //! Добавляет завершенный интервал; name должен жить до конца процесса
+  static void record(const char* name, std::uint64_t startNs,
+                     std::uint64_t durationNs);
+  static std::uint64_t nowNs();
+
+  static std::string exportChrome(size_t* eventCount = nullptr);
+  static void clear();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+/*!
+ * \class TraceSpan
+ * \brief Интервал от создания до разрушения объекта.
+ *
+ * Имя — строковый литерал, например TraceSpan span("simpson.integrate").
+ */
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name)
+      : name_(Tracer::enabled() ? name : nullptr),
+        start_(name_ ? Tracer::nowNs() : 0) {}
+  ~TraceSpan() {
+    if (name_) Tracer::record(name_, start_, Tracer::nowNs() - start_);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  std::uint64_t start_;
+};
+#endif
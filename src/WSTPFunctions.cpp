@@ -1,157 +1,327 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <limits>
-#include <map>
+#include <stdexcept>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "BicubicInterpolator.h"
+#include "BoundHierarchy.h"
+#include "CpuDispatch.h"
+#include "ExpressionVM.h"
+#include "GridStore.h"
+#include "HandleRegistry.h"
+#include "InterpolatorPyramid.h"
+#include "JobScheduler.h"
+#include "Metrics.h"
+#include "PackedArrayLink.h"
+#include "SharedMemoryServer.h"
+#include "Snapshot.h"
+#include "SpaceTimeInterpolator.h"
+#include "Trace.h"
 #include "wstp.h"
 #define WSTP_RETURN_SUCCESS 0
 #define WSTP_RETURN_ERROR 1
 
 typedef std::function<double(double)> RealFuncOfOneVar;
 
-// Map for storing interpolator instances
-static std::map<int, std::unique_ptr<BicubicInterpolator>> interpolators;
-static std::map<int, std::unique_ptr<FunctionNIntegratorBySimpson>>
-    simpsonIntegrators;
-static std::map<int, std::unique_ptr<ParametricCurveIntegrator>>
-    curveIntegrators;
-
-static int nextIntegratorHandle = 0;
-static int interpolator_handle = 0;
-
-std::vector<std::vector<double>> TransposeMatrix(
-    const std::vector<std::vector<double>>& matrix) {
-  if (matrix.empty() || matrix[0].empty()) return {};
-
-  size_t rows = matrix.size();
-  size_t cols = matrix[0].size();
-  std::vector<std::vector<double>> transposed(cols, std::vector<double>(rows));
-
-  for (size_t i = 0; i < rows; ++i) {
-    for (size_t j = 0; j < cols; ++j) {
-      transposed[j][i] = matrix[i][j];
+// Таблицы объектов; у каждой свои дескрипторы, устаревшие не находятся
+static HandleRegistry<const BicubicInterpolator> interpolators;
+static HandleRegistry<const FunctionNIntegratorBySimpson> simpsonIntegrators;
+static HandleRegistry<const ParametricCurveIntegrator> curveIntegrators;
+static HandleRegistry<const InterpolatorPyramid> pyramids;
+static HandleRegistry<const TensorGrid> tensorGrids;
+static HandleRegistry<const BoundHierarchy> boundHierarchies;
+static HandleRegistry<SpaceTimeInterpolator> frameStacks;
+// Сервер общей памяти для локальных клиентов; не больше одного
+static std::unique_ptr<SharedMemoryServer> sharedMemoryServer;
+
+std::shared_ptr<const BytecodeProgram> ParseFunctionsFromWSTP(
+    int count, bool withDerivatives);
+
+/*!
+ * \brief PackedArrayLink поверх stdlink.
+ */
+class WSTPPackedArrayLink : public PackedArrayLink {
+ public:
+  bool getRealArray(const double*& data, std::vector<int>& dims) override {
+    if (!WSGetReal64Array(stdlink, &data_, &dims_, &heads_, &depth_)) {
+      return false;
     }
+    data = data_;
+    dims.assign(dims_, dims_ + depth_);
+    return true;
   }
 
-  return transposed;
-}
-
-void AddZeroPad(std::vector<std::vector<double>>& matrix) {
-  if (matrix.empty()) return;
+  void releaseRealArray() override {
+    WSReleaseReal64Array(stdlink, data_, dims_, heads_, depth_);
+  }
 
-  const size_t rows = matrix.size();
-  const size_t cols = matrix[0].size();
+  bool putRealArray(const double* data,
+                    const std::vector<int>& dims) override {
+    return WSPutReal64Array(stdlink, data, dims.data(), nullptr,
+                            static_cast<int>(dims.size())) != 0;
+  }
 
-  for (auto& row : matrix) {
-    row.insert(row.begin(), 0.0);
-    row.push_back(0.0);
+  bool putSymbol(const std::string& symbol) override {
+    return WSPutSymbol(stdlink, symbol.c_str()) != 0;
   }
 
-  std::vector<double> zero_row(cols + 2, 0.0);
-  matrix.insert(matrix.begin(), zero_row);
-  matrix.push_back(zero_row);
-}
+ private:
+  double* data_ = nullptr;
+  int* dims_ = nullptr;
+  char** heads_ = nullptr;
+  int depth_ = 0;
+};
 
-RealFuncOfOneVar ParseFunctionFromWSTP();
 // ==================================================
 // ОБЕРТКИ ДЛЯ BicubicInterpolator
 // ==================================================
 
-// Function to create a new interpolator
-extern void WSTPCreateInterpolator(void) {
-  int num_rows;
-  const char* head;
-  if (!WSGetFunction(stdlink, &head, &num_rows) ||
-      std::strcmp(head, "List") != 0) {
-    WSPutSymbol(stdlink, "$Failed");
-  }
-
-  std::vector<std::vector<double>> matrix;
-  matrix.reserve(num_rows);
-
-  // Read each row of the matrix
-  for (size_t i = 0; i < num_rows; i++) {
-    double* row_data = nullptr;
-    long num_cols = 0;
-    // WSGetRealList reads a list of real numbers from the current position
-    if (!WSGetRealList(stdlink, &row_data, &num_cols)) {
-      WSPutSymbol(stdlink, "$Failed");
-    }
-
-    std::vector<double> row(row_data, row_data + num_cols);
-    matrix.push_back(row);
-    WSReleaseRealList(stdlink, row_data, num_cols);
-  }
-
-  matrix = TransposeMatrix(matrix);
-  AddZeroPad(matrix);
-
+// Создание интерполятора с заданным ядром по матрице на ссылке
+static void CreateInterpolatorWithKernel(CubicKernelType kernel) {
+  WSTPPackedArrayLink link;
+  // Дескриптор еще не известен: все создания учитываются под номером 0
+  MetricsScope metrics(EntryPoint::Create, 0);
   try {
     // Create a new interpolator
-    std::unique_ptr<BicubicInterpolator> interpolator =
-        std::make_unique<BicubicInterpolator>(matrix);
-    int handle = interpolator_handle++;
-    interpolators[handle] = std::move(interpolator);
+    std::shared_ptr<const BicubicInterpolator> interpolator =
+        CreateInterpolatorOverLink(link, kernel);
+    if (!interpolator) {
+      metrics.fail();
+      WSNewPacket(stdlink);
+      WSPutSymbol(stdlink, "$Failed");
+      return;
+    }
+    metrics.addPoints(static_cast<std::uint64_t>(interpolator->rowCount()) *
+                      interpolator->colCount());
+    // Повторно созданная сетка разделяется с уже существующей
+    int handle = interpolators.insert(
+        GridStore::instance().intern(std::move(interpolator)));
 
     WSNewPacket(stdlink);
     WSPutInteger(stdlink, handle);
   } catch (...) {
+    metrics.fail();
     WSNewPacket(stdlink);
     WSPutInteger(stdlink, -1);
   }
 }
 
+// Function to create a new interpolator
+extern void WSTPCreateInterpolator(void) {
+  CreateInterpolatorWithKernel(CubicKernelType::CatmullRom);
+}
+
+// kernel — "CatmullRom", "BSpline" или "MonotoneHermite"
+extern void WSTPCreateInterpolatorWithKernel(const char* kernel) {
+  CubicKernelType type;
+  if (!ParseCubicKernel(kernel, type)) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  CreateInterpolatorWithKernel(type);
+}
+
 extern double WSTPInterpolatePoint(double x, double y, int handle) {
   double result = std::numeric_limits<double>::quiet_NaN();
+  MetricsScope metrics(EntryPoint::Point, handle);
 
-  auto it = interpolators.find(handle);
-  if (it != interpolators.end()) {
+  auto interpolator = interpolators.find(handle);
+  if (interpolator) {
     try {
-      result = it->second->interpolate(x, y);
+      metrics.addPoints(1);
+      metrics.addOutOfRange(interpolator->isInRange(x, y) ? 0 : 1);
+      result = interpolator->interpolate(x, y);
     } catch (...) {
       result = std::numeric_limits<double>::quiet_NaN();
     }
   }
+  if (std::isnan(result)) metrics.fail();
 
   return result;
 }
 
+// Интерполяция во всех точках списка {{x1, y1}, {x2, y2}, ...} за один
+// обмен по ссылке
+extern void WSTPInterpolateList(int handle) {
+  WSTPPackedArrayLink link;
+  MetricsScope metrics(EntryPoint::Batch, handle);
+  auto interpolator = interpolators.find(handle);
+  if (!interpolator) {
+    metrics.fail();
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  try {
+    size_t points = 0, outside = 0;
+    if (!InterpolateListOverLink(link, *interpolator, &points, &outside)) {
+      metrics.fail();
+    }
+    metrics.addPoints(points);
+    metrics.addOutOfRange(outside);
+  } catch (...) {
+    metrics.fail();
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
 // Function to delete an interpolator
 extern void WSTPDeleteInterpolator(int handle) {
-  // Если интерполятор с заданным идентификатором не найден, отправляем $Failed
-  if (interpolators.find(handle) == interpolators.end()) {
+  // Если интерполятор с заданным идентификатором не найден, отправляем $Failed.
+  // Интеграторы, созданные над ним, продолжают работать: они владеют
+  // интерполятором совместно с таблицей
+  if (!interpolators.erase(handle)) {
     WSPutSymbol(stdlink, "DeleteInterpolator::notfound");
     WSNewPacket(stdlink);
     return;
   }
-
-  // Удаляем интерполятор
-  interpolators.erase(handle);
+  Metrics::instance().forget(EntryPoint::Point, handle);
+  Metrics::instance().forget(EntryPoint::Batch, handle);
 
   // Возвращаем Null в качестве успешного результата
   WSNewPacket(stdlink);
   WSPutSymbol(stdlink, "Success");
 }
 
+// Изменение узлов сетки по упакованному массиву {{i, j, value}, ...}.
+// Сетка неизменяема: дескриптор получает измененную копию, а дескрипторы,
+// разделявшие с ним прежнюю сетку, и уже созданные над ним интеграторы
+// продолжают видеть прежние значения. Success или $Failed
+extern void WSTPSetGridValues(int handle) {
+  WSTPPackedArrayLink link;
+  const double* updates = nullptr;
+  std::vector<int> dims;
+  if (!link.getRealArray(updates, dims)) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  auto interpolator = interpolators.find(handle);
+  bool updated = false;
+  if (interpolator && dims.size() == 2 && dims[1] == 3) {
+    try {
+      std::shared_ptr<const BicubicInterpolator> copy = UpdateGridValues(
+          *interpolator, updates, static_cast<size_t>(dims[0]));
+      updated = interpolators.replace(
+          handle, GridStore::instance().intern(std::move(copy)));
+    } catch (...) {
+    }
+  }
+  link.releaseRealArray();
+  WSPutSymbol(stdlink, updated ? "Success" : "$Failed");
+}
+
+// Копия интерполятора с сеткой из плиток (однородные плитки хранятся одним
+// значением); compress — "True" или "False". Новый дескриптор или $Failed
+extern void WSTPTileInterpolator(int handle, const char* compress) {
+  auto interpolator = interpolators.find(handle);
+  try {
+    if (!interpolator) throw std::runtime_error("Unknown handle");
+    const std::shared_ptr<const double> values = interpolator->denseData();
+    auto tiles = std::make_shared<const TiledGrid>(
+        values.get(), interpolator->rowCount(), interpolator->colCount(),
+        std::strcmp(compress, "True") == 0);
+    WSPutInteger(stdlink, interpolators.insert(
+                              std::make_shared<const BicubicInterpolator>(
+                                  tiles, interpolator->kernel())));
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Память, занятая сеткой интерполятора, в байтах
+extern void WSTPInterpolatorMemory(int handle) {
+  auto interpolator = interpolators.find(handle);
+  if (!interpolator) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  WSPutInteger64(stdlink, static_cast<wsint64>(interpolator->residentBytes()));
+}
+
+// Снимок сетки на диск: True или $Failed
+extern void WSTPSaveInterpolator(int handle, const char* path) {
+  auto interpolator = interpolators.find(handle);
+  try {
+    if (!interpolator) throw std::runtime_error("Unknown handle");
+    SaveSnapshot(*interpolator, path);
+    WSPutSymbol(stdlink, "True");
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Интерполятор из снимка (отображается в память без копирования)
+extern void WSTPLoadInterpolator(const char* path) {
+  try {
+    int handle =
+        interpolators.insert(GridStore::instance().intern(LoadSnapshot(path)));
+    WSPutInteger(stdlink, handle);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Все интерполяторы в каталог: количество сохраненных или $Failed
+extern void WSTPSaveAllInterpolators(const char* directory) {
+  try {
+    WSPutInteger(stdlink,
+                 static_cast<int>(SaveAllSnapshots(interpolators, directory)));
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Восстановление каталога: {старый -> новый, ...} или $Failed
+extern void WSTPRestoreAllInterpolators(const char* directory) {
+  std::vector<std::pair<int, int>> handles;
+  try {
+    handles = RestoreAllSnapshots(interpolators, directory);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  WSPutFunction(stdlink, "List", static_cast<int>(handles.size()));
+  for (const auto& entry : handles) {
+    WSPutFunction(stdlink, "Rule", 2);
+    WSPutInteger(stdlink, entry.first);
+    WSPutInteger(stdlink, entry.second);
+  }
+}
+
 // ==================================================
 // ОБЕРТКИ ДЛЯ FunctionNIntegratorBySimpson
 // ==================================================
 
-extern void WSTPCreateSimpsonIntegrator() {
-  // 1. Получить функцию и параметр n из WSTP
-  int n;
-  WSGetInteger(stdlink, &n);
+extern void WSTPCreateSimpsonIntegrator(int n) {
+  // Функция читается со ссылки сразу в байткод, без строки FullForm
+  std::shared_ptr<const BytecodeProgram> program;
+  try {
+    program = ParseFunctionsFromWSTP(1, false);
+  } catch (...) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
 
-  // 2. Получить функцию (требуется реализация парсера)
-  // Предположим, функция передается как MathLink-выражение
-  RealFuncOfOneVar func = ParseFunctionFromWSTP();  // How to do??
+  RealBatchFuncOfOneVar func = [program](const double* t, double* out,
+                                         size_t count) {
+    program->evaluateBatch(&t, out, count);
+  };
 
   try {
-    auto integrator = std::make_unique<FunctionNIntegratorBySimpson>(func, n);
-    int handle = nextIntegratorHandle++;
-    simpsonIntegrators[handle] = std::move(integrator);
+    int handle = simpsonIntegrators.insert(
+        std::make_shared<const FunctionNIntegratorBySimpson>(func, n));
 
     WSPutInteger(stdlink, handle);
   } catch (...) {
@@ -160,13 +330,17 @@ extern void WSTPCreateSimpsonIntegrator() {
 }
 
 extern double WSTPIntegrateSimpson(int handle, double a, double b) {
-  auto it = simpsonIntegrators.find(handle);
-  if (it == simpsonIntegrators.end())
+  MetricsScope metrics(EntryPoint::Simpson, handle);
+  auto integrator = simpsonIntegrators.find(handle);
+  if (!integrator) {
+    metrics.fail();
     return std::numeric_limits<double>::quiet_NaN();
+  }
 
   try {
-    return it->second->integrate(a, b);
+    return integrator->integrate(a, b);
   } catch (...) {
+    metrics.fail();
     return std::numeric_limits<double>::quiet_NaN();
   }
 }
@@ -176,22 +350,35 @@ extern double WSTPIntegrateSimpson(int handle, double a, double b) {
 // ==================================================
 
 extern void WSTPCreateCurveIntegrator(int interpolatorHandle) {
-  // 1. Проверить существование интерполятора
-  if (interpolators.find(interpolatorHandle) == interpolators.end()) {
+  // 1. Получить xFunc и yFunc из WSTP: одна программа x, y, x', y' с
+  // общими подвыражениями
+  std::shared_ptr<const BytecodeProgram> program;
+  try {
+    program = ParseFunctionsFromWSTP(2, true);
+  } catch (...) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  // 2. Проверить существование интерполятора
+  auto interpolator = interpolators.find(interpolatorHandle);
+  if (!interpolator) {
     WSPutSymbol(stdlink, "$Failed");
     return;
   }
 
-  // 2. Получить xFunc и yFunc из WSTP
-  auto xFunc = ParseFunctionFromWSTP();  // How to do??
-  auto yFunc = ParseFunctionFromWSTP();  // How to do??
+  CurveDerivativeBatchFunc curve = [program](const double* t, double* x,
+                                             double* y, double* dx,
+                                             double* dy, size_t count) {
+    double* outs[4] = {x, y, dx, dy};
+    program->evaluateBatch(&t, outs, count);
+  };
 
   try {
-    auto integrator = std::make_unique<ParametricCurveIntegrator>(
-        *interpolators[interpolatorHandle], xFunc, yFunc);
-
-    int handle = nextIntegratorHandle++;
-    curveIntegrators[handle] = std::move(integrator);
+    int handle = curveIntegrators.insert(
+        std::make_shared<const ParametricCurveIntegrator>(interpolator,
+                                                          curve));
     WSPutInteger(stdlink, handle);
   } catch (...) {
     WSPutSymbol(stdlink, "$Failed");
@@ -199,13 +386,467 @@ extern void WSTPCreateCurveIntegrator(int interpolatorHandle) {
 }
 
 extern double WSTPIntegrateCurve(int handle, double t0, double t1, int n) {
-  auto it = curveIntegrators.find(handle);
-  if (it == curveIntegrators.end())
+  MetricsScope metrics(EntryPoint::Curve, handle);
+  auto integrator = curveIntegrators.find(handle);
+  if (!integrator) {
+    metrics.fail();
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  try {
+    metrics.addPoints(static_cast<std::uint64_t>(n) + 1);
+    return integrator->integrate(t0, t1, n);
+  } catch (...) {
+    metrics.fail();
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+extern double WSTPIntegrateCurveArcLength(int handle, double t0, double t1,
+                                          int n) {
+  MetricsScope metrics(EntryPoint::Curve, handle);
+  auto integrator = curveIntegrators.find(handle);
+  if (!integrator) {
+    metrics.fail();
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  try {
+    metrics.addPoints(static_cast<std::uint64_t>(n) + 1);
+    return integrator->integrateArcLength(t0, t1, n);
+  } catch (...) {
+    metrics.fail();
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+// ==================================================
+// ОБЕРТКИ ДЛЯ TensorInterpolator
+// ==================================================
+
+// Объемная сетка из массива глубины 3 или 4: дескриптор или $Failed
+extern void WSTPCreateTensorInterpolator(void) {
+  WSTPPackedArrayLink link;
+  try {
+    std::shared_ptr<const TensorGrid> grid = CreateTensorGridOverLink(link);
+    if (!grid) {
+      WSNewPacket(stdlink);
+      WSPutSymbol(stdlink, "$Failed");
+      return;
+    }
+    int handle = tensorGrids.insert(std::move(grid));
+    WSNewPacket(stdlink);
+    WSPutInteger(stdlink, handle);
+  } catch (...) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Интерполяция во всех точках списка {{x1, y1, z1, ...}, ...}
+extern void WSTPInterpolateTensorList(int handle) {
+  WSTPPackedArrayLink link;
+  auto grid = tensorGrids.find(handle);
+  if (!grid) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  try {
+    InterpolateTensorListOverLink(link, *grid);
+  } catch (...) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+extern void WSTPDeleteTensorInterpolator(int handle) {
+  WSPutSymbol(stdlink, tensorGrids.erase(handle) ? "Success" : "$Failed");
+}
+
+// ==================================================
+// ОБЕРТКИ ДЛЯ InterpolatorPyramid
+// ==================================================
+
+// Пирамида уровней над интерполятором; исходная сетка не копируется
+extern void WSTPCreatePyramid(int interpolatorHandle) {
+  auto interpolator = interpolators.find(interpolatorHandle);
+  if (!interpolator) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  try {
+    int handle =
+        pyramids.insert(std::make_shared<const InterpolatorPyramid>(interpolator));
+    WSPutInteger(stdlink, handle);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+extern double WSTPInterpolatePyramid(int handle, double x, double y,
+                                     double footprint) {
+  auto pyramid = pyramids.find(handle);
+  if (!pyramid) return std::numeric_limits<double>::quiet_NaN();
+  try {
+    return pyramid->interpolate(x, y, footprint);
+  } catch (...) {
     return std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+// Интеграл по кривой {xFunc, yFunc} с уточнением от грубых уровней
+extern void WSTPIntegratePyramidCurve(int handle, double t0, double t1,
+                                      double tolerance) {
+  std::shared_ptr<const BytecodeProgram> program;
+  try {
+    program = ParseFunctionsFromWSTP(2, false);
+  } catch (...) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  auto pyramid = pyramids.find(handle);
+  if (!pyramid || !(tolerance > 0.0)) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
 
+  CurveBatchFunc curve = [program](const double* t, double* x, double* y,
+                                   size_t count) {
+    double* outs[2] = {x, y};
+    program->evaluateBatch(&t, outs, count);
+  };
   try {
-    return it->second->integrate(t0, t1, n);
+    WSPutReal(stdlink, pyramid->integrateCurve(curve, t0, t1, tolerance));
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+extern void WSTPDeletePyramid(int handle) {
+  WSPutSymbol(stdlink, pyramids.erase(handle) ? "Success" : "$Failed");
+}
+
+// ==================================================
+// ОБЕРТКИ ДЛЯ BoundHierarchy
+// ==================================================
+
+extern void WSTPCreateBoundHierarchy(int interpolatorHandle) {
+  auto interpolator = interpolators.find(interpolatorHandle);
+  if (!interpolator) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  try {
+    int handle = boundHierarchies.insert(
+        std::make_shared<const BoundHierarchy>(interpolator));
+    WSPutInteger(stdlink, handle);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// {value, {x, y}} или $Failed
+static void PutExtremum(int handle, double tolerance, bool maximum) {
+  auto bounds = boundHierarchies.find(handle);
+  if (!bounds || !(tolerance > 0.0)) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  BoundHierarchy::Extremum extremum;
+  try {
+    extremum =
+        maximum ? bounds->maximum(tolerance) : bounds->minimum(tolerance);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  WSPutFunction(stdlink, "List", 2);
+  WSPutReal(stdlink, extremum.value);
+  WSPutFunction(stdlink, "List", 2);
+  WSPutReal(stdlink, extremum.x);
+  WSPutReal(stdlink, extremum.y);
+}
+
+extern void WSTPSurfaceMaximum(int handle, double tolerance) {
+  PutExtremum(handle, tolerance, true);
+}
+
+extern void WSTPSurfaceMinimum(int handle, double tolerance) {
+  PutExtremum(handle, tolerance, false);
+}
+
+// {{x0, y0, x1, y1, partial}, ...}: прямоугольники ячеек [x0, x1) x [y0, y1)
+static void PutCellRanges(const std::vector<BoundHierarchy::CellRange>& cells) {
+  WSPutFunction(stdlink, "List", static_cast<int>(cells.size()));
+  for (const auto& cell : cells) {
+    WSPutFunction(stdlink, "List", 5);
+    WSPutInteger(stdlink, cell.x0);
+    WSPutInteger(stdlink, cell.y0);
+    WSPutInteger(stdlink, cell.x1);
+    WSPutInteger(stdlink, cell.y1);
+    WSPutSymbol(stdlink, cell.partial ? "True" : "False");
+  }
+}
+
+extern void WSTPLevelSetCells(int handle, double level) {
+  auto bounds = boundHierarchies.find(handle);
+  if (!bounds) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  PutCellRanges(bounds->levelSetCells(level));
+}
+
+extern void WSTPThresholdCells(int handle, double threshold) {
+  auto bounds = boundHierarchies.find(handle);
+  if (!bounds) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  PutCellRanges(bounds->thresholdCells(threshold));
+}
+
+extern void WSTPDeleteBoundHierarchy(int handle) {
+  WSPutSymbol(stdlink, boundHierarchies.erase(handle) ? "Success" : "$Failed");
+}
+
+// ==================================================
+// ОБЕРТКИ ДЛЯ SpaceTimeInterpolator
+// ==================================================
+
+// Кадры хранятся как сетки CreateInterpolator: транспонированными и с
+// рамкой из нулей, поэтому InterpolateSpaceTime[s, x, y, t] для кадра
+// frame совпадает с InterpolatePoint над CreateInterpolator[frame]
+extern void WSTPCreateFrameStack(int rows, int cols, int capacity) {
+  if (rows <= 0 || cols <= 0 || capacity <= 0) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  try {
+    int handle = frameStacks.insert(std::make_shared<SpaceTimeInterpolator>(
+        cols + 2, rows + 2, static_cast<size_t>(capacity)));
+    WSPutInteger(stdlink, handle);
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+// Кадр читается упакованным массивом rows x cols; возвращает число кадров
+// в окне или $Failed
+extern void WSTPPushFrame(int handle, double time) {
+  WSTPPackedArrayLink link;
+  const double* data = nullptr;
+  std::vector<int> dims;
+  if (!link.getRealArray(data, dims)) {
+    WSNewPacket(stdlink);
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+
+  auto stack = frameStacks.find(handle);
+  bool pushed = false;
+  if (stack && dims.size() == 2 && dims[0] == stack->colCount() - 2 &&
+      dims[1] == stack->rowCount() - 2) {
+    try {
+      std::vector<double> grid(
+          static_cast<size_t>(stack->rowCount()) * stack->colCount(), 0.0);
+      TransposeIntoPadded(data, dims[0], dims[1], grid.data());
+      stack->push(time, grid.data());
+      pushed = true;
+    } catch (...) {
+    }
+  }
+  link.releaseRealArray();
+  if (pushed) {
+    WSPutInteger(stdlink, static_cast<int>(stack->frameCount()));
+  } else {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+extern double WSTPInterpolateSpaceTime(int handle, double x, double y,
+                                       double t) {
+  auto stack = frameStacks.find(handle);
+  if (!stack) return std::numeric_limits<double>::quiet_NaN();
+  try {
+    return stack->interpolate(x, y, t);
   } catch (...) {
     return std::numeric_limits<double>::quiet_NaN();
   }
-}
\ No newline at end of file
+}
+
+extern void WSTPFrameTimeRange(int handle) {
+  auto stack = frameStacks.find(handle);
+  double first, last;
+  if (!stack || !stack->timeRange(first, last)) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  WSPutFunction(stdlink, "List", 2);
+  WSPutReal(stdlink, first);
+  WSPutReal(stdlink, last);
+}
+
+extern void WSTPDeleteFrameStack(int handle) {
+  WSPutSymbol(stdlink, frameStacks.erase(handle) ? "Success" : "$Failed");
+}
+
+// ==================================================
+// СЕРВЕР В ОБЩЕЙ ПАМЯТИ
+// ==================================================
+
+// Локальные процессы вызывают интерполяторы из таблицы interpolators через
+// сегмент name без сериализации WSTP; прежний сервер останавливается
+extern void WSTPStartSharedMemoryServer(const char* name, int slots,
+                                        int capacity) {
+  sharedMemoryServer.reset();
+  if (slots < static_cast<int>(shm_ipc::kMinSlots) || capacity <= 0) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  try {
+    sharedMemoryServer.reset(new SharedMemoryServer(
+        name, [](int handle) { return interpolators.find(handle); },
+        static_cast<std::uint32_t>(slots),
+        static_cast<std::uint64_t>(capacity)));
+    WSPutSymbol(stdlink, "Success");
+  } catch (...) {
+    WSPutSymbol(stdlink, "$Failed");
+  }
+}
+
+extern void WSTPStopSharedMemoryServer(void) {
+  const bool running = sharedMemoryServer != nullptr;
+  sharedMemoryServer.reset();
+  WSPutSymbol(stdlink, running ? "Success" : "$Failed");
+}
+
+// ==================================================
+// АСИНХРОННОЕ ВЫПОЛНЕНИЕ
+// ==================================================
+
+// Пул создается при первом асинхронном запросе
+static JobScheduler& Scheduler() {
+  static JobScheduler scheduler;
+  return scheduler;
+}
+
+// Ставит задачу в очередь и возвращает номер задания, либо $Failed, если
+// объект не найден; fn получает запрос отмены задания
+template <typename T, typename Fn>
+static void SubmitJob(EntryPoint point, int handle,
+                      const std::shared_ptr<T>& object, Fn fn) {
+  if (!object) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  // Замыкание владеет объектом: удаление дескриптора не мешает заданию
+  JobScheduler::JobId id =
+      Scheduler().submit([point, handle, object, fn](
+                             const JobContext& context) {
+        MetricsScope metrics(point, handle);
+        return fn(*object, [&context] { return context.cancelled(); });
+      });
+  WSPutInteger64(stdlink, id);
+}
+
+extern void WSTPIntegrateSimpsonAsync(int handle, double a, double b) {
+  SubmitJob(EntryPoint::Simpson, handle, simpsonIntegrators.find(handle),
+            [a, b](const FunctionNIntegratorBySimpson& integrator,
+                   const CancelCheck& cancelled) {
+              return integrator.integrate(a, b, cancelled);
+            });
+}
+
+extern void WSTPIntegrateCurveAsync(int handle, double t0, double t1, int n) {
+  SubmitJob(EntryPoint::Curve, handle, curveIntegrators.find(handle),
+            [t0, t1, n](const ParametricCurveIntegrator& integrator,
+                        const CancelCheck& cancelled) {
+              return integrator.integrate(t0, t1, n, cancelled);
+            });
+}
+
+extern void WSTPIntegrateCurveArcLengthAsync(int handle, double t0, double t1,
+                                             int n) {
+  SubmitJob(EntryPoint::Curve, handle, curveIntegrators.find(handle),
+            [t0, t1, n](const ParametricCurveIntegrator& integrator,
+                        const CancelCheck& cancelled) {
+              return integrator.integrateArcLength(t0, t1, n, cancelled);
+            });
+}
+
+extern void WSTPJobStatus(wsint64 id) {
+  WSPutString(stdlink, JobScheduler::statusName(Scheduler().status(id)));
+}
+
+// Ждет завершения задания: число, $Canceled или $Failed
+extern void WSTPJobResult(wsint64 id) {
+  JobScheduler::Result result = Scheduler().wait(id);
+  switch (result.status) {
+    case JobScheduler::Status::Done:
+      WSPutReal(stdlink, result.value);
+      break;
+    case JobScheduler::Status::Cancelled:
+      WSPutSymbol(stdlink, "$Canceled");
+      break;
+    default:
+      WSPutSymbol(stdlink, "$Failed");
+      break;
+  }
+}
+
+extern void WSTPCancelJob(wsint64 id) {
+  WSPutSymbol(stdlink, Scheduler().cancel(id) ? "True" : "False");
+}
+
+// ==================================================
+// СТАТИСТИКА
+// ==================================================
+
+// Все метрики в текстовом формате Prometheus
+extern void WSTPInterpolatorStats(void) {
+  WSPutString(stdlink, Metrics::instance().prometheusText().c_str());
+}
+
+// Строгий режим: результаты ядер побитно одинаковы на всех процессорах
+extern void WSTPSetStrictMode(const char* flag) {
+  CpuDispatch::setStrict(std::strcmp(flag, "True") == 0);
+  WSPutSymbol(stdlink, CpuDispatch::strict() ? "True" : "False");
+}
+
+// Периодическая запись метрик в файл; seconds <= 0 выключает запись
+extern void WSTPInterpolatorStatsDump(const char* path, double seconds) {
+  Metrics::instance().startDump(path, seconds);
+  WSPutSymbol(stdlink, "Null");
+}
+
+// ==================================================
+// ТРАССИРОВКА
+// ==================================================
+
+extern void WSTPSetTracing(const char* flag) {
+  Tracer::setEnabled(std::strcmp(flag, "True") == 0);
+  WSPutSymbol(stdlink, Tracer::enabled() ? "True" : "False");
+}
+
+// Записывает события в файл формата Chrome trace_event и очищает буферы;
+// возвращает количество событий или $Failed
+extern void WSTPExportTrace(const char* path) {
+  size_t count = 0;
+  const std::string json = Tracer::exportChrome(&count);
+  std::ofstream out(path, std::ios::trunc);
+  out << json;
+  if (!out) {
+    WSPutSymbol(stdlink, "$Failed");
+    return;
+  }
+  Tracer::clear();
+  WSPutInteger(stdlink, static_cast<int>(count));
+}